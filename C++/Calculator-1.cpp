@@ -8,255 +8,5430 @@
 #include <string>
 #include <iomanip>
 #include <cctype>
+#include <fstream>
+#include <chrono>
+#include <cstdio>
+#include <list>
+#include <unordered_map>
+#include <string_view>
+#include <cstring>
+#include <cstdint>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <random>
+#include <atomic>
+#include <csignal>
+#include <charconv>
+#include "Calculator-Decimal.hpp"
+#include "Calculator-Arena.hpp"
 
+#if __cplusplus >= 202002L
+#define HAS_CONSTEXPR_CALC // ? Calculator.hpp needs C++20
+#include "Calculator.hpp"
+#endif
 
-bool StrIsDigit(std::string input) {
-  if (input.empty()) {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAS_X86_SIMD
+#include <immintrin.h>
+#endif
+
+#ifdef __GNUC__
+#define HAS_COMPUTED_GOTO // ? Labels as values are a GNU extension, other compilers use the switch based RunProgram
+#define LANE_INLINE inline __attribute__((always_inline)) // ? Lets the AVX2 kernel inline the LaneMath templates and compile them for itself
+#else
+#define LANE_INLINE inline
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#define HAS_MMAP
+#define HAS_POSIX_SPAWN
+#define HAS_RUSAGE
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#endif
+
+#if defined(__x86_64__) && defined(__unix__)
+#define HAS_JIT // ? Native code follows the System V calling convention, so only x86-64 Unix
+#endif
+
+#define WRITE_BUFFER_SIZE (1 << 20)
+#define READ_CHUNK_SIZE (1 << 20)
+#define COLUMN_BLOCK_ROWS 4096
+#define BATCH_CHUNK_LINES 4096
+#define THREADED_MIN_ROWS 16
+#define JIT_THRESHOLD (1 << 16)
+#define STATS_BUCKETS 64
+#define FUSED_STACK_SIZE 256
+#define PIPELINE_CHUNKS 8 // ? Chunks in flight between the stages of --pipeline, which bounds its memory
+#define STREAM_WINDOW_SIZE 4096 // ? Cleaned characters of a --stream line kept before the ones already read are dropped
+#define NUMBER_LENGTH 24 // ? Longest shortest round-trip double, -2.2250738585072014e-308
+
+
+#ifdef CALCULATOR_STATS
+/*
+  * Instrumentation, built in with -DCALCULATOR_STATS. Without it every STATS_ macro below expands to nothing.
+  * Each thread counts into its own ThreadStats, which is only ever written by that thread,
+  * so counters are relaxed atomics updated with a plain load and store instead of a locked add.
+*/
+struct StatCounter {
+  std::atomic<uint64_t> value{0};
+
+  void Add(uint64_t amount) { value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed); }
+  void Max(uint64_t candidate) { if (candidate > Get()) value.store(candidate, std::memory_order_relaxed); }
+  uint64_t Get() const { return value.load(std::memory_order_relaxed); }
+};
+
+
+// * Power of two buckets, bucket i counts values below 2^i
+struct StatHistogram {
+  StatCounter count;
+  StatCounter total;
+  StatCounter maximum;
+  StatCounter buckets[STATS_BUCKETS];
+
+  void Record(uint64_t value) {
+    count.Add(1);
+    total.Add(value);
+    maximum.Max(value);
+    buckets[value ? std::min(64 - __builtin_clzll(value), STATS_BUCKETS - 1) : 0].Add(1);
+  }
+};
+
+
+enum class Stage {
+  Clean,
+  Tokenise,
+  Postfix,
+  Compile,
+  Evaluate, // ? One RunProgram or PostfixEvaluation call
+  Block, // ? One column block through the SIMD kernels, the threaded interpreter or native code
+  Count
+};
+
+
+enum class StatError {
+  DivisionByZero,
+  InvalidExpression,
+  UnknownVariable,
+  TooManyOperands,
+  Count
+};
+
+
+struct ThreadStats {
+  StatHistogram stages[static_cast<int>(Stage::Count)];
+  StatHistogram tokens; // ? Tokens per expression
+  StatCounter operatorStack; // ? High-water marks
+  StatCounter valueStack;
+  StatCounter errors[static_cast<int>(StatError::Count)];
+};
+
+
+std::mutex statsMutex;
+std::vector<ThreadStats*> threadStats; // ? Never freed, so a report still sees threads that have finished
+
+
+ThreadStats &LocalStats() {
+  thread_local ThreadStats *stats = [] {
+    ThreadStats *created = new ThreadStats;
+    std::lock_guard<std::mutex> lock(statsMutex);
+    threadStats.push_back(created);
+    return created;
+  }();
+
+  return *stats;
+}
+
+
+struct StageTimer {
+  Stage stage;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  explicit StageTimer(Stage timedStage) : stage(timedStage) {}
+
+  ~StageTimer() {
+    std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - start;
+    LocalStats().stages[static_cast<int>(stage)].Record(elapsed.count());
+  }
+};
+
+
+// * Value below which fraction of the histogram lies, as the upper bound of its bucket but never above the maximum
+uint64_t HistogramPercentile(const uint64_t *buckets, uint64_t count, uint64_t maximum, double fraction) {
+  uint64_t seen = 0;
+
+  for (int bucket = 0; bucket < STATS_BUCKETS; ++bucket) {
+    seen += buckets[bucket];
+
+    if (seen && seen >= fraction * count) {
+      return bucket ? std::min(uint64_t(1) << bucket, maximum) : 0;
+    }
+  }
+
+  return maximum;
+}
+
+
+// * Sums every thread's counters and prints them to stderr, safe to call while the threads are still counting
+void PrintStats() {
+  static const char *const stageNames[] = { "clean", "tokenise", "postfix", "compile", "evaluate", "block" };
+  static const char *const errorNames[] = { "division by zero", "invalid expression", "unknown variable", "too many operands" };
+  std::lock_guard<std::mutex> lock(statsMutex);
+
+  auto Merge = [](auto member, uint64_t *buckets, uint64_t &count, uint64_t &total, uint64_t &maximum) {
+    count = total = maximum = 0;
+    std::fill(buckets, buckets + STATS_BUCKETS, 0);
+
+    for (ThreadStats *stats : threadStats) {
+      const StatHistogram &histogram = member(*stats);
+      count += histogram.count.Get();
+      total += histogram.total.Get();
+      maximum = std::max(maximum, histogram.maximum.Get());
+
+      for (int bucket = 0; bucket < STATS_BUCKETS; ++bucket) {
+        buckets[bucket] += histogram.buckets[bucket].Get();
+      }
+    }
+  };
+
+  uint64_t buckets[STATS_BUCKETS];
+  uint64_t count, total, maximum;
+
+  fprintf(stderr, "Stage          calls     mean ns      p50 ns      p99 ns      max ns\n");
+
+  for (int stage = 0; stage < static_cast<int>(Stage::Count); ++stage) {
+    Merge([stage](const ThreadStats &stats) -> const StatHistogram& { return stats.stages[stage]; }, buckets, count, total, maximum);
+    fprintf(stderr, "%-10s %9llu %11.1f %11llu %11llu %11llu\n", stageNames[stage], (unsigned long long)count, count ? static_cast<double>(total) / count : 0.0,
+      (unsigned long long)HistogramPercentile(buckets, count, maximum, 0.5), (unsigned long long)HistogramPercentile(buckets, count, maximum, 0.99), (unsigned long long)maximum);
+  }
+
+  Merge([](const ThreadStats &stats) -> const StatHistogram& { return stats.tokens; }, buckets, count, total, maximum);
+  fprintf(stderr, "Tokens per expression: mean %.1f, p50 %llu, p99 %llu, max %llu\n", count ? static_cast<double>(total) / count : 0.0,
+    (unsigned long long)HistogramPercentile(buckets, count, maximum, 0.5), (unsigned long long)HistogramPercentile(buckets, count, maximum, 0.99), (unsigned long long)maximum);
+
+  uint64_t operatorStack = 0;
+  uint64_t valueStack = 0;
+  uint64_t errors[static_cast<int>(StatError::Count)] = {};
+
+  for (ThreadStats *stats : threadStats) {
+    operatorStack = std::max(operatorStack, stats->operatorStack.Get());
+    valueStack = std::max(valueStack, stats->valueStack.Get());
+
+    for (int error = 0; error < static_cast<int>(StatError::Count); ++error) {
+      errors[error] += stats->errors[error].Get();
+    }
+  }
+
+  fprintf(stderr, "Stack high-water marks: operators %llu, values %llu\n", (unsigned long long)operatorStack, (unsigned long long)valueStack);
+
+  for (int error = 0; error < static_cast<int>(StatError::Count); ++error) {
+    fprintf(stderr, "Errors, %s: %llu\n", errorNames[error], (unsigned long long)errors[error]);
+  }
+}
+
+
+#ifdef SIGUSR1
+/*
+  * Prints the stats every time the process gets SIGUSR1.
+  * The signal is blocked in the calling thread and so in every thread started after it,
+  * and a watcher thread takes it with sigwait, where printing is safe unlike in a signal handler.
+*/
+void StartStatsSignalThread() {
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGUSR1);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+  std::thread([signals] {
+    int signal;
+
+    while (!sigwait(&signals, &signal)) {
+      PrintStats();
+    }
+  }).detach();
+}
+#endif
+
+#define STATS_TIMER(stage) StageTimer statsTimer(stage)
+#define STATS_TOKENS(count) LocalStats().tokens.Record(count)
+#define STATS_OPERATOR_STACK(depth) LocalStats().operatorStack.Max(depth)
+#define STATS_VALUE_STACK(depth) LocalStats().valueStack.Max(depth)
+#define STATS_ERROR(kind) LocalStats().errors[static_cast<int>(kind)].Add(1)
+#else
+#define STATS_TIMER(stage)
+#define STATS_TOKENS(count)
+#define STATS_OPERATOR_STACK(depth)
+#define STATS_VALUE_STACK(depth)
+#define STATS_ERROR(kind)
+#endif
+
+// ? The library's instrumentation hooks, so its stages count into the stats above
+#define CALC_STATS_TIMER(stage) STATS_TIMER(Stage::stage)
+#define CALC_STATS_TOKENS(count) STATS_TOKENS(count)
+#define CALC_STATS_OPERATOR_STACK(depth) STATS_OPERATOR_STACK(depth)
+#define CALC_STATS_VALUE_STACK(depth) STATS_VALUE_STACK(depth)
+#define CALC_STATS_ERROR(kind) STATS_ERROR(StatError::kind)
+
+/*
+  * The AVX versions of the fast functions are always inlined into code compiled for AVX, so they never pass vectors the way -Wpsabi warns about.
+  * Templates are instantiated at the end of the file, so the warning stays off from here on instead of being pushed and popped,
+  * and vector arguments are taken by reference since the note about passing them by value cannot be turned off that way.
+*/
+#ifdef __GNUC__
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+#include "Calculator-Library.hpp"
+
+
+// * The engine, from Calculator-Library.hpp
+using calc::TokenList;
+using calc::ValueStack;
+using calc::StrIsDigit;
+using calc::IsOperator;
+using calc::IsNameChar;
+using calc::IsIdentifier;
+using calc::IsValid;
+using calc::ConstantValue;
+using calc::FunctionArity;
+using calc::StartsOperand;
+using calc::CleanRange;
+using calc::CleanString;
+using calc::Tokenise;
+using calc::Precedence;
+using calc::InfixToPostfix;
+using calc::ReadNumber;
+using calc::ParseNumber;
+using calc::PerformOperation;
+using calc::PerformIntegerOperation;
+using calc::ExactValue;
+using calc::ParseExactNumber;
+using calc::PerformExactOperation;
+using calc::OpCode;
+using calc::Instruction;
+using calc::IsUnary;
+using calc::FunctionOpCode;
+using calc::PowerBySquaring;
+using calc::LaneMath;
+using calc::FastExp;
+using calc::FastLog;
+using calc::FastSine;
+using calc::FastCosine;
+using calc::PerformFunction;
+using calc::PerformUnaryOperation;
+using calc::Program;
+using calc::CompilePostfix;
+using calc::RunProgram;
+using calc::OptimizeProgram;
+
+
+calc::Options engineOptions; // ? Set with --no-integers, --fast-functions and --no-optimize
+
+
+// * Writes the shortest text that reads back as exactly value and returns its length, buffer needs NUMBER_LENGTH bytes
+size_t FormatNumber(char *buffer, double value) {
+  return std::to_chars(buffer, buffer + NUMBER_LENGTH, value).ptr - buffer;
+}
+
+
+// * Formats value and a newline straight onto the end of output
+void AppendNumber(std::string &output, double value) {
+  size_t used = output.size();
+
+  output.resize(used + NUMBER_LENGTH + 1);
+  used += FormatNumber(&output[used], value);
+  output[used++] = '\n';
+  output.resize(used);
+}
+
+
+double PostfixEvaluation(const TokenList &tokens) {
+  STATS_TIMER(Stage::Evaluate);
+  ValueStack stack(tokens.get_allocator());
+
+  for (std::string_view token : tokens) {
+    if (StrIsDigit(token)) {
+      double value;
+
+      if (!ParseNumber(token, value)) {
+        std::cerr << "Invalid number " << token << '\n';
+        STATS_ERROR(StatError::InvalidExpression);
+        return -1;
+      }
+
+      stack.push_back(value);
+      STATS_VALUE_STACK(stack.size());
+      continue;
+    }
+
+    // ? Malformed input like "+" or "1*" leaves an operator without both operands
+    if (stack.size() < 2) {
+      std::cerr << "Invalid expression!" << '\n';
+      STATS_ERROR(StatError::InvalidExpression);
+      return -1;
+    }
+
+    double num2 = stack.back(); stack.pop_back(); // ? Second operand
+    double num1 = stack.back(); stack.pop_back(); // ? First operand
+    if (token[0] == '/' && !num2) {
+      std::cerr << "Division by zero!" << '\n';
+      STATS_ERROR(StatError::DivisionByZero);
+      return -1;
+    }
+
+    double result = PerformOperation(num1, num2, token[0]);
+    stack.push_back(result);
+  }
+
+  if (stack.size() != 1) {
+    std::cerr << "Too many operands!" << '\n';
+    STATS_ERROR(StatError::TooManyOperands);
+    return -1;
+  }
+
+  return stack.back();
+}
+
+
+/*
+  * PostfixEvaluation on decimals rounded to precision significant digits.
+  * Named constants are recognised by their token pointing at ConstantValue's string, and get computed to the full precision.
+  * Every built-in function but sin and cos has a decimal version.
+  * Returns false with a message on stderr if the expression has no value.
+*/
+bool DecimalPostfixEvaluation(const TokenList &tokens, int precision, calc::Decimal &result) {
+  STATS_TIMER(Stage::Evaluate);
+  std::vector<calc::Decimal> stack;
+
+  for (std::string_view token : tokens) {
+    if (token.data() == ConstantValue("pi")) {
+      stack.push_back(calc::pi(precision));
+    } else if (token.data() == ConstantValue("tau")) {
+      stack.push_back(calc::tau(precision));
+    } else if (token.data() == ConstantValue("e")) {
+      stack.push_back(calc::euler(precision));
+    } else if (StrIsDigit(token)) {
+      stack.emplace_back();
+
+      if (!calc::parse(token, precision, stack.back())) {
+        std::cerr << "Invalid number " << token << '\n';
+        return false;
+      }
+    } else if (token.back() == '(') {
+      std::string_view name = token.substr(0, token.length() - 1);
+      size_t arity = FunctionArity(name);
+
+      if (!arity || stack.size() < arity) {
+        std::cerr << "Invalid expression!" << '\n';
+        STATS_ERROR(StatError::InvalidExpression);
+        return false;
+      }
+
+      if (name == "sin" || name == "cos") {
+        std::cerr << name << " has no decimal version" << '\n';
+        return false;
+      }
+
+      if (!calc::apply(name, &stack[stack.size() - arity], precision, stack[stack.size() - arity])) {
+        std::cerr << "No real result!" << '\n';
+        return false;
+      }
+
+      stack.resize(stack.size() - arity + 1);
+      continue;
+    } else {
+      if (stack.size() < 2 || token.length() != 1 || !IsOperator(token[0])) {
+        std::cerr << "Invalid expression!" << '\n';
+        STATS_ERROR(StatError::InvalidExpression);
+        return false;
+      }
+
+      calc::Decimal num2 = std::move(stack.back()); // ? Second operand
+      stack.pop_back();
+
+      // ? Zero divisors, zero bases with negative powers and zeroth roots all divide by zero
+      bool zero = (token[0] == '/') ? num2.isZero() : stack.back().isZero();
+
+      if (!calc::operate(token[0], stack.back(), num2, precision, stack.back())) {
+        if (zero) {
+          std::cerr << "Division by zero!" << '\n';
+          STATS_ERROR(StatError::DivisionByZero);
+        } else {
+          std::cerr << "No real result!" << '\n';
+        }
+
+        return false;
+      }
+
+      continue;
+    }
+
+    STATS_VALUE_STACK(stack.size());
+  }
+
+  if (stack.size() != 1) {
+    std::cerr << "Too many operands!" << '\n';
+    STATS_ERROR(StatError::TooManyOperands);
+    return false;
+  }
+
+  result = std::move(stack.back());
+  return true;
+}
+
+
+#ifdef HAS_X86_SIMD
+typedef double Double2 __attribute__((vector_size(16))); // ? __m128d and __m256d without their attributes, which templates ignore
+typedef double Double4 __attribute__((vector_size(32)));
+typedef uint64_t Bits2 __attribute__((vector_size(16)));
+typedef uint64_t Bits4 __attribute__((vector_size(32)));
+
+
+// ? GCC vector extensions, the same operators work on whole vectors
+template <typename V, typename B, int laneCount> struct VectorLaneMath {
+  typedef B Bits;
+
+  static LANE_INLINE Bits Less(const V &a, const V &b) { return (Bits)(a < b); }
+  static LANE_INLINE Bits Equal(const V &a, const V &b) { return (Bits)(a == b); }
+  static LANE_INLINE Bits ToBits(const V &x) { return (Bits)x; }
+  static LANE_INLINE V FromBits(const Bits &bits) { return (V)bits; }
+
+  static LANE_INLINE V Splat(double value) {
+    V x;
+
+    for (int lane = 0; lane < laneCount; ++lane) {
+      x[lane] = value;
+    }
+
+    return x;
+  }
+
+  static LANE_INLINE bool Any(const Bits &mask) {
+    Bits any = mask;
+
+    for (int lane = 1; lane < laneCount; ++lane) {
+      any[0] |= mask[lane];
+    }
+
+    return any[0] != 0;
+  }
+
+  template <typename Function> static LANE_INLINE V Map(const V &x, Function function) {
+    V result;
+
+    for (int lane = 0; lane < laneCount; ++lane) {
+      result[lane] = function(x[lane]);
+    }
+
+    return result;
+  }
+};
+
+
+template <> struct calc::LaneMath<Double2> : VectorLaneMath<Double2, Bits2, 2> {};
+template <> struct calc::LaneMath<Double4> : VectorLaneMath<Double4, Bits4, 4> {};
+#endif
+
+
+/*
+  * PerformFunction on every lane of x for abs and, when fast is set, the fast tier, which stay vectors.
+  * Returns false for anything else, which the SIMD kernels hand to PerformUnaryOperation lane by lane.
+*/
+template <typename V>
+LANE_INLINE bool PerformFunctionLanes(V &x, OpCode opCode, bool fast) {
+  typedef LaneMath<V> L;
+
+  if (opCode == OpCode::Absolute) {
+    x = L::FromBits(L::ToBits(x) & 0x7FFFFFFFFFFFFFFF);
+    return true;
+  }
+
+  if (!fast) {
     return false;
   }
 
-  int dotCount = 0;
+  switch (opCode) {
+    case OpCode::Exponential:
+      x = FastExp(x);
+      return true;
+    case OpCode::Logarithm:
+      x = FastLog(x);
+      return true;
+    case OpCode::Sine:
+      x = FastSine(x);
+      return true;
+    case OpCode::Cosine:
+      x = FastCosine(x);
+      return true;
+    default:
+      return false;
+  }
+}
+
+
+enum class FusedStatus {
+  Ok,
+  Invalid,
+  UnknownVariable,
+  TooDeep, // ? Nested deeper than the stacks may grow, for lines the pipeline has to run instead
+  TooManyTokens,
+  LiteralTooLong, // ? A number longer than the stacks let it get
+  DivisionByZero // ? Evaluated, but divided by zero on the way, result holds whatever the division gave
+};
+
+
+// * Stacks of FusedEvaluation for batch lines, fixed arrays since deeper lines go through the pipeline
+struct FusedArrays {
+  ExactValue values[FUSED_STACK_SIZE];
+  char operators[FUSED_STACK_SIZE]; // ? Calls are kept as the OpCode of the function, standing in for their parenthesis
+  int arguments[FUSED_STACK_SIZE]; // ? Commas seen so far in the call at the same index of operators
+  std::string number; // ? Digits of the number being read, however many there are, since the line is in memory anyway
+
+  bool Reserve(size_t count) { return count <= FUSED_STACK_SIZE; }
+  bool CountToken() { return true; }
+  bool FitsLiteral(size_t) { return true; }
+};
+
+
+/*
+  * Cleans, tokenises, converts and evaluates input in one pass, giving what the pipeline gives without OptimizeProgram.
+  * Operators are applied the moment the shunting yard would output them, so both stacks only grow with the nesting,
+  * and the only copy of the input is the number being read, which stacks can cap with FitsLiteral.
+  * Input is indexed like a string_view, and reads never go back more than a character before the furthest read so far
+  * once CleanString would keep every character of it. Stacks is FusedArrays or anything else with its members.
+*/
+template <typename Input, typename Stacks>
+FusedStatus FusedEvaluation(Input &input, double &result, Stacks &stacks) {
+  STATS_TIMER(Stage::Evaluate);
+  auto &values = stacks.values;
+  auto &operators = stacks.operators;
+  auto &arguments = stacks.arguments;
+  size_t valueCount = 0, operatorCount = 0;
+
+  std::string &number = stacks.number; // ? The number being read, as Tokenise would have sliced it
+  bool numberHasDigit = false;
+  int numberDots = 0;
+  bool atStart = true;
+  char previous = '\0'; // ? Last character Tokenise would have seen
+  bool dividedByZero = false;
+
+  // ? Position of the first character at or after from that CleanString keeps
+  auto NextValid = [&](size_t from) {
+    while (from < input.length() && !IsValid(input[from])) {
+      from++;
+    }
+
+    return from;
+  };
+
+  auto Apply = [&](char operation) {
+    if (valueCount < 2) {
+      return false;
+    }
+
+    ExactValue num2 = values[--valueCount]; // ? Second operand
+    dividedByZero |= operation == '/' && !num2.value;
+    values[valueCount - 1] = PerformExactOperation(values[valueCount - 1], num2, operation);
+    return true;
+  };
+
+  // ? Ends the call on top of operators, as the pipeline would compile it
+  auto Call = [&]() {
+    char function = operators[--operatorCount];
+    bool unary = IsUnary(static_cast<OpCode>(function));
+
+    if (arguments[operatorCount] + 1 != (unary ? 1 : 2)) {
+      return false;
+    }
+
+    if (!unary) {
+      return Apply(function);
+    }
+
+    if (!valueCount) {
+      return false;
+    }
+
+    values[valueCount - 1] = { PerformFunction(values[valueCount - 1].value, function, engineOptions.fastFunctions) };
+    return true;
+  };
+
+  auto PushValue = [&](const ExactValue &value) {
+    if (!stacks.Reserve(valueCount + 1)) {
+      return FusedStatus::TooDeep;
+    }
+
+    if (!stacks.CountToken()) {
+      return FusedStatus::TooManyTokens;
+    }
+
+    values[valueCount++] = value;
+    STATS_VALUE_STACK(valueCount);
+    return FusedStatus::Ok;
+  };
+
+  // ? Operators, parentheses and calls
+  auto PushOnOperators = [&](char operation) {
+    if (!stacks.Reserve(operatorCount + 1)) {
+      return FusedStatus::TooDeep;
+    }
+
+    if (!stacks.CountToken()) {
+      return FusedStatus::TooManyTokens;
+    }
+
+    operators[operatorCount++] = operation;
+    STATS_OPERATOR_STACK(operatorCount);
+    return FusedStatus::Ok;
+  };
+
+  // ? The operator branch of InfixToPostfix
+  auto PushOperator = [&](char operation) {
+    while (operatorCount && Precedence(std::string_view(&operators[operatorCount - 1], 1)) >= Precedence(std::string_view(&operation, 1))) {
+      if (!Apply(operators[--operatorCount])) {
+        return FusedStatus::Invalid;
+      }
+    }
+
+    return PushOnOperators(operation);
+  };
+
+  /*
+    * Hands the number Tokenise would have made to the shunting yard.
+    * Runs that StrIsDigit rejects are tokens the pipeline can never compile, except a lone '-' which is subtraction.
+  */
+  auto EndNumber = [&]() {
+    if (number.empty()) {
+      return FusedStatus::Ok;
+    }
+
+    char first = number[0];
+    bool isNumber = numberHasDigit && numberDots <= 1;
+    bool isMinus = number.length() == 1 && first == '-';
+    ExactValue value;
+    bool parsed = isNumber && ParseExactNumber(number, value, engineOptions.integers);
+
+    number.clear();
+    numberHasDigit = false;
+    numberDots = 0;
+
+    if (isNumber) {
+      return parsed ? PushValue(value) : FusedStatus::Invalid;
+    }
+
+    if (isMinus) {
+      return PushOperator('-');
+    }
+
+    return FusedStatus::Invalid;
+  };
+
+  FusedStatus status = FusedStatus::Ok;
+
+  for (size_t i = NextValid(0); status == FusedStatus::Ok; i = NextValid(i + 1)) {
+    char currentChar = (i < input.length()) ? input[i] : '\0';
+
+    if ((currentChar == '-' && (atStart || StartsOperand(previous))) || isdigit(currentChar) || currentChar == '.') {
+      if (!stacks.FitsLiteral(number.length() + 1)) {
+        number.clear(); // ? The stacks are kept for the next line
+        return FusedStatus::LiteralTooLong;
+      }
+
+      number += currentChar;
+      numberHasDigit |= isdigit(currentChar) != 0;
+      numberDots += currentChar == '.';
+      atStart = false;
+      previous = currentChar;
+      continue;
+    }
+
+    if (isalpha(currentChar) || currentChar == '_') {
+      char name[8]; // ? Enough to tell root and the constants from variables
+      size_t nameLength = 0;
+      size_t end = i;
+
+      for (; end < input.length() && IsNameChar(input[end]); end = NextValid(end + 1)) {
+        if (nameLength < sizeof(name)) {
+          name[nameLength] = input[end];
+        }
+
+        nameLength++;
+        previous = input[end];
+
+        // ? "root" ends a name early, the same way Tokenise splits it off
+        if (nameLength == 4 && std::string_view(name, 4) == "root") {
+          size_t after = NextValid(end + 1);
+
+          if (after == input.length() || (!isalpha(input[after]) && input[after] != '_')) {
+            break;
+          }
+        }
+      }
+
+      std::string_view nameView(name, std::min(nameLength, sizeof(name)));
+
+      if (nameView == "root") {
+        if ((status = EndNumber()) == FusedStatus::Ok) {
+          status = PushOperator('$');
+        }
+
+        i = end;
+        atStart = false;
+        continue;
+      }
+
+      // ? A number right before a name multiplies it, a lone '-' negates it
+      if (number.length() == 1 && number[0] == '-') {
+        number.clear();
+
+        if ((status = PushValue(ParseExactNumber("-1", engineOptions.integers))) == FusedStatus::Ok) {
+          status = PushOperator('*');
+        }
+      } else if (!number.empty()) {
+        if ((status = EndNumber()) == FusedStatus::Ok) {
+          status = PushOperator('*');
+        }
+      }
+
+      if (status != FusedStatus::Ok) {
+        break;
+      }
+
+      // ? A function name right before its parenthesis opens a call, and the parenthesis is read with it
+      if (nameLength <= sizeof(name) && FunctionArity(nameView) && end < input.length() && input[end] == '(') {
+        if ((status = PushOnOperators(static_cast<char>(FunctionOpCode(nameView)))) != FusedStatus::Ok) {
+          return status;
+        }
+
+        arguments[operatorCount - 1] = 0;
+        i = end;
+        atStart = false;
+        previous = '(';
+        continue;
+      }
+
+      const char *constant = (nameLength <= sizeof(name)) ? ConstantValue(nameView) : nullptr;
+
+      if (!constant) {
+        return FusedStatus::UnknownVariable;
+      }
+
+      if ((status = PushValue(ParseExactNumber(constant, engineOptions.integers))) != FusedStatus::Ok) {
+        return status;
+      }
+
+      i = end - 1;
+      atStart = false;
+      continue;
+    }
+
+    if ((status = EndNumber()) != FusedStatus::Ok || currentChar == '\0') {
+      break;
+    }
+
+    atStart = false;
+    previous = currentChar;
+
+    if (IsOperator(currentChar)) {
+      status = PushOperator(currentChar);
+    } else if (currentChar == '(') {
+      status = PushOnOperators('(');
+    } else if (currentChar == ')' || currentChar == ',') {
+      while (operatorCount && IsOperator(operators[operatorCount - 1])) {
+        if (!Apply(operators[--operatorCount])) {
+          return FusedStatus::Invalid;
+        }
+      }
+
+      // ? A right parenthesis without a left one is ignored, a comma outside of a call never compiles
+      if (!operatorCount || (currentChar == ',' && operators[operatorCount - 1] == '(')) {
+        if (currentChar == ',') {
+          return FusedStatus::Invalid;
+        }
+
+        continue;
+      }
+
+      if (currentChar == ',') {
+        arguments[operatorCount - 1]++;
+      } else if (operators[operatorCount - 1] == '(') {
+        operatorCount--;
+      } else if (!Call()) {
+        return FusedStatus::Invalid;
+      }
+    }
+  }
+
+  if (status != FusedStatus::Ok) {
+    return status;
+  }
+
+  while (operatorCount) {
+    char operation = operators[--operatorCount];
+
+    if (!IsOperator(operation) || !Apply(operation)) {
+      return FusedStatus::Invalid;
+    }
+  }
+
+  if (valueCount != 1) {
+    return FusedStatus::Invalid;
+  }
+
+  result = values[0].value;
+  return dividedByZero ? FusedStatus::DivisionByZero : FusedStatus::Ok;
+}
+
+
+FusedStatus FusedEvaluation(std::string_view input, double &result) {
+  FusedArrays stacks;
+  return FusedEvaluation(input, result, stacks);
+}
+
+
+thread_local bool dividedByZero = false; // ? Set by ColumnOperation, which the threaded interpreter and native code have no other way out of
+
+
+// * PerformOperation for the column evaluators, a zero divisor gives the -1 the SIMD kernels write for it and sets dividedByZero
+double ColumnOperation(double a, double b, char operation) {
+  if (operation == '/' && !b) {
+    dividedByZero = true;
+    return -1;
+  }
+
+  return PerformOperation(a, b, operation);
+}
+
+
+// * RunProgram for one row of the column evaluators, with ColumnOperation for every binary operator
+double RunColumnRow(const Program &program, ValueStack &stack, const double *variables) {
+  STATS_TIMER(Stage::Evaluate);
+  STATS_VALUE_STACK(program.maxDepth);
+
+  if (stack.size() < static_cast<size_t>(program.maxDepth)) {
+    stack.resize(program.maxDepth);
+  }
+
+  double *top = stack.data(); // ? One past the topmost value
+
+  for (const Instruction &instruction : program.code) {
+    if (instruction.opCode == OpCode::Push) {
+      *top++ = instruction.value;
+    } else if (instruction.opCode == OpCode::Load) {
+      *top++ = variables[instruction.slot];
+    } else if (IsUnary(instruction.opCode)) {
+      top[-1] = PerformUnaryOperation(top[-1], instruction, program.fastFunctions);
+    } else {
+      top--;
+      top[-1] = ColumnOperation(top[-1], *top, static_cast<char>(instruction.opCode));
+    }
+  }
+
+  return top[-1];
+}
+
+
+#ifdef HAS_COMPUTED_GOTO
+// * Operations of a threaded program, the ...Constant and ...Variable ones fuse a push or load with the operator after it
+enum class ThreadedOp {
+  Push,
+  Load,
+  Add,
+  Subtract,
+  Multiply,
+  Divide,
+  Power,
+  Root,
+  SquareRoot,
+  PowerInt,
+  Minimum,
+  Maximum,
+  Absolute,
+  Function,
+  AddConstant,
+  SubtractConstant,
+  MultiplyConstant,
+  DivideConstant,
+  AddVariable,
+  SubtractVariable,
+  MultiplyVariable,
+  DivideVariable,
+  Return
+};
+
+
+struct ThreadedInstruction {
+  const void *handler; // ? Address of the code that runs this instruction
+  int slot;
+  double value;
+};
+
+
+// * Program rewritten for RunThreaded, with super-instructions and handler addresses in place of opcodes
+struct ThreadedProgram {
+  std::vector<ThreadedInstruction> code;
+  int maxDepth = 0;
+  bool fastFunctions = false;
+};
+
+
+/*
+  * Direct threaded interpreter, every handler jumps straight to the handler of the next instruction.
+  * Called without a program it only hands out its handler addresses, indexed by ThreadedOp.
+*/
+double RunThreaded(const ThreadedProgram *program, ValueStack *stack, const double *variables, const void *const **handlerTable = nullptr) {
+  static const void *const handlers[] = {
+    &&push, &&load, &&add, &&subtract, &&multiply, &&divide, &&power, &&root,
+    &&squareRoot, &&powerInt, &&minimum, &&maximum, &&absolute, &&function,
+    &&addConstant, &&subtractConstant, &&multiplyConstant, &&divideConstant,
+    &&addVariable, &&subtractVariable, &&multiplyVariable, &&divideVariable,
+    &&finish
+  };
+
+  if (!program) {
+    *handlerTable = handlers;
+    return 0;
+  }
+
+  if (stack->size() < static_cast<size_t>(program->maxDepth)) {
+    stack->resize(program->maxDepth);
+  }
+
+  const ThreadedInstruction *instruction = program->code.data();
+  double *top = stack->data(); // ? One past the topmost value
+
+#define DISPATCH() goto *(++instruction)->handler
+
+  goto *instruction->handler;
+
+push:
+  *top++ = instruction->value;
+  DISPATCH();
+load:
+  *top++ = variables[instruction->slot];
+  DISPATCH();
+add:
+  top--;
+  top[-1] += *top;
+  DISPATCH();
+subtract:
+  top--;
+  top[-1] -= *top;
+  DISPATCH();
+multiply:
+  top--;
+  top[-1] *= *top;
+  DISPATCH();
+divide:
+  top--;
+  top[-1] = ColumnOperation(top[-1], *top, '/');
+  DISPATCH();
+power:
+  top--;
+  top[-1] = PerformOperation(top[-1], *top, '^');
+  DISPATCH();
+root:
+  top--;
+  top[-1] = PerformOperation(top[-1], *top, '$');
+  DISPATCH();
+squareRoot:
+  top[-1] = sqrt(top[-1]);
+  DISPATCH();
+powerInt:
+  top[-1] = PowerBySquaring(top[-1], instruction->slot);
+  DISPATCH();
+minimum:
+  top--;
+  top[-1] = top[-1] < *top ? top[-1] : *top;
+  DISPATCH();
+maximum:
+  top--;
+  top[-1] = top[-1] > *top ? top[-1] : *top;
+  DISPATCH();
+absolute:
+  top[-1] = fabs(top[-1]);
+  DISPATCH();
+function:
+  top[-1] = PerformFunction(top[-1], static_cast<char>(instruction->slot), program->fastFunctions); // ? The OpCode is kept in the slot
+  DISPATCH();
+addConstant:
+  top[-1] += instruction->value;
+  DISPATCH();
+subtractConstant:
+  top[-1] -= instruction->value;
+  DISPATCH();
+multiplyConstant:
+  top[-1] *= instruction->value;
+  DISPATCH();
+divideConstant:
+  top[-1] /= instruction->value; // ? Only fused for non-zero constants
+  DISPATCH();
+addVariable:
+  top[-1] += variables[instruction->slot];
+  DISPATCH();
+subtractVariable:
+  top[-1] -= variables[instruction->slot];
+  DISPATCH();
+multiplyVariable:
+  top[-1] *= variables[instruction->slot];
+  DISPATCH();
+divideVariable:
+  top[-1] = ColumnOperation(top[-1], variables[instruction->slot], '/');
+  DISPATCH();
+finish:
+  return top[-1];
+
+#undef DISPATCH
+}
+
+
+// * Super-instruction for a push or load followed by opCode, or ThreadedOp::Return if there is none
+ThreadedOp FuseOperand(const Instruction &operand, OpCode opCode) {
+  bool isConstant = operand.opCode == OpCode::Push;
+
+  switch (opCode) {
+    case OpCode::Add:
+      return isConstant ? ThreadedOp::AddConstant : ThreadedOp::AddVariable;
+    case OpCode::Subtract:
+      return isConstant ? ThreadedOp::SubtractConstant : ThreadedOp::SubtractVariable;
+    case OpCode::Multiply:
+      return isConstant ? ThreadedOp::MultiplyConstant : ThreadedOp::MultiplyVariable;
+    case OpCode::Divide:
+      // ? Division by a zero constant stays unfused so ColumnOperation flags it
+      return (isConstant && !operand.value) ? ThreadedOp::Return : isConstant ? ThreadedOp::DivideConstant : ThreadedOp::DivideVariable;
+    default:
+      return ThreadedOp::Return;
+  }
+}
+
+
+ThreadedOp ToThreadedOp(OpCode opCode) {
+  switch (opCode) {
+    case OpCode::Push: return ThreadedOp::Push;
+    case OpCode::Load: return ThreadedOp::Load;
+    case OpCode::Add: return ThreadedOp::Add;
+    case OpCode::Subtract: return ThreadedOp::Subtract;
+    case OpCode::Multiply: return ThreadedOp::Multiply;
+    case OpCode::Divide: return ThreadedOp::Divide;
+    case OpCode::Power: return ThreadedOp::Power;
+    case OpCode::Root: return ThreadedOp::Root;
+    case OpCode::SquareRoot: return ThreadedOp::SquareRoot;
+    case OpCode::PowerInt: return ThreadedOp::PowerInt;
+    case OpCode::Minimum: return ThreadedOp::Minimum;
+    case OpCode::Maximum: return ThreadedOp::Maximum;
+    case OpCode::Absolute: return ThreadedOp::Absolute;
+    case OpCode::Exponential:
+    case OpCode::Logarithm:
+    case OpCode::Sine:
+    case OpCode::Cosine:
+      return ThreadedOp::Function;
+  }
+
+  return ThreadedOp::Return;
+}
+
+
+// * Translates program for RunThreaded, fusing every push or load that feeds straight into + - * or /
+void CompileThreaded(const Program &program, ThreadedProgram &threaded) {
+  const void *const *handlers;
+  RunThreaded(nullptr, nullptr, nullptr, &handlers);
+
+  threaded.code.clear();
+  threaded.maxDepth = program.maxDepth;
+  threaded.fastFunctions = program.fastFunctions;
+
+  for (size_t i = 0; i < program.code.size(); ++i) {
+    const Instruction &instruction = program.code[i];
+    ThreadedOp op = ToThreadedOp(instruction.opCode);
+
+    if ((op == ThreadedOp::Push || op == ThreadedOp::Load) && i + 1 < program.code.size()) {
+      ThreadedOp fused = FuseOperand(instruction, program.code[i + 1].opCode);
+
+      if (fused != ThreadedOp::Return) {
+        op = fused;
+        i++;
+      }
+    }
+
+    int slot = (op == ThreadedOp::Function) ? static_cast<int>(instruction.opCode) : instruction.slot;
+    threaded.code.push_back({ handlers[static_cast<int>(op)], slot, instruction.value });
+  }
+
+  threaded.code.push_back({ handlers[static_cast<int>(ThreadedOp::Return)], 0, 0 });
+}
+#endif
+
+
+#ifdef HAS_JIT
+/*
+  * Emits x86-64 machine code for programs, one function that evaluates every row of a column block.
+  * The value stack lives in xmm0 to xmm14 and xmm15 is scratch, so programs deeper than that are left to the interpreters.
+  * Register use: r12 row index, r13 row count, r14 results, r15 column pointers, rax temporary.
+*/
+struct JitAssembler {
+  std::vector<unsigned char> code;
+  bool fastFunctions = false; // ? Program::fastFunctions, passed on to every call of PerformFunction
+
+  void Emit(std::initializer_list<unsigned char> bytes) {
+    code.insert(code.end(), bytes);
+  }
+
+  void Emit32(uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+      code.push_back(static_cast<unsigned char>(value >> (i * 8)));
+    }
+  }
+
+  void Emit64(uint64_t value) {
+    Emit32(static_cast<uint32_t>(value));
+    Emit32(static_cast<uint32_t>(value >> 32));
+  }
+
+  // ? prefix [REX] 0F opcode, modrm for an xmm register pair
+  void EmitRegisters(unsigned char prefix, unsigned char opcode, int destination, int source) {
+    code.push_back(prefix);
+
+    if (destination >= 8 || source >= 8) {
+      code.push_back(0x40 | ((destination >= 8) << 2) | (source >= 8));
+    }
+
+    Emit({ 0x0F, opcode, static_cast<unsigned char>(0xC0 | (destination & 7) << 3 | (source & 7)) });
+  }
+
+  void ScalarOperation(unsigned char opcode, int destination, int source) { EmitRegisters(0xF2, opcode, destination, source); }
+  void Move(int destination, int source) { EmitRegisters(0x66, 0x28, destination, source); } // ? movapd
+
+  void MoveConstant(int destination, double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    Emit({ 0x48, 0xB8 }); // ? movabs rax, bits
+    Emit64(bits);
+    Emit({ 0x66, static_cast<unsigned char>(0x48 | ((destination >= 8) << 2)), 0x0F, 0x6E, static_cast<unsigned char>(0xC0 | (destination & 7) << 3) }); // ? movq xmm, rax
+  }
+
+  void LoadColumn(int destination, int slot) {
+    Emit({ 0x49, 0x8B, 0x87 }); // ? mov rax, [r15 + slot * 8]
+    Emit32(slot * 8);
+    Emit({ 0xF2, static_cast<unsigned char>(0x42 | ((destination >= 8) << 2)), 0x0F, 0x10, static_cast<unsigned char>((destination & 7) << 3 | 4), 0xE0 }); // ? movsd xmm, [rax + r12 * 8]
+  }
+
+  // ? movsd [rsp + index * 8], xmm or the reverse, for saving the stack around calls
+  void Spill(unsigned char opcode, int index) {
+    code.push_back(0xF2);
+
+    if (index >= 8) {
+      code.push_back(0x44);
+    }
+
+    Emit({ 0x0F, opcode, static_cast<unsigned char>(0x44 | (index & 7) << 3), 0x24, static_cast<unsigned char>(index * 8) });
+  }
+
+  /*
+    * Calls ColumnOperation on stack[a] and stack[a + 1], or PerformFunction on stack[a] when operation is a unary OpCode,
+    * and leaves the result in stack[a].
+    * Every xmm register is caller saved, so the values below a go to the stack frame and come back after.
+  */
+  void Call(int a, char operation) {
+    bool unary = IsUnary(static_cast<OpCode>(operation));
+
+    for (int i = 0; i < a; ++i) {
+      Spill(0x11, i);
+    }
+
+    if (a) {
+      Move(0, a);
+
+      if (!unary) {
+        Move(1, a + 1);
+      }
+    }
+
+    uint64_t target = unary ? reinterpret_cast<uint64_t>(&PerformFunction) : reinterpret_cast<uint64_t>(&ColumnOperation);
+
+    code.push_back(0xBF); // ? mov edi, operation
+    Emit32(static_cast<unsigned char>(operation));
+
+    if (unary) {
+      code.push_back(0xBE); // ? mov esi, fastFunctions
+      Emit32(fastFunctions);
+    }
+    Emit({ 0x48, 0xB8 });
+    Emit64(target);
+    Emit({ 0xFF, 0xD0 }); // ? call rax
+
+    if (a) {
+      Move(a, 0);
+    }
+
+    for (int i = 0; i < a; ++i) {
+      Spill(0x10, i);
+    }
+  }
+
+  // ? Jump with a 32 bit displacement, returns where to patch it
+  size_t Jump(std::initializer_list<unsigned char> opcode) {
+    Emit(opcode);
+    Emit32(0);
+    return code.size() - 4;
+  }
+
+  void Patch(size_t at) {
+    uint32_t displacement = static_cast<uint32_t>(code.size() - (at + 4));
+    memcpy(&code[at], &displacement, sizeof(displacement));
+  }
+
+  // ? Inline divide, a zero divisor goes through ColumnOperation so it flags it and gives -1
+  void Divide(int a, int b) {
+    EmitRegisters(0x66, 0x57, 15, 15); // ? xorpd xmm15, xmm15
+    EmitRegisters(0x66, 0x2E, b, 15); // ? ucomisd
+    size_t notZero = Jump({ 0x0F, 0x85 });
+    size_t unordered = Jump({ 0x0F, 0x8A }); // ? NaN divisors divide normally, as in ColumnOperation
+    Call(a, '/');
+    size_t done = Jump({ 0xE9 });
+    Patch(notZero);
+    Patch(unordered);
+    ScalarOperation(0x5E, a, b);
+    Patch(done);
+  }
+
+  // ? Same multiplications as PowerBySquaring, the result builds up in xmm15
+  void PowerInt(int a, int exponent) {
+    if (!exponent) {
+      MoveConstant(a, 1);
+      return;
+    }
+
+    bool first = true;
+
+    while (exponent) {
+      if (exponent & 1) {
+        if (first) {
+          Move(15, a);
+        } else {
+          ScalarOperation(0x59, 15, a);
+        }
+
+        first = false;
+      }
+
+      exponent >>= 1;
+
+      if (exponent) {
+        ScalarOperation(0x59, a, a);
+      }
+    }
+
+    Move(a, 15);
+  }
+};
+
+
+size_t jitThreshold = JIT_THRESHOLD; // ? Rows a formula evaluates before it is compiled to native code, 0 never compiles
+
+
+typedef void (*JitFunction)(const double *const *columns, size_t rows, double *results);
+
+
+// * Native code for one program, in its own executable pages
+struct JitProgram {
+  void *pages = nullptr;
+  size_t size = 0;
+  JitFunction function = nullptr;
+
+  JitProgram() = default;
+  JitProgram(const JitProgram&) = delete;
+  JitProgram &operator=(const JitProgram&) = delete;
+
+  ~JitProgram() {
+    if (pages) {
+      munmap(pages, size);
+    }
+  }
+};
+
+
+/*
+  * Compiles program to native code in jit.
+  * Returns false when the program is too deep for the register stack or executable pages are not available.
+*/
+bool CompileJit(const Program &program, JitProgram &jit) {
+  if (program.maxDepth > 15 || program.code.empty()) {
+    return false;
+  }
+
+  JitAssembler assembler;
+  bool nonZero[16] = {}; // ? Stack entries known to hold a non-zero constant, dividing by them needs no check
+  int depth = 0;
+
+  assembler.fastFunctions = program.fastFunctions;
+
+  assembler.Emit({ 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57 }); // ? push r12 to r15
+  assembler.Emit({ 0x48, 0x81, 0xEC }); // ? sub rsp, 136 keeps the frame 16 byte aligned
+  assembler.Emit32(136);
+  assembler.Emit({ 0x49, 0x89, 0xFF, 0x49, 0x89, 0xF5, 0x49, 0x89, 0xD6, 0x45, 0x31, 0xE4 }); // ? mov r15, rdi; mov r13, rsi; mov r14, rdx; xor r12d, r12d
+  assembler.Emit({ 0x4D, 0x85, 0xED }); // ? test r13, r13
+  size_t empty = assembler.Jump({ 0x0F, 0x84 });
+  size_t loop = assembler.code.size();
+
+  for (const Instruction &instruction : program.code) {
+    int a = depth - 2;
+    int b = depth - 1;
+
+    switch (instruction.opCode) {
+      case OpCode::Push:
+        assembler.MoveConstant(depth, instruction.value);
+        nonZero[depth++] = instruction.value != 0;
+        continue;
+      case OpCode::Load:
+        assembler.LoadColumn(depth, instruction.slot);
+        nonZero[depth++] = false;
+        continue;
+      case OpCode::SquareRoot:
+        assembler.ScalarOperation(0x51, b, b);
+        break;
+      case OpCode::Absolute:
+      case OpCode::Exponential:
+      case OpCode::Logarithm:
+      case OpCode::Sine:
+      case OpCode::Cosine:
+        assembler.Call(b, static_cast<char>(instruction.opCode));
+        break;
+      case OpCode::PowerInt:
+        assembler.PowerInt(b, instruction.slot);
+        break;
+      case OpCode::Add:
+        assembler.ScalarOperation(0x58, a, b);
+        break;
+      case OpCode::Subtract:
+        assembler.ScalarOperation(0x5C, a, b);
+        break;
+      case OpCode::Multiply:
+        assembler.ScalarOperation(0x59, a, b);
+        break;
+      case OpCode::Divide:
+        if (nonZero[b]) {
+          assembler.ScalarOperation(0x5E, a, b);
+        } else {
+          assembler.Divide(a, b);
+        }
+        break;
+      case OpCode::Minimum:
+        assembler.ScalarOperation(0x5D, a, b); // ? minsd
+        break;
+      case OpCode::Maximum:
+        assembler.ScalarOperation(0x5F, a, b); // ? maxsd
+        break;
+      case OpCode::Power:
+      case OpCode::Root:
+        assembler.Call(a, static_cast<char>(instruction.opCode));
+        break;
+    }
+
+    if (!IsUnary(instruction.opCode)) {
+      depth--;
+    }
+
+    nonZero[depth - 1] = false;
+  }
+
+  assembler.Emit({ 0xF2, 0x43, 0x0F, 0x11, 0x04, 0xE6 }); // ? movsd [r14 + r12 * 8], xmm0
+  assembler.Emit({ 0x49, 0xFF, 0xC4, 0x4D, 0x39, 0xEC }); // ? inc r12; cmp r12, r13
+  size_t back = assembler.Jump({ 0x0F, 0x82 }); // ? jb loop
+  uint32_t displacement = static_cast<uint32_t>(loop - (back + 4));
+  memcpy(&assembler.code[back], &displacement, sizeof(displacement));
+  assembler.Patch(empty);
+  assembler.Emit({ 0x48, 0x81, 0xC4 }); // ? add rsp, 136
+  assembler.Emit32(136);
+  assembler.Emit({ 0x41, 0x5F, 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0xC3 }); // ? pop r15 to r12; ret
+
+  size_t size = assembler.code.size();
+  void *pages = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  if (pages == MAP_FAILED) {
+    return false;
+  }
+
+  memcpy(pages, assembler.code.data(), size);
+
+  // ? Never writable and executable at once
+  if (mprotect(pages, size, PROT_READ | PROT_EXEC)) {
+    munmap(pages, size);
+    return false;
+  }
+
+  jit.pages = pages;
+  jit.size = size;
+  jit.function = reinterpret_cast<JitFunction>(pages);
+  return true;
+}
+#endif
+
+
+enum class SimdLevel {
+  Scalar,
+  Sse2,
+  Avx2
+};
+
+
+// * Picks the widest instruction set the running CPU supports
+SimdLevel DetectSimdLevel() {
+#ifdef HAS_X86_SIMD
+  __builtin_cpu_init();
+
+  if (__builtin_cpu_supports("avx2")) return SimdLevel::Avx2;
+  if (__builtin_cpu_supports("sse2")) return SimdLevel::Sse2;
+#endif
+  return SimdLevel::Scalar;
+}
+
+
+SimdLevel simdLevel = DetectSimdLevel();
+
+
+#ifdef HAS_X86_SIMD
+// ? Wrapped so std::vector keeps the vector alignment
+struct alignas(32) Avx2Lanes { __m256d value; };
+struct alignas(16) Sse2Lanes { __m128d value; };
+
+
+/*
+  * Evaluates program for 4 rows at a time with a stack of AVX vectors.
+  * + - * / min max sqrt abs and the fast tier of the other functions match RunProgram bit for bit,
+  * the rest goes through PerformOperation and PerformFunction lane by lane.
+  * Returns the number of rows evaluated, the caller finishes the remainder.
+*/
+__attribute__((target("avx2")))
+size_t RunProgramAvx2(const Program &program, const double *const *columns, size_t rows, double *results, std::vector<Avx2Lanes> &stack, bool &divisionByZero) {
+  size_t row = 0;
+
+  if (stack.size() < static_cast<size_t>(program.maxDepth)) {
+    stack.resize(program.maxDepth);
+  }
+
+  for (; row + 4 <= rows; row += 4) {
+    __m256d *top = &stack.data()->value; // ? One past the topmost vector
+
+    for (const Instruction &instruction : program.code) {
+      if (instruction.opCode == OpCode::Push) {
+        *top++ = _mm256_set1_pd(instruction.value);
+        continue;
+      }
+
+      if (instruction.opCode == OpCode::Load) {
+        *top++ = _mm256_loadu_pd(columns[instruction.slot] + row);
+        continue;
+      }
+
+      if (instruction.opCode == OpCode::SquareRoot) {
+        top[-1] = _mm256_sqrt_pd(top[-1]);
+        continue;
+      }
+
+      // ? Same multiplication chain as PowerBySquaring, so the results match it bit for bit
+      if (instruction.opCode == OpCode::PowerInt) {
+        __m256d base = top[-1], result = _mm256_set1_pd(1);
+
+        for (int exponent = instruction.slot; exponent; exponent >>= 1) {
+          if (exponent & 1) {
+            result = _mm256_mul_pd(result, base);
+          }
+
+          base = _mm256_mul_pd(base, base);
+        }
+
+        top[-1] = result;
+        continue;
+      }
+
+      if (IsUnary(instruction.opCode)) {
+        if (PerformFunctionLanes<Double4>(reinterpret_cast<Double4&>(top[-1]), instruction.opCode, program.fastFunctions)) {
+          continue;
+        }
+
+        alignas(32) double a[4];
+        _mm256_store_pd(a, top[-1]);
+
+        for (int lane = 0; lane < 4; ++lane) {
+          a[lane] = PerformUnaryOperation(a[lane], instruction, program.fastFunctions);
+        }
+
+        top[-1] = _mm256_load_pd(a);
+        continue;
+      }
+
+      __m256d num2 = *--top; // ? Second operand
+      __m256d &num1 = top[-1];
+
+      switch (instruction.opCode) {
+        case OpCode::Add:
+          num1 = _mm256_add_pd(num1, num2);
+          break;
+        case OpCode::Subtract:
+          num1 = _mm256_sub_pd(num1, num2);
+          break;
+        case OpCode::Multiply:
+          num1 = _mm256_mul_pd(num1, num2);
+          break;
+        case OpCode::Minimum:
+          num1 = _mm256_min_pd(num1, num2);
+          break;
+        case OpCode::Maximum:
+          num1 = _mm256_max_pd(num1, num2);
+          break;
+        case OpCode::Divide: {
+          // ? Lanes dividing by zero give -1, like ColumnOperation
+          __m256d isZero = _mm256_cmp_pd(num2, _mm256_setzero_pd(), _CMP_EQ_OQ);
+          divisionByZero |= _mm256_movemask_pd(isZero) != 0;
+          num1 = _mm256_blendv_pd(_mm256_div_pd(num1, num2), _mm256_set1_pd(-1), isZero);
+          break;
+        }
+        default: {
+          alignas(32) double a[4], b[4];
+          _mm256_store_pd(a, num1);
+          _mm256_store_pd(b, num2);
+
+          for (int lane = 0; lane < 4; ++lane) {
+            a[lane] = PerformOperation(a[lane], b[lane], static_cast<char>(instruction.opCode));
+          }
+
+          num1 = _mm256_load_pd(a);
+        }
+      }
+    }
+
+    _mm256_storeu_pd(results + row, top[-1]);
+  }
+
+  return row;
+}
+
+
+// * SSE2 version of RunProgramAvx2, 2 rows at a time
+size_t RunProgramSse2(const Program &program, const double *const *columns, size_t rows, double *results, std::vector<Sse2Lanes> &stack, bool &divisionByZero) {
+  size_t row = 0;
+
+  if (stack.size() < static_cast<size_t>(program.maxDepth)) {
+    stack.resize(program.maxDepth);
+  }
+
+  for (; row + 2 <= rows; row += 2) {
+    __m128d *top = &stack.data()->value; // ? One past the topmost vector
+
+    for (const Instruction &instruction : program.code) {
+      if (instruction.opCode == OpCode::Push) {
+        *top++ = _mm_set1_pd(instruction.value);
+        continue;
+      }
+
+      if (instruction.opCode == OpCode::Load) {
+        *top++ = _mm_loadu_pd(columns[instruction.slot] + row);
+        continue;
+      }
+
+      if (instruction.opCode == OpCode::SquareRoot) {
+        top[-1] = _mm_sqrt_pd(top[-1]);
+        continue;
+      }
+
+      if (instruction.opCode == OpCode::PowerInt) {
+        __m128d base = top[-1], result = _mm_set1_pd(1);
+
+        for (int exponent = instruction.slot; exponent; exponent >>= 1) {
+          if (exponent & 1) {
+            result = _mm_mul_pd(result, base);
+          }
+
+          base = _mm_mul_pd(base, base);
+        }
+
+        top[-1] = result;
+        continue;
+      }
+
+      if (IsUnary(instruction.opCode)) {
+        if (PerformFunctionLanes<Double2>(reinterpret_cast<Double2&>(top[-1]), instruction.opCode, program.fastFunctions)) {
+          continue;
+        }
+
+        alignas(16) double a[2];
+        _mm_store_pd(a, top[-1]);
+
+        for (int lane = 0; lane < 2; ++lane) {
+          a[lane] = PerformUnaryOperation(a[lane], instruction, program.fastFunctions);
+        }
+
+        top[-1] = _mm_load_pd(a);
+        continue;
+      }
+
+      __m128d num2 = *--top; // ? Second operand
+      __m128d &num1 = top[-1];
+
+      switch (instruction.opCode) {
+        case OpCode::Add:
+          num1 = _mm_add_pd(num1, num2);
+          break;
+        case OpCode::Subtract:
+          num1 = _mm_sub_pd(num1, num2);
+          break;
+        case OpCode::Multiply:
+          num1 = _mm_mul_pd(num1, num2);
+          break;
+        case OpCode::Minimum:
+          num1 = _mm_min_pd(num1, num2);
+          break;
+        case OpCode::Maximum:
+          num1 = _mm_max_pd(num1, num2);
+          break;
+        case OpCode::Divide: {
+          // ? SSE2 has no blend, so the -1 lanes are merged in with masks
+          __m128d isZero = _mm_cmpeq_pd(num2, _mm_setzero_pd());
+          divisionByZero |= _mm_movemask_pd(isZero) != 0;
+          num1 = _mm_or_pd(_mm_andnot_pd(isZero, _mm_div_pd(num1, num2)), _mm_and_pd(isZero, _mm_set1_pd(-1)));
+          break;
+        }
+        default: {
+          alignas(16) double a[2], b[2];
+          _mm_store_pd(a, num1);
+          _mm_store_pd(b, num2);
+
+          for (int lane = 0; lane < 2; ++lane) {
+            a[lane] = PerformOperation(a[lane], b[lane], static_cast<char>(instruction.opCode));
+          }
+
+          num1 = _mm_load_pd(a);
+        }
+      }
+    }
+
+    _mm_storeu_pd(results + row, top[-1]);
+  }
+
+  return row;
+}
+#endif
+
+
+// * Stacks of RunProgramColumns, owned by the caller and kept between calls like the ValueStack of RunProgram
+struct ColumnStacks {
+  ValueStack values;
+  std::vector<double> variables; // ? Values of one row for RunProgram
+#ifdef HAS_X86_SIMD
+  std::vector<Avx2Lanes> avx2;
+  std::vector<Sse2Lanes> sse2;
+#endif
+#ifdef HAS_COMPUTED_GOTO
+  ThreadedProgram threaded; // ? Compiled once for threadedSource, a ColumnStacks is meant to follow a single program
+  const Program *threadedSource = nullptr;
+#endif
+};
+
+
+/*
+  * Evaluates program once per row, columns[slot][row] being the value of variable slot in that row.
+  * Uses the widest kernel simdLevel allows and runs the leftover rows through RunColumnRow.
+  * A division by zero gives -1 and sets dividedByZero, whichever of them evaluates the row.
+*/
+void RunProgramColumns(const Program &program, const double *const *columns, size_t rows, double *results, ColumnStacks &stacks) {
+  size_t row = 0;
+
+#ifdef HAS_X86_SIMD
+  if (simdLevel == SimdLevel::Avx2) {
+    row = RunProgramAvx2(program, columns, rows, results, stacks.avx2, dividedByZero);
+  } else if (simdLevel == SimdLevel::Sse2) {
+    row = RunProgramSse2(program, columns, rows, results, stacks.sse2, dividedByZero);
+  }
+#endif
+
+  std::vector<double> &variables = stacks.variables;
+  ValueStack &stack = stacks.values;
+
+  variables.resize(program.variables.size());
+
+#ifdef HAS_COMPUTED_GOTO
+  // ? Threading the program only pays off over enough rows
+  if (rows - row >= THREADED_MIN_ROWS) {
+    ThreadedProgram &threaded = stacks.threaded;
+
+    if (stacks.threadedSource != &program) {
+      CompileThreaded(program, threaded);
+      stacks.threadedSource = &program;
+    }
+
+    for (; row < rows; ++row) {
+      for (size_t slot = 0; slot < variables.size(); ++slot) {
+        variables[slot] = columns[slot][row];
+      }
+
+      results[row] = RunThreaded(&threaded, &stack, variables.data());
+    }
+  }
+#endif
+
+  for (; row < rows; ++row) {
+    for (size_t slot = 0; slot < variables.size(); ++slot) {
+      variables[slot] = columns[slot][row];
+    }
+
+    results[row] = RunColumnRow(program, stack, variables.data());
+  }
+}
+
+
+struct CacheEntry {
+  std::string key; // ? Cleaned expression text
+  Program program;
+  bool hasResult = false;
+  double result = 0;
+};
+
+
+/*
+  * Bounded LRU cache from cleaned expression text to its compiled program.
+  * With cacheResults set the evaluated result is kept as well, so repeats skip evaluation too.
+*/
+struct ProgramCache {
+  std::list<CacheEntry> entries; // ? Most recently used first
+  std::unordered_map<std::string_view, std::list<CacheEntry>::iterator> index; // ? Keys point into entries
+  size_t memoryLimit;
+  size_t memoryUsed = 0;
+  bool cacheResults = false;
+
+  size_t hits = 0;
+  size_t misses = 0;
+  size_t evictions = 0;
+
+  explicit ProgramCache(size_t limit) : memoryLimit(limit) {}
+
+  // ? Rough heap footprint of an entry, including the list node and the index slot
+  static size_t EntrySize(const CacheEntry &entry) {
+    return sizeof(CacheEntry) + 2 * sizeof(void*) +
+      sizeof(std::string_view) + 4 * sizeof(void*) +
+      entry.key.capacity() + entry.program.code.capacity() * sizeof(Instruction);
+  }
+
+  CacheEntry *Find(std::string_view key) {
+    auto found = index.find(key);
+
+    if (found == index.end()) {
+      misses++;
+      return nullptr;
+    }
+
+    hits++;
+    entries.splice(entries.begin(), entries, found->second);
+    return &*found->second;
+  }
+
+  // ? Returns nullptr if the entry alone is larger than the whole cache
+  CacheEntry *Insert(std::string_view key, const Program &program) {
+    entries.push_front({ std::string(key), program });
+    size_t size = EntrySize(entries.front());
+
+    if (size > memoryLimit) {
+      entries.pop_front();
+      return nullptr;
+    }
+
+    while (memoryUsed + size > memoryLimit) {
+      memoryUsed -= EntrySize(entries.back());
+      index.erase(entries.back().key);
+      entries.pop_back();
+      evictions++;
+    }
+
+    memoryUsed += size;
+    index[entries.front().key] = entries.begin();
+    return &entries.front();
+  }
+};
+
+
+void PrintVector(const TokenList &input) {
+  int totalLen = 0;
+
+  for (std::string_view s : input) {
+    totalLen += s.length();
+  }
+
+  totalLen += (input.size() * 2);
+
+  for (int i = input.size(); i > 2; --i) {
+    if (i & 1) {
+      totalLen += 2;
+    }
+  }
+
+  std::cout << "\e[1;36m╭";
+
+  for (int i = 0; i < totalLen; ++i) {
+    std::cout << "─";
+  }
+
+  std::cout << "╮\n│";
+
+  for (std::string_view s : input) {
+    std::cout << "\e[1;37m " << s << " \e[1;36m│";
+  }
+
+  std::cout << "\n╰";
+
+  for (int i = 0; i < totalLen; ++i) {
+    std::cout << "─";
+  }
+
+  std::cout << "╯\n";
+}
+
+
+// * Collects output and writes it to stdout in large blocks
+struct BufferedWriter {
+  std::string buffer;
+
+  BufferedWriter() { buffer.reserve(WRITE_BUFFER_SIZE); }
+  ~BufferedWriter() { Flush(); }
+
+  void Write(const char *data, size_t length) {
+    buffer.append(data, length);
+
+    if (buffer.size() >= WRITE_BUFFER_SIZE) {
+      Flush();
+    }
+  }
+
+  void WriteNumber(double value) {
+    AppendNumber(buffer, value);
+
+    if (buffer.size() >= WRITE_BUFFER_SIZE) {
+      Flush();
+    }
+  }
+
+  void Flush() {
+    fwrite(buffer.data(), 1, buffer.size(), stdout);
+    buffer.clear();
+  }
+};
+
+
+/*
+  * Bounded queue between exactly one producer thread and one consumer thread, without locks.
+  * Each side only writes its own index, and the release store of it publishes the slot it just filled or emptied.
+  * TryPush and TryPop never wait, callers decide how to.
+*/
+template <typename T, size_t capacity>
+struct SpscRing {
+  static_assert((capacity & (capacity - 1)) == 0, "SpscRing capacity has to be a power of two");
+
+  T items[capacity];
+  alignas(64) std::atomic<size_t> head{0}; // ? Next slot to pop, only written by the consumer
+  alignas(64) std::atomic<size_t> tail{0}; // ? Next slot to push, only written by the producer
+
+  bool TryPush(const T &item) {
+    size_t position = tail.load(std::memory_order_relaxed);
+
+    if (position - head.load(std::memory_order_acquire) == capacity) {
+      return false;
+    }
+
+    items[position & (capacity - 1)] = item;
+    tail.store(position + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool TryPop(T &item) {
+    size_t position = head.load(std::memory_order_relaxed);
+
+    if (position == tail.load(std::memory_order_acquire)) {
+      return false;
+    }
+
+    item = items[position & (capacity - 1)];
+    head.store(position + 1, std::memory_order_release);
+    return true;
+  }
+
+  // ? Only exact when called from one of the two threads, the other may be moving its index meanwhile
+  size_t Size() const {
+    return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+  }
+};
+
+
+/*
+  * Thread pool where every worker owns a deque of tasks.
+  * Workers run tasks from the front of their own deque and steal from the back of the others once it runs dry.
+*/
+struct WorkStealingPool {
+  using Task = std::function<void(int worker)>;
+
+  struct WorkerQueue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  std::vector<std::unique_ptr<WorkerQueue>> queues;
+  std::vector<std::thread> workers;
+  std::mutex sleepMutex;
+  std::condition_variable wakeUp;
+  size_t queuedTasks = 0; // ? Tasks not yet claimed by a worker, guarded by sleepMutex
+  size_t nextQueue = 0;
+  bool stopping = false;
+
+  explicit WorkStealingPool(int threadCount) {
+    for (int i = 0; i < threadCount; ++i) {
+      queues.push_back(std::make_unique<WorkerQueue>());
+    }
+
+    for (int i = 0; i < threadCount; ++i) {
+      workers.emplace_back([this, i] { WorkerLoop(i); });
+    }
+  }
+
+  // ? Runs every task that was submitted before returning
+  ~WorkStealingPool() {
+    {
+      std::lock_guard<std::mutex> lock(sleepMutex);
+      stopping = true;
+    }
+
+    wakeUp.notify_all();
+
+    for (std::thread &worker : workers) {
+      worker.join();
+    }
+  }
+
+  // ? Tasks are dealt round robin, stealing evens out whatever imbalance is left
+  void Submit(Task task) {
+    WorkerQueue &queue = *queues[nextQueue++ % queues.size()];
+
+    {
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      queue.tasks.push_back(std::move(task));
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(sleepMutex);
+      queuedTasks++;
+    }
+
+    wakeUp.notify_one();
+  }
+
+  bool TryTake(int worker, Task &task) {
+    for (size_t i = 0; i < queues.size(); ++i) {
+      WorkerQueue &queue = *queues[(worker + i) % queues.size()];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+
+      if (queue.tasks.empty()) {
+        continue;
+      }
+
+      if (i == 0) {
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+      } else {
+        task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+      }
+
+      return true;
+    }
+
+    return false;
+  }
+
+  void WorkerLoop(int worker) {
+    Task task;
+
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wakeUp.wait(lock, [this] { return queuedTasks > 0 || stopping; });
+
+        if (!queuedTasks) {
+          return;
+        }
+
+        queuedTasks--; // ? Claims one task, so one is guaranteed to be in some queue
+      }
+
+      while (!TryTake(worker, task)) {
+        std::this_thread::yield();
+      }
+
+      task(worker);
+    }
+  }
+};
+
+
+// * Reusable buffers of one batch worker
+struct BatchContext {
+  Arena arena; // ? Backs the tokens, the operator stack and the value stack of the current line
+  Program program;
+  std::unique_ptr<ProgramCache> cache; // ? Null when caching is off
+  size_t allocations = 0; // ? Heap allocations made while evaluating lines
+  size_t allocatingLines = 0;
+  size_t compiledInstructions = 0; // ? Instructions compiled and how many of them the optimizer removed
+  size_t removedInstructions = 0;
+};
+
+
+// * A line of batch input, either in a chunk buffer or in the mapped input file
+struct LineSpan {
+  char *data;
+  size_t length;
+};
+
+
+// * Lines read from the batch input, evaluated as one unit of work
+struct BatchChunk {
+  std::vector<std::string> buffers; // ? Line storage when reading from a stream
+  std::vector<LineSpan> lines;
+  size_t lineCount = 0;
+  size_t endOffset = 0; // ? Offset just past the last line when reading a mapped file
+  std::string output;
+  bool done = false;
+};
+
+
+bool fusedEvaluation = false; // ? Set with --fused, evaluates lines with FusedEvaluation instead of compiling them
+
+
+/*
+  * Evaluates one cleaned batch line and appends its result, or "error" if it does not compile or divides by zero, to output.
+  * When the context has a cache, repeated lines skip tokenising and compiling.
+*/
+void EvaluateLine(std::string_view line, BatchContext &context, std::string &output) {
+  ProgramCache *cache = context.cache.get();
+  CacheEntry *entry = cache ? cache->Find(line) : nullptr;
+
+  // ? main() turns --fused down together with a cache, nothing is compiled so there would be nothing to cache
+  if (fusedEvaluation) {
+    double result;
+    FusedStatus status = FusedEvaluation(line, result);
+
+    if (status == FusedStatus::Ok) {
+      AppendNumber(output, result);
+      return;
+    }
+
+    if (status != FusedStatus::TooDeep) {
+      output += "error\n";
+      return;
+    }
+  }
+
+  context.arena.Reset();
+  ValueStack stack(&context.arena);
+
+  if (!entry) {
+    TokenList tokens(&context.arena);
+
+    tokens.reserve(line.length() * 2 + 1); // ? Implicit '*' can at most double the token count
+    Tokenise(tokens, line);
+    InfixToPostfix(tokens);
+
+    if (CompilePostfix(tokens, context.program, engineOptions)) {
+      output += "error\n";
+      return;
+    }
+
+    // ? Batch lines have nothing to bind variables to
+    if (!context.program.variables.empty()) {
+      STATS_ERROR(StatError::UnknownVariable);
+      output += "error\n";
+      return;
+    }
+
+    context.compiledInstructions += context.program.code.size();
+
+    if (engineOptions.optimize) {
+      context.removedInstructions += OptimizeProgram(context.program, &context.arena);
+    }
+
+    entry = cache ? cache->Insert(line, context.program) : nullptr;
+  }
+
+  double result;
+
+  if (entry && entry->hasResult) {
+    result = entry->result;
+  } else {
+    // ? A division by zero is an error like in --precision
+    if (RunProgram(entry ? entry->program : context.program, stack, result)) {
+      output += "error\n";
+      return;
+    }
+
+    if (entry && cache->cacheResults && entry->program.variables.empty()) {
+      entry->result = result;
+      entry->hasResult = true;
+    }
+  }
+
+  AppendNumber(output, result);
+}
+
+
+void EvaluateChunk(BatchChunk &chunk, BatchContext &context) {
+  chunk.output.clear();
+
+  for (size_t i = 0; i < chunk.lineCount; ++i) {
+    LineSpan &line = chunk.lines[i];
+
+    size_t allocationsBefore = heapAllocations;
+
+    line.length = CleanRange(line.data, line.length);
+    EvaluateLine(std::string_view(line.data, line.length), context, chunk.output);
+
+    if (heapAllocations != allocationsBefore) {
+      context.allocations += heapAllocations - allocationsBefore;
+      context.allocatingLines++;
+    }
+  }
+}
+
+
+struct BatchCase {
+  const char *line;
+  const char *output; // ? What --batch prints for it, with and without --fused
+};
+
+
+const BatchCase batchCases[] = {
+  { "1000000000000000000000000000000000000000000000000000000000000000000000", "1e+69\n" }, // ? Longer than any buffer a number used to be cut to
+  { "0.00000000000000000000000000000000000000000000000000000000000000001234", "1.234e-65\n" },
+  { "--5", "error\n" },
+  { "5.-3", "error\n" },
+  { "2.52.5+1", "error\n" },
+  { "1/0", "error\n" },
+  { "2+1/(3-3)*0", "error\n" },
+  { "1+2*3", "7\n" }
+};
+
+
+// * Runs every batchCases line through EvaluateLine, compiled and fused, and counts the outputs that differ
+bool CheckBatch() {
+  BatchContext context;
+  size_t mismatches = 0;
+
+  for (bool fused : { false, true }) {
+    fusedEvaluation = fused;
+
+    for (const BatchCase &batchCase : batchCases) {
+      std::string line = batchCase.line;
+      std::string output;
+
+      CleanString(line);
+      EvaluateLine(line, context, output);
+
+      if (output != batchCase.output) {
+        std::cerr << batchCase.line << (fused ? " (fused)" : "") << ": expected " << batchCase.output << "  got " << output;
+        mismatches++;
+      }
+    }
+  }
+
+  std::cerr << mismatches << " mismatches\n";
+  return !mismatches;
+}
+
+
+// * Reads up to BATCH_CHUNK_LINES lines into chunk, returns false once the input is exhausted
+bool ReadChunk(std::istream &inputStream, BatchChunk &chunk) {
+  chunk.buffers.resize(BATCH_CHUNK_LINES);
+  chunk.lines.resize(BATCH_CHUNK_LINES);
+  chunk.lineCount = 0;
+  chunk.done = false;
+
+  while (chunk.lineCount < BATCH_CHUNK_LINES && getline(inputStream, chunk.buffers[chunk.lineCount])) {
+    std::string &buffer = chunk.buffers[chunk.lineCount];
+    chunk.lines[chunk.lineCount++] = { buffer.data(), buffer.length() };
+  }
+
+  return chunk.lineCount > 0;
+}
+
+
+/*
+  * A file mapped copy-on-write, so lines can be cleaned in place without copying them or touching the file.
+  * Only available on POSIX systems, elsewhere Map fails and callers read the file as a stream.
+*/
+struct MappedFile {
+  char *data = nullptr;
+  size_t size = 0;
+  size_t released = 0; // ? Pages below this offset have been handed back
+
+  bool Map(const std::string &path) {
+#ifdef HAS_MMAP
+    int descriptor = open(path.c_str(), O_RDONLY);
+    struct stat info;
+
+    if (descriptor < 0) {
+      return false;
+    }
+
+    // ? Pipes and empty files cannot be mapped
+    if (fstat(descriptor, &info) || !S_ISREG(info.st_mode) || !info.st_size) {
+      close(descriptor);
+      return false;
+    }
+
+    void *mapping = mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, descriptor, 0);
+    close(descriptor);
+
+    if (mapping == MAP_FAILED) {
+      return false;
+    }
+
+    madvise(mapping, info.st_size, MADV_SEQUENTIAL);
+    data = static_cast<char*>(mapping);
+    size = info.st_size;
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  // ? Drops the pages below offset, including the private copies made while cleaning lines
+  void Release(size_t offset) {
+#ifdef HAS_MMAP
+    size_t pageSize = sysconf(_SC_PAGESIZE);
+    size_t end = offset / pageSize * pageSize;
+
+    if (end > released) {
+      madvise(data + released, end - released, MADV_DONTNEED);
+      released = end;
+    }
+#endif
+  }
+
+  ~MappedFile() {
+#ifdef HAS_MMAP
+    if (data) {
+      munmap(data, size);
+    }
+#endif
+  }
+};
+
+
+// * Slices up to BATCH_CHUNK_LINES lines of file into chunk, starting at offset
+bool MapChunk(const MappedFile &file, size_t &offset, BatchChunk &chunk) {
+  chunk.lines.resize(BATCH_CHUNK_LINES);
+  chunk.lineCount = 0;
+  chunk.done = false;
+
+  while (chunk.lineCount < BATCH_CHUNK_LINES && offset < file.size) {
+    char *start = file.data + offset;
+    char *newline = static_cast<char*>(memchr(start, '\n', file.size - offset));
+    size_t length = newline ? newline - start : file.size - offset;
+
+    chunk.lines[chunk.lineCount++] = { start, length };
+    offset = std::min(offset + length + 1, file.size);
+  }
+
+  chunk.endOffset = offset;
+  return chunk.lineCount > 0;
+}
+
+
+void PrintCacheStats(const std::vector<BatchContext> &contexts) {
+  size_t hits = 0, misses = 0, evictions = 0, entries = 0, memoryUsed = 0;
+
+  for (const BatchContext &context : contexts) {
+    hits += context.cache->hits;
+    misses += context.cache->misses;
+    evictions += context.cache->evictions;
+    entries += context.cache->entries.size();
+    memoryUsed += context.cache->memoryUsed;
+  }
+
+  std::cerr << "Cache: " << hits << " hits, " << misses << " misses, "
+    << evictions << " evictions, "
+    << ((hits + misses) ? 100.0 * hits / (hits + misses) : 0) << "% hit rate, "
+    << entries << " entries, " << memoryUsed << " bytes\n";
+}
+
+
+/*
+  * Evaluates every line of inputStream and writes one result per line to stdout.
+  * Lines that do not compile print "error" and the batch carries on.
+  * With more than one thread, chunks of lines run on a work stealing pool and are written back in input order.
+  * cacheBytes is split evenly between the per thread caches, 0 turns caching off.
+  * When mappedFile is given, lines are read from it in place instead of from inputStream.
+*/
+void RunBatch(std::istream &inputStream, MappedFile *mappedFile, int threadCount, size_t cacheBytes, bool cacheResults) {
+  std::vector<BatchContext> contexts(threadCount);
+  BufferedWriter writer;
+  size_t lineCount = 0;
+  size_t mappedOffset = 0;
+
+  auto readChunk = [&](BatchChunk &chunk) {
+    return mappedFile ? MapChunk(*mappedFile, mappedOffset, chunk) : ReadChunk(inputStream, chunk);
+  };
+
+  // ? Mapped pages are only released once every line on them has been written
+  auto writeChunk = [&](const BatchChunk &chunk) {
+    writer.Write(chunk.output.data(), chunk.output.size());
+
+    if (mappedFile) {
+      mappedFile->Release(chunk.endOffset);
+    }
+  };
+
+  for (BatchContext &context : contexts) {
+    if (cacheBytes) {
+      context.cache = std::make_unique<ProgramCache>(cacheBytes / threadCount);
+      context.cache->cacheResults = cacheResults;
+    }
+  }
+
+  auto start = std::chrono::steady_clock::now();
+
+  if (threadCount == 1) {
+    BatchChunk chunk;
+
+    while (readChunk(chunk)) {
+      lineCount += chunk.lineCount;
+      EvaluateChunk(chunk, contexts[0]);
+      writeChunk(chunk);
+    }
+  } else {
+    std::deque<std::unique_ptr<BatchChunk>> inFlight; // ? Oldest first, which is the order they are written in
+    std::vector<std::unique_ptr<BatchChunk>> spare;
+    std::mutex doneMutex;
+    std::condition_variable chunkDone;
+    WorkStealingPool pool(threadCount);
+
+    auto writeOldest = [&]() {
+      BatchChunk &oldest = *inFlight.front();
+
+      {
+        std::unique_lock<std::mutex> lock(doneMutex);
+        chunkDone.wait(lock, [&] { return oldest.done; });
+      }
+
+      writeChunk(oldest);
+      spare.push_back(std::move(inFlight.front()));
+      inFlight.pop_front();
+    };
+
+    while (true) {
+      std::unique_ptr<BatchChunk> chunk;
+
+      if (spare.empty()) {
+        chunk = std::make_unique<BatchChunk>();
+      } else {
+        chunk = std::move(spare.back());
+        spare.pop_back();
+      }
+
+      if (!readChunk(*chunk)) {
+        break;
+      }
+
+      BatchChunk *task = chunk.get();
+      lineCount += task->lineCount;
+      inFlight.push_back(std::move(chunk));
+
+      pool.Submit([&, task](int worker) {
+        EvaluateChunk(*task, contexts[worker]);
+
+        std::lock_guard<std::mutex> lock(doneMutex);
+        task->done = true;
+        chunkDone.notify_all();
+      });
+
+      // ? Bounds the memory held by chunks that are read but not yet written
+      if (inFlight.size() >= static_cast<size_t>(threadCount) * 4) {
+        writeOldest();
+      }
+    }
+
+    while (!inFlight.empty()) {
+      writeOldest();
+    }
+  }
+
+  writer.Flush();
+
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  std::cerr << lineCount << " lines in " << elapsed.count() << "s on " << threadCount << " threads ("
+    << lineCount / elapsed.count() << " lines/s)\n";
+
+  size_t allocations = 0, allocatingLines = 0, compiledInstructions = 0, removedInstructions = 0;
+
+  for (const BatchContext &context : contexts) {
+    allocations += context.allocations;
+    allocatingLines += context.allocatingLines;
+    compiledInstructions += context.compiledInstructions;
+    removedInstructions += context.removedInstructions;
+  }
+
+  std::cerr << "Heap allocations: " << allocations << " while evaluating, in " << allocatingLines << " of " << lineCount << " lines\n";
+
+  // ? --fused only compiles the lines nested too deeply for it
+  if (engineOptions.optimize && compiledInstructions) {
+    std::cerr << "Optimizer removed " << removedInstructions << " of " << compiledInstructions << " instructions\n";
+  }
+
+  if (cacheBytes) {
+    PrintCacheStats(contexts);
+  }
+}
+
+
+/*
+  * Thread scaling of --batch over the corpus in inputStream, at 1, 2, 4 ... threads up to maxThreads.
+  * Each count is the best of three runs over the same chunks, with nothing written, so only evaluation is timed.
+  * Prints one JSON object with the lines per second, the speedup over one thread and the efficiency, speedup / threads.
+*/
+void RunThreadBenchmark(std::istream &inputStream, int maxThreads) {
+  std::vector<std::unique_ptr<BatchChunk>> chunks;
+  size_t lineCount = 0;
+
+  while (true) {
+    chunks.push_back(std::make_unique<BatchChunk>());
+
+    if (!ReadChunk(inputStream, *chunks.back())) {
+      chunks.pop_back();
+      break;
+    }
+
+    lineCount += chunks.back()->lineCount;
+  }
+
+  std::vector<int> threadCounts;
+
+  for (int threads = 1; threads < maxThreads; threads *= 2) {
+    threadCounts.push_back(threads);
+  }
+
+  threadCounts.push_back(maxThreads);
+
+  std::string expected; // ? What one thread printed, every other count has to print the same
+  size_t mismatches = 0;
+
+  auto Run = [&](int threadCount) {
+    std::vector<BatchContext> contexts(threadCount);
+    auto start = std::chrono::steady_clock::now();
+
+    if (threadCount == 1) {
+      for (std::unique_ptr<BatchChunk> &chunk : chunks) {
+        EvaluateChunk(*chunk, contexts[0]);
+      }
+    } else {
+      WorkStealingPool pool(threadCount);
+
+      for (std::unique_ptr<BatchChunk> &chunk : chunks) {
+        BatchChunk *task = chunk.get();
+        pool.Submit([&, task](int worker) { EvaluateChunk(*task, contexts[worker]); });
+      }
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::string output;
+
+    for (const std::unique_ptr<BatchChunk> &chunk : chunks) {
+      output += chunk->output;
+    }
+
+    if (expected.empty()) {
+      expected = std::move(output);
+    } else if (output != expected) {
+      mismatches++;
+    }
+
+    return elapsed.count();
+  };
+
+  Run(1); // ? Warms the caches, and cleans the lines in place so every timed run sees the same text
+
+  printf("{\"implementation\": \"C++/Calculator-1.cpp\", \"lines\": %zu, \"hardware_threads\": %u, \"runs\": [", lineCount, std::thread::hardware_concurrency());
+  double baseline = 0;
+
+  for (size_t i = 0; i < threadCounts.size(); ++i) {
+    double seconds = Run(threadCounts[i]);
+
+    for (int run = 1; run < 3; ++run) {
+      seconds = std::min(seconds, Run(threadCounts[i]));
+    }
+
+    if (!i) {
+      baseline = seconds;
+    }
+
+    double speedup = baseline / seconds;
+    printf("%s{\"threads\": %d, \"seconds\": %.9f, \"lines_per_second\": %.1f, \"speedup\": %.3f, \"efficiency\": %.3f}", i ? ", " : "",
+      threadCounts[i], seconds, lineCount / seconds, speedup, speedup / threadCounts[i]);
+  }
+
+  printf("], \"mismatches\": %zu}\n", mismatches);
+}
+
+
+// * Chunk of lines on its way through RunPipelinedBatch, with what every stage made of them
+struct PipelineChunk {
+  BatchChunk batch; // ? Lines as read, cleaned in place by the tokenising stage
+  Arena arena; // ? Backs tokens, reset when the chunk is tokenised again
+  std::vector<TokenList> tokens;
+  std::vector<double> results;
+  std::vector<char> failed; // ? Lines that print "error"
+};
+
+
+// * What one stage of RunPipelinedBatch did, only written by the thread running it
+struct PipelineStageStats {
+  const char *name;
+  size_t chunks = 0;
+  double busySeconds = 0;
+  double starvedSeconds = 0; // ? Waiting for something in the input queue
+  size_t depthTotal = 0; // ? Input queue depth summed over every time the stage took from it
+  size_t depthMax = 0;
+  size_t takes = 0;
+};
+
+
+/*
+  * RunBatch as five stages on their own threads: reading, cleaning and tokenising, the shunting yard,
+  * compiling and evaluating, and formatting and writing. Chunks of lines go from stage to stage through SpscRings,
+  * and back from the writer to the reader once written, so at most PIPELINE_CHUNKS chunks exist at once.
+  * Prints how deep the input queue of every stage was. The stage with the deepest one is the bottleneck,
+  * the queue of the reader being the chunks nobody else has work for.
+*/
+void RunPipelinedBatch(std::istream &inputStream) {
+  typedef SpscRing<PipelineChunk*, PIPELINE_CHUNKS * 2> Ring; // ? Room for every chunk and the null that ends the stream
+  std::vector<std::unique_ptr<PipelineChunk>> chunks(PIPELINE_CHUNKS);
+  Ring rings[5]; // ? rings[i] feeds stage i, and rings[0] takes written chunks back to the reader
+  PipelineStageStats stats[5] = { { "read" }, { "tokenise" }, { "postfix" }, { "evaluate" }, { "write" } };
+  BufferedWriter writer;
+  size_t lineCount = 0;
+
+  for (std::unique_ptr<PipelineChunk> &chunk : chunks) {
+    chunk = std::make_unique<PipelineChunk>();
+    rings[0].TryPush(chunk.get());
+  }
+
+  auto ReadLines = [&](PipelineChunk &chunk) {
+    if (!ReadChunk(inputStream, chunk.batch)) {
+      return false;
+    }
+
+    lineCount += chunk.batch.lineCount;
+    return true;
+  };
+
+  auto TokeniseLines = [](PipelineChunk &chunk) {
+    chunk.tokens.clear();
+    chunk.arena.Reset();
+
+    for (size_t i = 0; i < chunk.batch.lineCount; ++i) {
+      LineSpan &line = chunk.batch.lines[i];
+      line.length = CleanRange(line.data, line.length);
+
+      TokenList &tokens = chunk.tokens.emplace_back(&chunk.arena);
+      tokens.reserve(line.length * 2 + 1); // ? Implicit '*' can at most double the token count
+      Tokenise(tokens, std::string_view(line.data, line.length));
+    }
+
+    return true;
+  };
+
+  auto PostfixLines = [](PipelineChunk &chunk) {
+    for (TokenList &tokens : chunk.tokens) {
+      InfixToPostfix(tokens);
+    }
+
+    return true;
+  };
+
+  Program program;
+  ValueStack stack;
+
+  auto EvaluateLines = [&](PipelineChunk &chunk) {
+    chunk.results.resize(chunk.tokens.size());
+    chunk.failed.assign(chunk.tokens.size(), false);
+
+    for (size_t i = 0; i < chunk.tokens.size(); ++i) {
+      if (CompilePostfix(chunk.tokens[i], program, engineOptions)) {
+        chunk.failed[i] = true;
+        continue;
+      }
+
+      // ? Batch lines have nothing to bind variables to
+      if (!program.variables.empty()) {
+        STATS_ERROR(StatError::UnknownVariable);
+        chunk.failed[i] = true;
+        continue;
+      }
+
+      if (engineOptions.optimize) {
+        OptimizeProgram(program, &chunk.arena);
+      }
+
+      chunk.failed[i] = static_cast<bool>(RunProgram(program, stack, chunk.results[i]));
+    }
+
+    return true;
+  };
+
+  auto WriteLines = [&](PipelineChunk &chunk) {
+    for (size_t i = 0; i < chunk.results.size(); ++i) {
+      if (chunk.failed[i]) {
+        writer.Write("error\n", 6);
+      } else {
+        writer.WriteNumber(chunk.results[i]);
+      }
+    }
+
+    return true;
+  };
+
+  // ? Moves chunks from rings[index] to the next ring until the null that ends the stream, which it passes on
+  auto RunStage = [&](int index, auto work) {
+    PipelineStageStats &stage = stats[index];
+    Ring &input = rings[index];
+    Ring &output = rings[(index + 1) % 5];
+    PipelineChunk *chunk;
+
+    while (true) {
+      auto waiting = std::chrono::steady_clock::now();
+      size_t depth;
+
+      while (!(depth = input.Size()) || !input.TryPop(chunk)) {
+        std::this_thread::yield();
+      }
+
+      auto started = std::chrono::steady_clock::now();
+      stage.starvedSeconds += std::chrono::duration<double>(started - waiting).count();
+      stage.depthTotal += depth;
+      stage.depthMax = std::max(stage.depthMax, depth);
+      stage.takes++;
+
+      // ? Only the reader ends the stream, and the chunk it could not fill is simply never used again
+      if (chunk && !work(*chunk)) {
+        chunk = nullptr;
+      }
+
+      stage.chunks += chunk != nullptr;
+
+      stage.busySeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+      // ? The written chunks go back to the reader, which has stopped by the time the null comes round
+      if (chunk || index != 4) {
+        while (!output.TryPush(chunk)) {
+          std::this_thread::yield();
+        }
+      }
+
+      if (!chunk) {
+        return;
+      }
+    }
+  };
+
+  auto start = std::chrono::steady_clock::now();
+
+  {
+    std::thread threads[] = {
+      std::thread(RunStage, 0, ReadLines),
+      std::thread(RunStage, 1, TokeniseLines),
+      std::thread(RunStage, 2, PostfixLines),
+      std::thread(RunStage, 3, EvaluateLines),
+      std::thread(RunStage, 4, WriteLines)
+    };
+
+    for (std::thread &thread : threads) {
+      thread.join();
+    }
+  }
+
+  writer.Flush();
+
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  std::cerr << lineCount << " lines in " << elapsed.count() << "s through 5 pipelined stages ("
+    << lineCount / elapsed.count() << " lines/s)\n";
+
+  std::cerr << "stage       chunks    busy s  starved s  queue mean  queue max\n";
+
+  for (const PipelineStageStats &stage : stats) {
+    fprintf(stderr, "%-9s %8zu %9.3f %10.3f %11.2f %10zu\n", stage.name, stage.chunks, stage.busySeconds, stage.starvedSeconds,
+      static_cast<double>(stage.depthTotal) / std::max<size_t>(1, stage.takes), stage.depthMax);
+  }
+}
+
+
+/*
+  * The current line of a stream, indexed like the string_view FusedEvaluation takes but never held whole.
+  * Only the characters CleanString keeps are stored, and once STREAM_WINDOW_SIZE of them are, the ones more than two
+  * before the character asked for are dropped, which FusedEvaluation never reads again on cleaned text.
+  * length() is SIZE_MAX until the end of the line has been read, and reads past the end give '\0'.
+*/
+struct StreamLine {
+  std::istream &stream;
+  std::vector<char> block; // ? Raw input read ahead, possibly holding the next lines too
+  size_t blockStart = 0, blockEnd = 0;
+  std::string window; // ? Cleaned characters of the line, from base on
+  size_t base = 0;
+  size_t lineLength = 0; // ? 0 before the first line, so NextLine has nothing to skip
+
+  explicit StreamLine(std::istream &stream) : stream(stream), block(READ_CHUNK_SIZE) {}
+
+  size_t length() const { return lineLength; }
+
+  char operator[](size_t index) {
+    while (index >= base + window.size() && lineLength == SIZE_MAX) {
+      Fill(index);
+    }
+
+    return (index < base + window.size()) ? window[index - base] : '\0';
+  }
+
+  bool Refill() {
+    stream.read(block.data(), block.size());
+    blockStart = 0;
+    blockEnd = stream.gcount();
+    return blockEnd > 0;
+  }
+
+  // ? Cleans up to STREAM_WINDOW_SIZE more raw characters into the window, ending the line at a newline or the end of the stream
+  void Fill(size_t index) {
+    if (window.size() >= STREAM_WINDOW_SIZE && index > base + 2) {
+      size_t dropped = std::min(index - 2 - base, window.size());
+      window.erase(0, dropped);
+      base += dropped;
+    }
+
+    if (blockStart == blockEnd && !Refill()) {
+      lineLength = base + window.size();
+      return;
+    }
+
+    const char *start = block.data() + blockStart;
+    size_t available = std::min<size_t>(blockEnd - blockStart, STREAM_WINDOW_SIZE);
+    const char *newline = static_cast<const char*>(memchr(start, '\n', available));
+    const char *end = newline ? newline : start + available;
+
+    for (const char *current = start; current < end; ++current) {
+      if (IsValid(*current)) {
+        window += *current;
+      }
+    }
+
+    blockStart = end - block.data() + (newline != nullptr);
+
+    if (newline) {
+      lineLength = base + window.size();
+    }
+  }
+
+  // ? Skips what is left of the current line and starts the next, false once the stream is exhausted
+  bool NextLine() {
+    while (lineLength == SIZE_MAX) {
+      base += window.size();
+      window.clear();
+      Fill(base);
+    }
+
+    base = 0;
+    window.clear();
+    lineLength = SIZE_MAX;
+    return blockStart < blockEnd || Refill();
+  }
+};
+
+
+// * Stacks of FusedEvaluation for --stream, grown as deep as each line needs up to maxDepth
+struct GrowingStacks {
+  std::vector<ExactValue> values;
+  std::vector<char> operators;
+  std::vector<int> arguments;
+  std::string number;
+  size_t maxDepth;
+  size_t maxTokens; // ? Values and operators pushed in one line
+  size_t maxLiteral; // ? Characters of one number, which is the only part of a line that is held whole
+  size_t tokens = 0;
+
+  GrowingStacks(size_t maxDepth, size_t maxTokens, size_t maxLiteral) : maxDepth(maxDepth), maxTokens(maxTokens), maxLiteral(maxLiteral) {}
+
+  bool Reserve(size_t count) {
+    if (count <= values.size()) {
+      return true;
+    }
+
+    if (count > maxDepth) {
+      return false;
+    }
+
+    size_t size = std::min(std::max<size_t>({ count, values.size() * 2, 64 }), maxDepth);
+    values.resize(size);
+    operators.resize(size);
+    arguments.resize(size);
+    return true;
+  }
+
+  bool CountToken() { return ++tokens <= maxTokens; }
+  bool FitsLiteral(size_t length) { return length <= maxLiteral; }
+};
+
+
+struct StreamCounts {
+  size_t lines = 0;
+  size_t errors = 0; // ? Including the lines over a limit
+  size_t tooDeep = 0;
+  size_t tooManyTokens = 0;
+  size_t literalsTooLong = 0;
+};
+
+
+// * Evaluates every line of inputStream with FusedEvaluation in bounded memory, handing each status and result to output
+template <typename Output>
+StreamCounts EvaluateStream(std::istream &inputStream, size_t maxDepth, size_t maxTokens, size_t maxLiteral, Output output) {
+  StreamLine line(inputStream);
+  GrowingStacks stacks(maxDepth, maxTokens, maxLiteral);
+  StreamCounts counts;
+
+  while (line.NextLine()) {
+    double result = 0;
+    stacks.tokens = 0;
+    FusedStatus status = FusedEvaluation(line, result, stacks);
+
+    counts.lines++;
+    counts.errors += status != FusedStatus::Ok;
+    counts.tooDeep += status == FusedStatus::TooDeep;
+    counts.tooManyTokens += status == FusedStatus::TooManyTokens;
+    counts.literalsTooLong += status == FusedStatus::LiteralTooLong;
+    output(status, result);
+  }
+
+  return counts;
+}
+
+
+// * Most memory the process has had resident so far, in bytes, or 0 where that is unknown
+size_t PeakResidentBytes() {
+#ifdef HAS_RUSAGE
+  struct rusage usage;
+
+  if (getrusage(RUSAGE_SELF, &usage)) {
+    return 0;
+  }
+
+#ifdef __APPLE__
+  return usage.ru_maxrss;
+#else
+  return static_cast<size_t>(usage.ru_maxrss) << 10; // ? Kilobytes everywhere but macOS
+#endif
+#else
+  return 0;
+#endif
+}
+
+
+/*
+  * Evaluates every line of inputStream like --batch --fused, except lines are read a block at a time instead of whole,
+  * so memory grows with how deeply a line nests and how long its longest number is, rather than with how long the line is.
+  * Lines nested deeper than maxDepth, pushing more than maxTokens values and operators or with a number longer than maxLiteral
+  * print "error" like any other invalid line.
+*/
+void RunStream(std::istream &inputStream, size_t maxDepth, size_t maxTokens, size_t maxLiteral) {
+  BufferedWriter writer;
+  auto start = std::chrono::steady_clock::now();
+
+  StreamCounts counts = EvaluateStream(inputStream, maxDepth, maxTokens, maxLiteral, [&](FusedStatus status, double result) {
+    if (status == FusedStatus::Ok) {
+      writer.WriteNumber(result);
+    } else {
+      writer.Write("error\n", 6);
+    }
+  });
+
+  writer.Flush();
+
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  std::cerr << counts.lines << " lines in " << elapsed.count() << "s, " << counts.errors << " errors, "
+    << counts.tooDeep << " deeper than " << maxDepth << ", " << counts.tooManyTokens << " over the token limit, "
+    << counts.literalsTooLong << " with numbers longer than " << maxLiteral << ", " << (PeakResidentBytes() >> 10) << " KiB peak resident\n";
+}
+
+
+/*
+  * RunBatch with the decimal backend, on one thread and without the program cache.
+  * Every line goes through the tokens, since compiled programs only hold doubles.
+*/
+void RunDecimalBatch(std::istream &inputStream, int precision) {
+  BufferedWriter writer;
+  TokenList tokens;
+  std::string line;
+  calc::Decimal result;
+  size_t lineCount = 0;
+
+  auto start = std::chrono::steady_clock::now();
+
+  while (getline(inputStream, line)) {
+    lineCount++;
+    tokens.clear();
+
+    CleanString(line);
+    Tokenise(tokens, line);
+    InfixToPostfix(tokens);
+
+    if (!DecimalPostfixEvaluation(tokens, precision, result)) {
+      writer.Write("error\n", 6);
+      continue;
+    }
+
+    std::string text = calc::toString(result);
+    text += '\n';
+    writer.Write(text.data(), text.size());
+  }
+
+  writer.Flush();
+
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  std::cerr << lineCount << " lines in " << elapsed.count() << "s with " << precision << " digit decimals ("
+    << lineCount / elapsed.count() << " lines/s)\n";
+}
+
+
+/*
+  * Every distinct subexpression of a batch as one node, so shared subexpressions are evaluated once.
+  * Nodes are hash consed as they are made, an operator on the same operands finds the existing node,
+  * and the operands of + and * are put in order first since swapping them never changes the result.
+*/
+struct ExpressionDag {
+  struct Node {
+    char operation; // ? '\0' for numbers, the OpCode for calls
+    int left;
+    int right; // ? -1 for calls of one argument
+    ExactValue number;
+    bool dividesByZero = false; // ? Itself or in one of its operands, so the lines using it print "error"
+  };
+
+  struct Key {
+    char operation;
+    int left;
+    int right;
+
+    bool operator==(const Key &other) const {
+      return operation == other.operation && left == other.left && right == other.right;
+    }
+  };
+
+  struct KeyHash {
+    size_t operator()(const Key &key) const {
+      return std::hash<uint64_t>()((static_cast<uint64_t>(key.left) << 32 | static_cast<uint32_t>(key.right)) * 31 + key.operation);
+    }
+  };
+
+  std::vector<Node> nodes; // ? Operands always come before the operators using them
+  std::unordered_map<uint64_t, int> numbers; // ? Keyed by the bits of the value
+  std::unordered_map<uint64_t, int> integers; // ? Numbers that are exact integers, keyed by the bits of the int64
+  std::unordered_map<Key, int, KeyHash> operations;
+  size_t treeNodes = 0; // ? Nodes the expressions would have had as separate trees
+  std::vector<int> stack; // ? Kept between calls to Add so it only allocates while it grows
+
+  // ? Adds the nodes of a postfix expression and returns its root, or -1 if it is invalid or has variables
+  int Add(const TokenList &postfix) {
+    stack.clear();
+
+    for (std::string_view token : postfix) {
+      if (StrIsDigit(token)) {
+        ExactValue number;
+        uint64_t bits;
+
+        if (!ParseExactNumber(token, number, engineOptions.integers)) {
+          return -1;
+        }
+
+        if (number.isInteger) {
+          memcpy(&bits, &number.integer, sizeof(bits));
+        } else {
+          memcpy(&bits, &number.value, sizeof(bits));
+        }
+
+        auto inserted = (number.isInteger ? integers : numbers).emplace(bits, static_cast<int>(nodes.size()));
+
+        if (inserted.second) {
+          nodes.push_back({ '\0', -1, -1, number });
+        }
+
+        stack.push_back(inserted.first->second);
+        continue;
+      }
+
+      // ? Calls of one argument are nodes with no right operand
+      bool isCall = token.back() == '(';
+      size_t arity = isCall ? FunctionArity(token.substr(0, token.length() - 1)) : 2;
+
+      if (!arity || stack.size() < arity || (!isCall && (token.length() != 1 || !IsOperator(token[0]) || token[0] == '.'))) {
+        return -1;
+      }
+
+      char operation = isCall ? static_cast<char>(FunctionOpCode(token.substr(0, token.length() - 1))) : token[0];
+      Key key = { operation, stack[stack.size() - arity], (arity == 2) ? stack.back() : -1 };
+
+      if (arity == 2) {
+        stack.pop_back();
+      }
+
+      if ((key.operation == '+' || key.operation == '*') && key.left > key.right) {
+        std::swap(key.left, key.right);
+      }
+
+      auto inserted = operations.emplace(key, static_cast<int>(nodes.size()));
+
+      if (inserted.second) {
+        nodes.push_back({ key.operation, key.left, key.right, ExactValue() });
+      }
+
+      stack.back() = inserted.first->second;
+    }
+
+    if (stack.size() != 1) {
+      return -1;
+    }
+
+    treeNodes += postfix.size();
+    return stack.back();
+  }
+
+  // ? Evaluates every node once, in the order they were made
+  void Evaluate() {
+    for (Node &node : nodes) {
+      if (node.operation && node.right < 0) {
+        node.number = { PerformFunction(nodes[node.left].number.value, node.operation, engineOptions.fastFunctions) };
+        node.dividesByZero = nodes[node.left].dividesByZero;
+      } else if (node.operation) {
+        node.number = PerformExactOperation(nodes[node.left].number, nodes[node.right].number, node.operation);
+        node.dividesByZero = (node.operation == '/' && !nodes[node.right].number.value) || nodes[node.left].dividesByZero || nodes[node.right].dividesByZero;
+      }
+    }
+  }
+};
+
+
+bool SameResult(double a, double b) {
+  return a == b || (std::isnan(a) && std::isnan(b));
+}
+
+
+/*
+  * RunBatch that evaluates the whole input as one ExpressionDag.
+  * Also evaluates every line as its own program, to report how much evaluation the shared nodes saved.
+*/
+void RunDagBatch(std::istream &inputStream) {
+  ExpressionDag dag;
+  std::vector<int> roots;
+  std::vector<Program> programs;
+  BufferedWriter writer;
+  TokenList tokens;
+  std::string line;
+  std::chrono::duration<double> buildTime(0);
+
+  while (getline(inputStream, line)) {
+    tokens.clear();
+    CleanString(line);
+    Tokenise(tokens, line);
+    InfixToPostfix(tokens);
+
+    auto start = std::chrono::steady_clock::now();
+    roots.push_back(dag.Add(tokens));
+    buildTime += std::chrono::steady_clock::now() - start;
+
+    if (roots.back() >= 0) {
+      programs.emplace_back();
+      CompilePostfix(tokens, programs.back(), engineOptions);
+    }
+  }
+
+  auto built = std::chrono::steady_clock::now();
+  dag.Evaluate();
+  auto evaluated = std::chrono::steady_clock::now();
+
+  for (int root : roots) {
+    if (root < 0 || dag.nodes[root].dividesByZero) {
+      writer.Write("error\n", 6);
+    } else {
+      writer.WriteNumber(dag.nodes[root].number.value);
+    }
+  }
+
+  writer.Flush();
+
+  ValueStack stack;
+  std::vector<double> separate(programs.size());
+  std::vector<bool> separateFailed(programs.size());
+  auto separateStart = std::chrono::steady_clock::now();
+
+  for (size_t i = 0; i < programs.size(); ++i) {
+    separateFailed[i] = static_cast<bool>(RunProgram(programs[i], stack, separate[i]));
+  }
+
+  std::chrono::duration<double> dagTime = evaluated - built;
+  std::chrono::duration<double> separateTime = std::chrono::steady_clock::now() - separateStart;
+  size_t mismatches = 0;
+
+  for (size_t line = 0, i = 0; line < roots.size(); ++line) {
+    if (roots[line] >= 0) {
+      bool dividesByZero = dag.nodes[roots[line]].dividesByZero;
+      mismatches += dividesByZero != separateFailed[i] || (!dividesByZero && !SameResult(dag.nodes[roots[line]].number.value, separate[i]));
+      i++;
+    }
+  }
+
+  std::cerr << roots.size() << " lines, " << dag.treeNodes << " tree nodes in " << dag.nodes.size() << " shared nodes ("
+    << std::setprecision(3) << static_cast<double>(dag.treeNodes) / std::max<size_t>(1, dag.nodes.size()) << "x dedup), hash consed in " << buildTime.count() << "s\n";
+  std::cerr << "Evaluated in " << dagTime.count() << "s instead of " << separateTime.count() << "s one line at a time, saving "
+    << separateTime.count() - dagTime.count() << "s, " << mismatches << " mismatches" << std::setprecision(6) << '\n';
+
+  if (buildTime.count() > separateTime.count() - dagTime.count()) {
+    std::cerr << "Sharing cost more than it saved, plain --batch is faster on this input" << '\n';
+  }
+}
+
+
+// * Splits a comma separated list of column names
+std::vector<std::string> SplitNames(const std::string &list) {
+  std::vector<std::string> names;
+  size_t start = 0;
+
+  while (start <= list.length()) {
+    size_t end = std::min(list.find(',', start), list.length());
+    std::string name = list.substr(start, end - start);
+
+    CleanString(name); // ? Drops spaces, quotes and a trailing '\r'
+    names.push_back(name);
+    start = end + 1;
+  }
+
+  return names;
+}
+
+
+/*
+  * Binds the columns called columnNames to the variables of program.
+  * Returns the variable slot of every column, -1 for columns the program does not read.
+*/
+bool BindColumns(const Program &program, const std::vector<std::string> &columnNames, std::vector<int> &slotOfColumn) {
+  std::vector<bool> bound(program.variables.size());
+
+  slotOfColumn.clear();
+
+  for (const std::string &name : columnNames) {
+    auto found = std::find(program.variables.begin(), program.variables.end(), name);
+    int slot = (found == program.variables.end()) ? -1 : static_cast<int>(found - program.variables.begin());
+
+    if (slot >= 0) {
+      bound[slot] = true;
+    }
+
+    slotOfColumn.push_back(slot);
+  }
+
+  for (size_t i = 0; i < bound.size(); ++i) {
+    if (!bound[i]) {
+      std::cerr << "No column named " << program.variables[i] << '\n';
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+bool IsLittleEndian() {
+  const uint16_t probe = 1;
+  return *reinterpret_cast<const unsigned char*>(&probe) == 1;
+}
+
+
+// * Reverses the bytes of a double, for raw input and output on big endian hosts
+double SwapBytes(double value) {
+  unsigned char bytes[sizeof(double)];
+
+  memcpy(bytes, &value, sizeof(double));
+  std::reverse(bytes, bytes + sizeof(double));
+  memcpy(&value, bytes, sizeof(double));
+  return value;
+}
+
+
+// * Rows of variable values stored column by column, one column per entry of Program::variables
+struct ColumnBlock {
+  std::vector<std::vector<double>> columns;
+  std::vector<const double*> columnData; // ? Column pointers handed to RunProgramColumns
+  std::vector<double> results;
+  size_t rows = 0;
+  size_t evaluatedRows = 0; // ? Rows evaluated over every block so far, what makes the formula hot
+#ifdef HAS_JIT
+  JitProgram jit;
+  bool jitFailed = false;
+#endif
+
+  explicit ColumnBlock(const Program &program) :
+    columns(program.variables.size(), std::vector<double>(COLUMN_BLOCK_ROWS)),
+    results(COLUMN_BLOCK_ROWS) {
+    for (const std::vector<double> &column : columns) {
+      columnData.push_back(column.data());
+    }
+  }
+};
+
+
+/*
+  * Evaluates program over every row of block and empties it.
+  * Results are written as text lines, or as raw little endian doubles when binary is set, and a block dividing by zero says so once.
+*/
+void EvaluateBlock(const Program &program, ColumnBlock &block, ColumnStacks &stacks, BufferedWriter &writer, bool binary) {
+  dividedByZero = false;
+
+  {
+    STATS_TIMER(Stage::Block);
+
+#ifdef HAS_JIT
+    if (jitThreshold && block.evaluatedRows >= jitThreshold && !block.jit.function && !block.jitFailed) {
+      block.jitFailed = !CompileJit(program, block.jit);
+    }
+
+    if (block.jit.function) {
+      block.jit.function(block.columnData.data(), block.rows, block.results.data());
+    } else
+#endif
+    RunProgramColumns(program, block.columnData.data(), block.rows, block.results.data(), stacks);
+  }
+
+  if (dividedByZero) {
+    std::cerr << "Division by zero!" << '\n';
+    STATS_ERROR(StatError::DivisionByZero);
+  }
+
+  block.evaluatedRows += block.rows;
+
+  if (binary && !IsLittleEndian()) {
+    std::transform(block.results.begin(), block.results.begin() + block.rows, block.results.begin(), SwapBytes);
+  }
+
+  if (binary) {
+    writer.Write(reinterpret_cast<const char*>(block.results.data()), block.rows * sizeof(double));
+  } else {
+    for (size_t i = 0; i < block.rows; ++i) {
+      writer.WriteNumber(block.results[i]);
+    }
+  }
+
+  block.rows = 0;
+}
+
+
+// * Parses a CSV field, empty or unparsable fields read as NaN
+double ParseField(const char *field, const char *fieldEnd) {
+  double value;
+
+  while (field < fieldEnd && isspace(*field)) {
+    field++;
+  }
+
+  const char *parsed = ReadNumber(field, fieldEnd, value);
+
+  if (parsed == field) {
+    return NAN;
+  }
+
+  while (parsed < fieldEnd && isspace(*parsed)) {
+    parsed++;
+  }
+
+  return (parsed == fieldEnd) ? value : NAN;
+}
+
+
+/*
+  * Evaluates program once per row of a CSV stream whose first line names the columns.
+  * The stream is parsed in large chunks and the results are written as one column.
+*/
+bool RunCsv(std::istream &inputStream, const Program &program) {
+  std::string header;
+  std::vector<int> slotOfColumn;
+
+  if (!getline(inputStream, header)) {
+    std::cerr << "Missing CSV header" << '\n';
+    return false;
+  }
+
+  if (!BindColumns(program, SplitNames(header), slotOfColumn)) {
+    return false;
+  }
+
+  std::vector<char> buffer(READ_CHUNK_SIZE + 1);
+  ColumnStacks stacks;
+  ColumnBlock block(program);
+  BufferedWriter writer;
+  size_t used = 0;
+  bool done = false;
+
+  while (!done) {
+    inputStream.read(buffer.data() + used, buffer.size() - 1 - used);
+    used += inputStream.gcount();
+    done = !inputStream;
+
+    // ? Only complete lines are parsed, the unfinished tail is kept for the next chunk
+    size_t end = used;
+
+    if (!done) {
+      while (end && buffer[end - 1] != '\n') {
+        end--;
+      }
+
+      if (!end) { // ? The line is longer than the buffer
+        buffer.resize(buffer.size() * 2);
+        continue;
+      }
+    }
+
+    const char *cursor = buffer.data();
+    const char *chunkEnd = buffer.data() + end;
+
+    while (cursor < chunkEnd) {
+      const char *lineEnd = std::find(cursor, chunkEnd, '\n');
+
+      if (lineEnd == cursor || (lineEnd - cursor == 1 && *cursor == '\r')) {
+        cursor = lineEnd + 1;
+        continue;
+      }
+
+      for (std::vector<double> &column : block.columns) {
+        column[block.rows] = NAN;
+      }
+
+      const char *field = cursor;
+
+      for (size_t column = 0; column < slotOfColumn.size() && field <= lineEnd; ++column) {
+        const char *fieldEnd = std::find(field, lineEnd, ',');
+
+        if (slotOfColumn[column] >= 0) {
+          block.columns[slotOfColumn[column]][block.rows] = ParseField(field, fieldEnd);
+        }
+
+        field = fieldEnd + 1;
+      }
+
+      if (++block.rows == COLUMN_BLOCK_ROWS) {
+        EvaluateBlock(program, block, stacks, writer, false);
+      }
+
+      cursor = lineEnd + 1;
+    }
+
+    memmove(buffer.data(), buffer.data() + end, used - end);
+    used -= end;
+  }
+
+  EvaluateBlock(program, block, stacks, writer, false);
+  return true;
+}
+
+
+/*
+  * Evaluates program once per record of a raw little endian double stream.
+  * Every record holds one double per entry of columnNames, in that order.
+*/
+bool RunBinary(std::istream &inputStream, const Program &program, const std::vector<std::string> &columnNames) {
+  std::vector<int> slotOfColumn;
+
+  if (!BindColumns(program, columnNames, slotOfColumn)) {
+    return false;
+  }
+
+  size_t recordSize = columnNames.size() * sizeof(double);
+  std::vector<char> buffer(COLUMN_BLOCK_ROWS * recordSize);
+  ColumnStacks stacks;
+  ColumnBlock block(program);
+  BufferedWriter writer;
+  bool swap = !IsLittleEndian();
+
+  while (inputStream) {
+    inputStream.read(buffer.data(), buffer.size());
+    size_t records = inputStream.gcount() / recordSize;
+
+    if (inputStream.gcount() % recordSize) {
+      std::cerr << "Ignoring a truncated record at the end of the input" << '\n';
+    }
+
+    for (size_t i = 0; i < records; ++i) {
+      for (size_t column = 0; column < slotOfColumn.size(); ++column) {
+        if (slotOfColumn[column] < 0) {
+          continue;
+        }
+
+        double value;
+        memcpy(&value, buffer.data() + i * recordSize + column * sizeof(double), sizeof(double));
+        block.columns[slotOfColumn[column]][i] = swap ? SwapBytes(value) : value;
+      }
+    }
+
+    block.rows = records;
+    EvaluateBlock(program, block, stacks, writer, true);
+  }
+
+  return true;
+}
+
+
+/*
+  * Times program on the switch based RunProgram and, where available, on RunThreaded.
+  * The variables change every iteration so neither loop can be hoisted, and the sums must agree.
+*/
+void RunInterpreterBenchmark(const Program &program, size_t iterations) {
+  std::vector<double> variables(program.variables.size());
+  ValueStack stack;
+
+  auto Time = [&](auto evaluate, double &sum) {
+    sum = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < iterations; ++i) {
+      for (size_t slot = 0; slot < variables.size(); ++slot) {
+        variables[slot] = 1.5 + static_cast<double>((i + slot) % 64) * 0.125;
+      }
+
+      sum += evaluate();
+    }
+
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / iterations;
+  };
+
+  double switchSum;
+  double switchTime = Time([&] {
+    double result;
+    return RunProgram(program, stack, variables.data(), result) ? -1 : result; // ? The sums only agree while no row divides by zero
+  }, switchSum);
+
+  std::cerr << program.code.size() << " instructions, " << iterations << " evaluations\n";
+  std::cerr << "switch:   " << switchTime << " ns/eval (sum " << std::setprecision(17) << switchSum << std::setprecision(6) << ")\n";
+
+#ifdef HAS_COMPUTED_GOTO
+  ThreadedProgram threaded;
+  CompileThreaded(program, threaded);
+
+  double threadedSum;
+  double threadedTime = Time([&] { return RunThreaded(&threaded, &stack, variables.data()); }, threadedSum);
+
+  std::cerr << "threaded: " << threadedTime << " ns/eval (sum " << std::setprecision(17) << threadedSum << std::setprecision(6) << "), "
+            << threaded.code.size() - 1 << " instructions after fusing, " << switchTime / threadedTime << "x\n";
+
+  if (threadedSum != switchSum) {
+    std::cerr << "Interpreters disagree!" << '\n';
+  }
+#else
+  std::cerr << "threaded: unavailable without computed goto" << '\n';
+#endif
+
+#ifdef HAS_JIT
+  JitProgram jit;
+
+  if (!CompileJit(program, jit)) {
+    std::cerr << "jit:      program could not be compiled" << '\n';
+    return;
+  }
+
+  // ? One row per call, reading straight from variables
+  std::vector<const double*> columns;
+  double result;
+
+  for (const double &variable : variables) {
+    columns.push_back(&variable);
+  }
+
+  double jitSum;
+  double jitTime = Time([&] { jit.function(columns.data(), 1, &result); return result; }, jitSum);
+
+  std::cerr << "jit:      " << jitTime << " ns/eval (sum " << std::setprecision(17) << jitSum << std::setprecision(6) << "), "
+            << jit.size << " bytes of code, " << switchTime / jitTime << "x\n";
+
+  if (jitSum != switchSum) {
+    std::cerr << "Interpreters disagree!" << '\n';
+  }
+#endif
+}
+
+
+/*
+  * Calls per second of Calculator-Library.hpp in process, against starting one calculator per expression.
+  * Times compiling and evaluating, evaluating only, and evaluating shared programs on every core at once.
+*/
+void RunLibraryBenchmark(const char *executable, size_t iterations) {
+  static const char *const corpus[] = {
+    "1+2*3", "(1 + 2) * 3 - 4 / 5", "2*pi^2", "3root27+2^0.5",
+    "((2+3)*(4-1))^2/7", "-pi*2+tau/4", "1.5^3.25-e", "10/4-2*(3-1)^2"
+  };
+  const size_t corpusSize = sizeof(corpus) / sizeof(corpus[0]);
+
+  std::vector<Program> programs(corpusSize);
+  size_t failures = 0;
+
+  for (size_t i = 0; i < corpusSize; ++i) {
+    double result;
+
+    if (calc::compile(corpus[i], programs[i]) || calc::evaluate(programs[i], result)) {
+      std::cerr << corpus[i] << ": does not evaluate\n";
+      failures++;
+    }
+  }
+
+  auto Rate = [](std::chrono::steady_clock::time_point start, size_t calls) {
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return calls / elapsed.count();
+  };
+
+  double sum = 0;
+  double result;
+  auto start = std::chrono::steady_clock::now();
+
+  for (size_t i = 0; i < iterations; ++i) {
+    Program program;
+    calc::compile(corpus[i % corpusSize], program);
+    calc::evaluate(program, result);
+    sum += result;
+  }
+
+  std::cerr << "compile and evaluate: " << Rate(start, iterations) << " calls/s\n";
+  start = std::chrono::steady_clock::now();
+
+  for (size_t i = 0; i < iterations; ++i) {
+    calc::evaluate(programs[i % corpusSize], result);
+    sum += result;
+  }
+
+  std::cerr << "evaluate:             " << Rate(start, iterations) << " calls/s\n";
+
+  // ? Every thread evaluates the same compiled programs, which evaluate never writes to
+  int threadCount = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<std::thread> threads;
+  std::vector<double> threadSums(threadCount);
+  start = std::chrono::steady_clock::now();
+
+  for (int thread = 0; thread < threadCount; ++thread) {
+    threads.emplace_back([&, thread] {
+      double threadResult;
+
+      for (size_t i = 0; i < iterations; ++i) {
+        calc::evaluate(programs[i % corpusSize], threadResult);
+        threadSums[thread] += threadResult;
+      }
+    });
+  }
+
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+  std::cerr << "evaluate on " << threadCount << " threads: " << Rate(start, iterations * threadCount) << " calls/s\n";
+
+  for (double threadSum : threadSums) {
+    if (threadSum != threadSums[0]) {
+      std::cerr << "Threads disagree!" << '\n';
+      failures++;
+    }
+  }
+
+#ifdef HAS_POSIX_SPAWN
+  // ? One process per expression, each reading it from stdin like a caller forking the calculator would
+  const size_t processRuns = std::min<size_t>(iterations, 200);
+  char *arguments[] = { const_cast<char*>(executable), nullptr };
+  start = std::chrono::steady_clock::now();
+
+  for (size_t i = 0; i < processRuns; ++i) {
+    int input[2];
+    pid_t pid;
+    posix_spawn_file_actions_t actions;
+
+    if (pipe(input)) {
+      std::cerr << "Could not create a pipe" << '\n';
+      return;
+    }
+
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, input[0], 0);
+    posix_spawn_file_actions_addclose(&actions, input[1]);
+    posix_spawn_file_actions_addopen(&actions, 1, "/dev/null", O_WRONLY, 0);
+    posix_spawn_file_actions_addopen(&actions, 2, "/dev/null", O_WRONLY, 0);
+
+    int failed = posix_spawn(&pid, executable, &actions, nullptr, arguments, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(input[0]);
+
+    if (!failed) {
+      std::string line = std::string(corpus[i % corpusSize]) + '\n';
+      ssize_t written = write(input[1], line.data(), line.size());
+      (void)written; // ? A child that died early shows up in waitpid
+      close(input[1]);
+      waitpid(pid, nullptr, 0);
+    } else {
+      close(input[1]);
+      std::cerr << "Could not start " << executable << '\n';
+      return;
+    }
+  }
+
+  std::cerr << "process per call:     " << Rate(start, processRuns) << " calls/s" << '\n';
+#endif
+
+  std::cerr << failures << " failures (checksum " << sum << ")\n";
+}
+
+
+#ifdef HAS_JIT
+// * Random fully parenthesised expression over a, b and c, kept as a tree so it can be evaluated without the compiler
+struct RandomExpression {
+  struct Node {
+    char operation; // ? '\0' for numbers, 'v' for variables, the OpCode for calls
+    double value;
+    int variable;
+    int left, right; // ? right is -1 for calls of one argument
+  };
+
+  std::vector<Node> nodes;
+  std::string text;
+
+  int Generate(std::mt19937_64 &generator, int depth) {
+    int choice = generator() % 9;
+
+    if (depth && choice == 8) {
+      static const char *const functions[] = { "sqrt", "abs", "exp", "log", "sin", "cos", "min", "max" };
+      std::string_view name = functions[generator() % 8];
+
+      text.append(name.data(), name.length()) += '(';
+      int left = Generate(generator, depth - 1);
+      int right = -1;
+
+      if (FunctionArity(name) == 2) {
+        text += ',';
+        right = Generate(generator, depth - 1);
+      }
+
+      text += ')';
+      nodes.push_back({ static_cast<char>(FunctionOpCode(name)), 0, 0, left, right });
+    } else if (depth && choice < 6) {
+      static const char operations[] = "+-*/^$";
+      char operation = operations[choice];
+
+      text += '(';
+      int left = Generate(generator, depth - 1);
+      text += (operation == '$') ? std::string(")root(") : std::string(")") + operation + '(';
+      int right = Generate(generator, depth - 1);
+      text += ')';
+
+      nodes.push_back({ operation, 0, 0, left, right });
+    } else if (choice & 1) {
+      int variable = generator() % 3;
+      text += static_cast<char>('a' + variable);
+      nodes.push_back({ 'v', 0, variable, -1, -1 });
+    } else {
+      // ? Small integers as well, so the optimizer has powers and roots to rewrite
+      char number[32];
+
+      if (generator() & 1) {
+        snprintf(number, sizeof(number), "%d", static_cast<int>(generator() % 9 + 1));
+      } else {
+        snprintf(number, sizeof(number), "%.3f", (generator() % 10000) / 1000.0);
+      }
+
+      text += number;
+      nodes.push_back({ '\0', strtod(number, nullptr), 0, -1, -1 });
+    }
+
+    return static_cast<int>(nodes.size()) - 1;
+  }
+
+  double Evaluate(int node, const double *variables) const {
+    const Node &current = nodes[node];
+
+    if (current.operation == '\0') return current.value;
+    if (current.operation == 'v') return variables[current.variable];
+    if (current.right < 0) return PerformFunction(Evaluate(current.left, variables), current.operation, engineOptions.fastFunctions);
+    return ColumnOperation(Evaluate(current.left, variables), Evaluate(current.right, variables), current.operation);
+  }
+};
+
+
+/*
+  * Checks native code against ColumnOperation and PerformFunction on a seeded corpus of random expressions.
+  * Compiled as written the results must match evaluating the tree with them bit for bit,
+  * and optimized they must match RunColumnRow on the same optimized program.
+*/
+bool ValidateJit(size_t expressionCount) {
+  const size_t rows = 64;
+  std::mt19937_64 generator(20240531);
+  std::uniform_real_distribution<double> distribution(-4, 4);
+  std::vector<std::vector<double>> values(3, std::vector<double>(rows));
+  std::vector<double> results(rows);
+  ValueStack stack;
+  size_t compiled = 0;
+  size_t mismatches = 0;
+
+  for (size_t expression = 0; expression < expressionCount; ++expression) {
+    RandomExpression random;
+    int root = random.Generate(generator, 1 + generator() % 5);
+
+    for (std::vector<double> &column : values) {
+      for (double &value : column) {
+        value = distribution(generator);
+      }
+    }
+
+    TokenList tokens;
+    Program program;
+    std::string text = random.text;
+
+    CleanString(text);
+    Tokenise(tokens, text);
+    InfixToPostfix(tokens);
+
+    if (CompilePostfix(tokens, program, engineOptions)) {
+      std::cerr << "Could not compile " << random.text << '\n';
+      mismatches++;
+      continue;
+    }
+
+    // ? Program slots are numbered by first use, columns by name
+    std::vector<const double*> columns;
+
+    for (const std::string &name : program.variables) {
+      columns.push_back(values[name[0] - 'a'].data());
+    }
+
+    for (int pass = 0; pass < 2; ++pass) {
+      JitProgram jit;
+
+      if (pass) {
+        OptimizeProgram(program);
+      }
+
+      if (!CompileJit(program, jit)) {
+        continue;
+      }
+
+      compiled++;
+      jit.function(columns.data(), rows, results.data());
+
+      for (size_t row = 0; row < rows; ++row) {
+        double variables[3] = { values[0][row], values[1][row], values[2][row] };
+        double expected;
+
+        if (pass) {
+          std::vector<double> slots;
+
+          for (const double *column : columns) {
+            slots.push_back(column[row]);
+          }
+
+          expected = RunColumnRow(program, stack, slots.data());
+        } else {
+          expected = random.Evaluate(root, variables);
+        }
+
+        if (!SameResult(results[row], expected)) {
+          if (mismatches++ < 10) {
+            std::cerr << random.text << (pass ? " (optimized)" : "") << " row " << row << ": " << std::setprecision(17)
+                      << results[row] << " instead of " << expected << std::setprecision(6) << '\n';
+          }
+
+          break;
+        }
+      }
+    }
+  }
+
+  std::cerr << expressionCount << " expressions, " << compiled << " programs compiled, " << mismatches << " mismatches\n";
+  return !mismatches;
+}
+#endif
+
+
+#ifdef HAS_CONSTEXPR_CALC
+// * Compiles expression with the runtime engine, without the optimizer so every operator goes through PerformOperation
+bool CompileUnoptimized(std::string_view expression, Program &program) {
+  TokenList tokens;
+  std::string text(expression);
+
+  CleanString(text);
+  Tokenise(tokens, text);
+  InfixToPostfix(tokens);
+  return !CompilePostfix(tokens, program, engineOptions);
+}
+
+
+struct ConstantCase {
+  const char *expression;
+  double value; // ? What calc::eval folded it to
+};
+
+
+#define CONSTANT_CASE(expression) { expression, calc::eval(expression) }
+
+constexpr ConstantCase constantCases[] = {
+  CONSTANT_CASE("1+2*3"),
+  CONSTANT_CASE("(1 + 2) * 3 - 4 / 5"),
+  CONSTANT_CASE("2*-3"),
+  CONSTANT_CASE("-pi*2"),
+  CONSTANT_CASE("2pi"),
+  CONSTANT_CASE("tau/2-pi"),
+  CONSTANT_CASE("2*pi^2"),
+  CONSTANT_CASE("2^10"),
+  CONSTANT_CASE("2^-2"),
+  CONSTANT_CASE("2^0.5"),
+  CONSTANT_CASE("e^pi"),
+  CONSTANT_CASE("1.5^3.25"),
+  CONSTANT_CASE("2root16"),
+  CONSTANT_CASE("3root27"),
+  CONSTANT_CASE("((2+3)*(4-1))^2/7"),
+  CONSTANT_CASE("0.1+0.2"),
+  CONSTANT_CASE("1/0"),
+  CONSTANT_CASE("(-3)*2"),
+  CONSTANT_CASE("max(-1,-2)*3"),
+  CONSTANT_CASE("min(1, max(2, 3))"),
+  CONSTANT_CASE("abs(-2.5)"),
+  CONSTANT_CASE("sqrt(2)"),
+  CONSTANT_CASE("sqrt(16)+1"),
+  CONSTANT_CASE("exp(1)"),
+  CONSTANT_CASE("log(10)"),
+  CONSTANT_CASE("2log(e)"),
+  CONSTANT_CASE("sin(1)"),
+  CONSTANT_CASE("sin(pi/6)"),
+  CONSTANT_CASE("cos(2)"),
+  CONSTANT_CASE("cos(-0.5)^2+sin(-0.5)^2"),
+  CONSTANT_CASE("2^62+1-2^62"),
+  CONSTANT_CASE("9007199254740993-9007199254740992"),
+  CONSTANT_CASE("3^39/3^38"),
+  CONSTANT_CASE("max(2^60+1, 2^60)-2^60"),
+  CONSTANT_CASE("7/2*2"),
+  CONSTANT_CASE("2^63-1"),
+  CONSTANT_CASE("0.12345678901234567"),
+  CONSTANT_CASE("9007199254740993.5"),
+  CONSTANT_CASE("1234567890123456789012345678901234567890123456789012345678901234567890"),
+  CONSTANT_CASE("0.000000000000000000000000000000000000000000000000000000000000000001234567890123456789"),
+  CONSTANT_CASE("0.1*3-0.3")
+};
+
+#undef CONSTANT_CASE
+
+
+// ? What the runtime engine gives for the same expressions, --check-constexpr compares every case above
+static_assert(calc::eval("1+2*3") == 7);
+static_assert(calc::eval("(1 + 2) * 3 - 4 / 5") == 9 - 0.8);
+static_assert(calc::eval("2*-3") == -6);
+static_assert(calc::eval("-pi*2") == -3.1415926535 * 2);
+static_assert(calc::eval("2pi") == 2 * 3.1415926535);
+static_assert(calc::eval("2*pi^2") == 2 * (3.1415926535 * 3.1415926535));
+static_assert(calc::eval("2^10") == 1024);
+static_assert(calc::eval("2^-2") == 0.25);
+static_assert(calc::eval("2^0.5") == 1.4142135623730951);
+static_assert(calc::eval("e^pi") == 23.140692629122263);
+static_assert(calc::eval("2root16") == 4);
+static_assert(calc::eval("3root27") == 3);
+static_assert(calc::eval("0.1+0.2") == 0.1 + 0.2);
+static_assert(calc::eval("1/0") == -1);
+static_assert(calc::eval("(-3)*2") == -6);
+static_assert(calc::eval("max(-1,-2)*3") == -3);
+static_assert(calc::eval("min(1, max(2, 3))") == 1);
+static_assert(calc::eval("sqrt(16)+1") == 5);
+static_assert(calc::eval("abs(-2.5)") == 2.5);
+static_assert(calc::eval("2^62+1-2^62") == 1);
+static_assert(calc::eval("9007199254740993-9007199254740992") == 1);
+static_assert(calc::eval("7/2*2") == 7);
+static_assert(calc::eval("0.12345678901234567") == 0.12345678901234566);
+static_assert(calc::eval("9007199254740993.5") == 9007199254740994);
+static_assert(calc::compile<"x*x+1">()(3) == 10);
+static_assert(calc::compile<"2x^2">()(3) == 18);
+static_assert(calc::compile<"(a+b)/c">()(1, 2, 4) == 0.75);
+static_assert(calc::compile<"b*a-b">().arity == 2 && calc::compile<"b*a-b">().variable(0) == "b");
+
+
+// * Evaluates calc::compile<Expression>() at runtime over a grid of values and counts where it differs from RunProgram
+template <calc::FixedString Expression>
+size_t CheckCompiledFunction(ValueStack &stack) {
+  constexpr auto function = calc::compile<Expression>();
+  Program program;
+  size_t mismatches = 0;
+
+  if (!CompileUnoptimized(Expression.View(), program) || program.variables.size() != function.arity) {
+    std::cerr << Expression.View() << ": runtime engine compiled it differently\n";
+    return 1;
+  }
+
+  for (int row = 0; row < 1000; ++row) {
+    double variables[function.arity + 1];
+
+    for (size_t slot = 0; slot < function.arity; ++slot) {
+      variables[slot] = (row * 7 + static_cast<int>(slot) * 13) % 101 * 0.0625 - 3;
+    }
+
+    if (!SameResult(function(variables), RunColumnRow(program, stack, variables))) {
+      mismatches++;
+    }
+  }
+
+  std::cerr << Expression.View() << ": " << mismatches << " mismatches in 1000 rows\n";
+  return mismatches;
+}
+
+
+// * Checks what calc::eval folded and what calc::compile runs against the runtime engine, bit for bit
+bool CheckConstexpr() {
+  ValueStack stack;
+  size_t mismatches = 0;
+
+  for (const ConstantCase &constantCase : constantCases) {
+    Program program;
+
+    if (!CompileUnoptimized(constantCase.expression, program)) {
+      std::cerr << constantCase.expression << ": invalid in the runtime engine\n";
+      mismatches++;
+      continue;
+    }
+
+    double result = RunColumnRow(program, stack, nullptr);
+    bool same = SameResult(result, constantCase.value);
+
+    std::cerr << constantCase.expression << " = " << std::setprecision(17) << constantCase.value << std::setprecision(6);
+
+    if (!same) {
+      std::cerr << ", runtime engine gives " << std::setprecision(17) << result << std::setprecision(6);
+      mismatches++;
+    }
+
+    std::cerr << '\n';
+  }
+
+  mismatches += CheckCompiledFunction<"x*x+1">(stack);
+  mismatches += CheckCompiledFunction<"(a+b)/c">(stack);
+  mismatches += CheckCompiledFunction<"2x^3-x/(y-1)+3root(x)">(stack);
+  mismatches += CheckCompiledFunction<"price*qty*(1+tax/100)">(stack);
+  mismatches += CheckCompiledFunction<"sqrt(x*x+1)+max(x,-y)">(stack);
+  mismatches += CheckCompiledFunction<"sin(x)*cos(y)-abs(x)">(stack);
+  mismatches += CheckCompiledFunction<"x+2^62+1-2^62">(stack);
+
+  std::cerr << mismatches << " mismatches\n";
+  return !mismatches;
+}
+#endif
+
+
+// * Shape of the expressions --generate-corpus writes
+struct CorpusOptions {
+  uint64_t seed = 1;
+  int length = 8; // ? Operands per expression, counting a parenthesised group as one
+  int depth = 2; // ? How deep parentheses nest
+  double constants = 0.1; // ? Chance of an operand being pi, e or tau
+  std::string operators = "+-*/^";
+  bool integers = false; // ? Only whole numbers, divisors and exponents included
+  double functions = 0; // ? Chance of a parenthesised group being the argument of abs or sqrt, which only Calculator-1 reads
+};
+
+
+/*
+  * Appends a random expression of length operands to output.
+  * Every implementation has to survive the corpus, so divisors are non-zero literals and exponents small literals.
+*/
+void GenerateExpression(std::mt19937_64 &generator, const CorpusOptions &options, int length, int depth, std::string &output) {
+  static const char *const constantNames[] = { "pi", "e", "tau" };
+  std::uniform_real_distribution<double> chance(0, 1);
+  char number[32];
+
+  for (int operand = 0; operand < length; ++operand) {
+    char operation = '\0';
+
+    if (operand) {
+      operation = options.operators[generator() % options.operators.size()];
+      output += operation;
+    }
+
+    if (operation == '/' && options.integers) {
+      output += std::to_string(generator() % 9 + 1);
+    } else if (operation == '/') {
+      output.append(number, snprintf(number, sizeof(number), "%d.%d", static_cast<int>(generator() % 9 + 1), static_cast<int>(generator() % 10)));
+    } else if (operation == '^') {
+      static const char *const exponents[] = { "2", "3", "0.5" };
+      output += exponents[generator() % (options.integers ? 2 : 3)];
+    } else if (depth > 0 && chance(generator) < 0.25) {
+      // ? Without functions no extra number is drawn, so the corpus stays the same
+      if (options.functions > 0 && chance(generator) < options.functions) {
+        output += (generator() & 1) ? "abs" : "sqrt";
+      }
+
+      output += '(';
+      GenerateExpression(generator, options, 2 + generator() % 3, depth - 1, output);
+      output += ')';
+    } else if (chance(generator) < options.constants) {
+      output += constantNames[generator() % 3];
+    } else if (options.integers || (generator() & 1)) {
+      output += std::to_string(generator() % 100);
+    } else {
+      output.append(number, snprintf(number, sizeof(number), "%.3f", static_cast<double>(generator() % 100000) / 1000));
+    }
+  }
+}
+
+
+// * Writes count seeded random expressions to stdout, one per line
+void RunGenerateCorpus(const CorpusOptions &options, size_t count) {
+  std::mt19937_64 generator(options.seed);
+  BufferedWriter writer;
+  std::string line;
+
+  for (size_t i = 0; i < count; ++i) {
+    line.clear();
+    GenerateExpression(generator, options, options.length, options.depth, line);
+    line += '\n';
+    writer.Write(line.data(), line.size());
+  }
+}
+
+
+/*
+  * Times clean, tokenise, postfix and evaluate separately over every line of inputStream.
+  * Each stage runs over the whole corpus before the next starts, and the timings are printed as one JSON object,
+  * the same shape as the --bench-stages output of Calculator-2.cpp, Calculator.c and Calculator.rs.
+*/
+void RunStageBenchmark(std::istream &inputStream) {
+  std::vector<std::string> lines;
+  std::string line;
+  size_t bytes = 0;
+
+  while (getline(inputStream, line)) {
+    bytes += line.size() + 1;
+    lines.push_back(line);
+  }
+
+  std::vector<TokenList> tokens(lines.size());
+  std::vector<double> stageSeconds;
+  ValueStack stack;
+  Program program;
+  double checksum = 0; // ? Sum of the finite results, to compare implementations on the same corpus
+  size_t errors = 0;
+  size_t nonFinite = 0;
+
+  auto Stage = [&](auto run) {
+    auto start = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < lines.size(); ++i) {
+      run(i);
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    stageSeconds.push_back(elapsed.count());
+  };
+
+  Stage([&](size_t i) { CleanString(lines[i]); });
+  Stage([&](size_t i) { tokens[i].reserve(lines[i].length() * 2 + 1); Tokenise(tokens[i], lines[i]); });
+  Stage([&](size_t i) { InfixToPostfix(tokens[i]); });
+  Stage([&](size_t i) {
+    if (CompilePostfix(tokens[i], program, engineOptions) || !program.variables.empty()) {
+      errors++;
+      return;
+    }
+
+    if (engineOptions.optimize) {
+      OptimizeProgram(program);
+    }
+
+    double result;
+
+    if (RunProgram(program, stack, result)) {
+      errors++;
+      return;
+    }
+
+    if (std::isfinite(result)) {
+      checksum += result;
+    } else {
+      nonFinite++;
+    }
+  });
+
+  static const char *const stageNames[] = { "clean", "tokenize", "postfix", "evaluate" };
+  double total = 0;
+
+  printf("{\"implementation\": \"C++/Calculator-1.cpp\", \"expressions\": %zu, \"bytes\": %zu, \"stages\": {", lines.size(), bytes);
+
+  for (size_t stage = 0; stage < stageSeconds.size(); ++stage) {
+    total += stageSeconds[stage];
+    printf("%s\"%s\": {\"seconds\": %.9f, \"ns_per_expression\": %.3f}", stage ? ", " : "", stageNames[stage], stageSeconds[stage], lines.empty() ? 0.0 : stageSeconds[stage] * 1e9 / lines.size());
+  }
+
+  printf("}, \"total_seconds\": %.9f, \"errors\": %zu, \"non_finite\": %zu, \"checksum\": %.17g}\n", total, errors, nonFinite, checksum);
+}
+
+
+/*
+  * Expression tree that survives edits to its text, for front ends that re-evaluate on every keystroke.
+  * An edit that stays inside one typed number re-parses only that number and recomputes only its ancestors,
+  * anything else rebuilds the tree through the usual pipeline.
+*/
+struct IncrementalExpression {
+  struct Node {
+    char operation; // ? '\0' for numbers, otherwise the operator or the OpCode of the call applied to left and right
+    int left = -1;
+    int right = -1; // ? -1 for calls of one argument
+    int parent = -1;
+    ExactValue number; // ? Value of the whole subtree as of the last edit
+    size_t begin = 0; // ? Span of a typed number in text, empty for everything else
+    size_t end = 0;
+  };
+
+  std::string text;
+  std::vector<Node> nodes; // ? In postfix order, so children always come before their parent
+  std::vector<int> numbers; // ? Typed numbers in text order
+  int root = -1;
+  size_t rebuilds = 0; // ? Edits that needed the whole pipeline
+
+  double Value() const { return nodes[root].number.value; }
+
+  // ? Runs the whole pipeline on expression, false if it is invalid or has variables
+  bool Build(std::string_view expression) {
+    std::string cleaned;
+    std::vector<size_t> offsets; // ? Position in text of every character of cleaned
+    TokenList tokens;
+    std::vector<int> stack;
+
+    text = expression;
+    nodes.clear();
+    numbers.clear();
+    root = -1;
+
+    for (size_t i = 0; i < text.length(); ++i) {
+      if (IsValid(text[i])) {
+        cleaned += text[i];
+        offsets.push_back(i);
+      }
+    }
+
+    Tokenise(tokens, cleaned);
+    InfixToPostfix(tokens);
+
+    for (std::string_view token : tokens) {
+      bool isCall = token.back() == '(';
+
+      if (IsIdentifier(token) && !isCall) {
+        return false;
+      }
+
+      Node node;
+
+      if (StrIsDigit(token)) {
+        node.operation = '\0';
+
+        if (!ParseExactNumber(token, node.number, engineOptions.integers)) {
+          return false;
+        }
+
+        // ? Constants and the -1 of a negated name are not in cleaned and cannot be edited
+        if (token.data() >= cleaned.data() && token.data() < cleaned.data() + cleaned.length()) {
+          size_t start = token.data() - cleaned.data();
+          node.begin = offsets[start];
+          node.end = offsets[start + token.length() - 1] + 1;
+        }
+      } else {
+        // ? Calls are recomputed on the way up like operators, calls of one argument have no right operand
+        size_t arity = isCall ? FunctionArity(token.substr(0, token.length() - 1)) : 2;
+
+        if (!arity || stack.size() < arity || (!isCall && (token.length() != 1 || !IsOperator(token[0]) || token[0] == '.'))) {
+          return false;
+        }
+
+        node.operation = isCall ? static_cast<char>(FunctionOpCode(token.substr(0, token.length() - 1))) : token[0];
+
+        if (arity == 2) {
+          node.right = stack.back();
+          stack.pop_back();
+          nodes[node.right].parent = static_cast<int>(nodes.size());
+        }
+
+        node.left = stack.back();
+        stack.pop_back();
+        nodes[node.left].parent = static_cast<int>(nodes.size());
+        Compute(node);
+      }
+
+      stack.push_back(static_cast<int>(nodes.size()));
+      nodes.push_back(node);
+    }
+
+    if (stack.size() != 1) {
+      return false;
+    }
+
+    root = stack.back();
+
+    for (size_t i = 0; i < nodes.size(); ++i) {
+      if (nodes[i].end) {
+        numbers.push_back(static_cast<int>(i));
+      }
+    }
+
+    std::sort(numbers.begin(), numbers.end(), [&](int a, int b) { return nodes[a].begin < nodes[b].begin; });
+    return true;
+  }
+
+  // * Replaces length characters at position with replacement, false if the result is invalid
+  bool Edit(size_t position, size_t length, std::string_view replacement) {
+    auto after = std::upper_bound(numbers.begin(), numbers.end(), position, [&](size_t at, int number) { return at < nodes[number].begin; });
+
+    if (root < 0 || after == numbers.begin() || !EditNumber(*(after - 1), after - numbers.begin(), position, length, replacement)) {
+      std::string edited = text;
+      rebuilds++;
+      return Build(edited.replace(std::min(position, edited.length()), length, replacement));
+    }
+
+    return true;
+  }
+
+private:
+  /*
+    * Applies the edit if it stays inside the typed number at numbers[index - 1] and leaves a number with the same sign,
+    * since a new '-' could just as well be an operator.
+  */
+  bool EditNumber(int number, size_t index, size_t position, size_t length, std::string_view replacement) {
+    Node &node = nodes[number];
+
+    if (position + length > node.end) {
+      return false;
+    }
+
+    std::string_view before(text.data() + node.begin, node.end - node.begin);
+    std::string digits;
+
+    for (size_t i = node.begin; i < node.end + replacement.length() - length; ++i) {
+      char c = (i < position) ? text[i] : (i < position + replacement.length()) ? replacement[i - position] : text[i - replacement.length() + length];
+
+      if (IsValid(c)) {
+        digits += c;
+      }
+    }
+
+    ExactValue value;
+
+    if (digits.empty() || (digits[0] == '-') != (before[0] == '-') || digits.find('-', 1) != std::string::npos || !StrIsDigit(digits) || !ParseExactNumber(digits, value, engineOptions.integers)) {
+      return false;
+    }
+
+    text.replace(position, length, replacement);
+    node.end += replacement.length() - length;
+    node.number = value;
+
+    // ? Every later number moved by the same amount
+    for (size_t i = index; i < numbers.size(); ++i) {
+      nodes[numbers[i]].begin += replacement.length() - length;
+      nodes[numbers[i]].end += replacement.length() - length;
+    }
+
+    for (int parent = node.parent; parent >= 0; parent = nodes[parent].parent) {
+      Compute(nodes[parent]);
+    }
+
+    return true;
+  }
+
+  // ? Value of an operator or call node from the values of its operands
+  void Compute(Node &node) {
+    if (node.right < 0) {
+      node.number = { PerformFunction(nodes[node.left].number.value, node.operation, engineOptions.fastFunctions) };
+    } else if (node.operation == '/' && !nodes[node.right].number.value) {
+      node.number = { -1 }; // ? Like ColumnOperation
+    } else {
+      node.number = PerformExactOperation(nodes[node.left].number, nodes[node.right].number, node.operation);
+    }
+  }
+};
+
+
+/*
+  * Reads an expression, then edits of it as "<position> <length> <replacement>", one per line,
+  * and prints the value after each. Positions count characters of the expression as typed.
+*/
+void RunIncremental(std::istream &inputStream) {
+  IncrementalExpression expression;
+  std::string line;
+  char number[NUMBER_LENGTH];
+
+  getline(inputStream, line);
+
+  if (!expression.Build(line)) {
+    std::cerr << "Invalid expression!" << '\n';
+  } else {
+    std::cout << std::string_view(number, FormatNumber(number, expression.Value())) << '\n';
+  }
+
+  while (getline(inputStream, line)) {
+    size_t position, length;
+    int consumed = 0;
+
+    if (sscanf(line.c_str(), "%zu %zu %n", &position, &length, &consumed) < 2) {
+      std::cerr << "Edits are <position> <length> <replacement>" << '\n';
+      continue;
+    }
+
+    if (!expression.Edit(position, length, std::string_view(line).substr(consumed))) {
+      std::cerr << "Invalid expression!" << '\n';
+      continue;
+    }
+
+    std::cout << std::string_view(number, FormatNumber(number, expression.Value())) << '\n';
+  }
+}
+
+
+/*
+  * Keystroke latency of IncrementalExpression against running the whole pipeline again,
+  * on a generated expression of about tokenCount tokens where every keystroke overwrites one digit.
+*/
+void RunIncrementalBenchmark(CorpusOptions options, size_t tokenCount, size_t keystrokes) {
+  std::mt19937_64 generator(options.seed);
+  std::string text;
+  TokenList tokens;
+
+  // ? Roughly three tokens per operand once parentheses are counted, with calls among them like a typed formula has
+  options.functions = 0.25;
+  GenerateExpression(generator, options, std::max<int>(1, tokenCount / 3), options.depth, text);
+  CleanString(text);
+  Tokenise(tokens, text);
+
+  IncrementalExpression expression;
+
+  if (!expression.Build(text) || expression.numbers.empty()) {
+    std::cerr << "Generated expression did not build" << '\n';
+    return;
+  }
+
+  std::vector<double> incrementalTimes, fullTimes;
+  ValueStack stack;
+  Program program;
+  size_t mismatches = 0;
+
+  for (size_t keystroke = 0; keystroke < keystrokes; ++keystroke) {
+    const IncrementalExpression::Node &number = expression.nodes[expression.numbers[generator() % expression.numbers.size()]];
+    size_t position = number.begin + generator() % (number.end - number.begin);
+
+    if (!isdigit(expression.text[position])) {
+      continue;
+    }
+
+    char digit = static_cast<char>('1' + generator() % 9); // ? Never zero, which keeps divisors non-zero
+    std::string edited = expression.text;
+    edited[position] = digit;
+
+    auto start = std::chrono::steady_clock::now();
+    expression.Edit(position, 1, std::string_view(&digit, 1));
+    auto middle = std::chrono::steady_clock::now();
+
+    TokenList fullTokens;
+    CleanString(edited);
+    Tokenise(fullTokens, edited);
+    InfixToPostfix(fullTokens);
+    double full = NAN;
+
+    if (!CompilePostfix(fullTokens, program, engineOptions)) {
+      RunProgram(program, stack, full);
+    }
+
+    auto end = std::chrono::steady_clock::now();
+
+    incrementalTimes.push_back(std::chrono::duration<double, std::micro>(middle - start).count());
+    fullTimes.push_back(std::chrono::duration<double, std::micro>(end - middle).count());
+    mismatches += !SameResult(expression.Value(), full);
+  }
+
+  auto Report = [](const char *name, std::vector<double> &times) {
+    std::sort(times.begin(), times.end());
+    double total = 0;
+
+    for (double time : times) {
+      total += time;
+    }
+
+    std::cerr << name << std::fixed << std::setprecision(2) << total / times.size() << " us mean, "
+      << times[times.size() / 2] << " us p50, " << times[times.size() * 99 / 100] << " us p99\n" << std::defaultfloat << std::setprecision(6);
+  };
+
+  std::cerr << tokens.size() << " tokens, " << expression.numbers.size() << " numbers, " << incrementalTimes.size() << " keystrokes\n";
+  Report("incremental: ", incrementalTimes);
+  Report("full:        ", fullTimes);
+  std::cerr << expression.rebuilds << " rebuilds, " << mismatches << " mismatches\n";
+}
+
+
+/*
+  * Where FusedEvaluation beats compiling, by expression size.
+  * Times each line evaluated once by FusedEvaluation and by the pipeline, and a compiled program evaluated again,
+  * and from those how many evaluations a compiled program needs to win back its compile time.
+*/
+void RunFusedBenchmark(std::istream &inputStream) {
+  static const size_t bucketLimits[] = { 16, 64, 256, SIZE_MAX };
+  static const char *const bucketNames[] = { "1-15", "16-63", "64-255", "256+" };
+  std::vector<std::string> buckets[4];
+  std::string line;
+  TokenList tokens;
+  ValueStack stack;
+  Program program;
+  size_t mismatches = 0;
+
+  while (getline(inputStream, line)) {
+    tokens.clear();
+    std::string cleaned = line;
+    CleanString(cleaned);
+    Tokenise(tokens, cleaned);
+    size_t bucket = 0;
+
+    while (tokens.size() >= bucketLimits[bucket]) {
+      bucket++;
+    }
+
+    buckets[bucket].push_back(line);
+  }
+
+  std::cerr << "tokens      lines   fused ns  pipeline ns  compiled ns  break-even evaluations\n";
 
-  for (char c : input) {
-    if (c == '.') {
-      dotCount++;
+  for (size_t bucket = 0; bucket < 4; ++bucket) {
+    const std::vector<std::string> &lines = buckets[bucket];
+    std::vector<Program> programs(lines.size());
+    std::vector<bool> compiled(lines.size());
+    std::vector<double> results(lines.size()); // ? Somewhere for every result to go, so no evaluation is optimised away
+    size_t passes = std::max<size_t>(1, 200000 / std::max<size_t>(1, lines.size()));
 
-      if (dotCount > 1) {
-        return false;
+    if (lines.empty()) {
+      continue;
+    }
+
+    auto Time = [&](auto run) {
+      auto start = std::chrono::steady_clock::now();
+
+      for (size_t pass = 0; pass < passes; ++pass) {
+        for (size_t i = 0; i < lines.size(); ++i) {
+          run(i);
+        }
       }
-    } else if (!isdigit(c) && c != '-') {
-      return false;
+
+      std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+      return elapsed.count() / (passes * lines.size());
+    };
+
+    double fusedTime = Time([&](size_t i) { FusedEvaluation(lines[i], results[i]); });
+
+    double pipelineTime = Time([&](size_t i) {
+      std::string input = lines[i];
+      tokens.clear();
+      CleanString(input);
+      Tokenise(tokens, input);
+      InfixToPostfix(tokens);
+      compiled[i] = !CompilePostfix(tokens, programs[i], engineOptions) && programs[i].variables.empty();
+
+      if (compiled[i]) {
+        if (engineOptions.optimize) {
+          OptimizeProgram(programs[i]);
+        }
+
+        RunProgram(programs[i], stack, results[i]);
+      }
+    });
+
+    double compiledTime = Time([&](size_t i) {
+      if (compiled[i]) {
+        RunProgram(programs[i], stack, results[i]);
+      }
+    });
+
+    // ? Fused results match the pipeline without OptimizeProgram
+    for (const std::string &text : lines) {
+      std::string input = text;
+      double result = 0;
+      tokens.clear();
+      CleanString(input);
+      Tokenise(tokens, input);
+      InfixToPostfix(tokens);
+      bool valid = !CompilePostfix(tokens, program, engineOptions) && program.variables.empty();
+      FusedStatus status = FusedEvaluation(text, result);
+      bool evaluated = status == FusedStatus::Ok || status == FusedStatus::DivisionByZero;
+
+      if (status == FusedStatus::TooDeep) {
+        continue;
+      }
+
+      if (valid != evaluated) {
+        mismatches++;
+      } else if (valid) {
+        double expected;
+        bool divided = static_cast<bool>(RunProgram(program, stack, expected));
+        mismatches += divided != (status == FusedStatus::DivisionByZero) || (!divided && !SameResult(result, expected));
+      }
+    }
+
+    char breakEven[32] = "never";
+
+    if (fusedTime > compiledTime) {
+      snprintf(breakEven, sizeof(breakEven), "%.1f", (pipelineTime - compiledTime) / (fusedTime - compiledTime));
     }
+
+    fprintf(stderr, "%-9s %7zu %10.1f %12.1f %12.1f  %s\n", bucketNames[bucket], lines.size(), fusedTime, pipelineTime, compiledTime, breakEven);
   }
 
-  return true;
+  std::cerr << mismatches << " mismatches against the pipeline without the optimizer\n";
 }
 
 
-bool IsOperator(char inputChar = ' ') {
-  return inputChar == '+' || inputChar == '-' || inputChar == '*' || inputChar == '/' || inputChar == '^' || inputChar == '.';
+/*
+  * Times compiling, optimizing and running every line of inputStream with integer arithmetic and with doubles only.
+  * Lines are tokenised up front and copied into an arena for each compile, like the batch mode does.
+  * Leaves engineOptions.integers on.
+  * Also counts the results that integer arithmetic changed, which are the ones doubles rounded along the way.
+*/
+void RunIntegerBenchmark(std::istream &inputStream) {
+  std::vector<std::string> lines;
+  std::string line;
+
+  while (getline(inputStream, line)) {
+    CleanString(line);
+    lines.push_back(line);
+  }
+
+  std::vector<TokenList> postfix(lines.size()); // ? Views into lines, which no longer move
+  Arena arena;
+  ValueStack stack;
+  Program program;
+  std::vector<double> results[2];
+  size_t instructions[2] = {};
+  size_t passes = std::max<size_t>(1, 300000 / std::max<size_t>(1, lines.size()));
+
+  for (size_t i = 0; i < lines.size(); ++i) {
+    Tokenise(postfix[i], lines[i]);
+    InfixToPostfix(postfix[i]);
+  }
+
+  auto Time = [&](bool integers) {
+    engineOptions.integers = integers;
+    results[integers].assign(lines.size(), NAN);
+    instructions[integers] = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    for (size_t pass = 0; pass < passes; ++pass) {
+      for (size_t i = 0; i < lines.size(); ++i) {
+        arena.Reset();
+        TokenList tokens(postfix[i], &arena);
+
+        if (CompilePostfix(tokens, program, engineOptions) || !program.variables.empty()) {
+          continue;
+        }
+
+        instructions[integers] += program.code.size();
+
+        if (engineOptions.optimize) {
+          OptimizeProgram(program, &arena);
+        }
+
+        RunProgram(program, stack, results[integers][i]); // ? A division by zero leaves the NaN, in both modes alike
+      }
+    }
+
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / (passes * std::max<size_t>(1, lines.size()));
+  };
+
+  // ? Best of a few alternating rounds, so neither mode gets the warm caches or the quiet machine to itself
+  double doubleTime = INFINITY, integerTime = INFINITY;
+  size_t changed = 0;
+
+  for (int round = 0; round < 3; ++round) {
+    doubleTime = std::min(doubleTime, Time(false));
+    integerTime = std::min(integerTime, Time(true));
+  }
+
+  for (size_t i = 0; i < lines.size(); ++i) {
+    changed += !SameResult(results[0][i], results[1][i]);
+  }
+
+  fprintf(stderr, "%zu lines, %d passes\n", lines.size(), static_cast<int>(passes));
+  fprintf(stderr, "doubles:  %8.1f ns/line, %zu instructions compiled\n", doubleTime, instructions[0] / passes);
+  fprintf(stderr, "integers: %8.1f ns/line, %zu instructions compiled (%.2fx)\n", integerTime, instructions[1] / passes, doubleTime / integerTime);
+  fprintf(stderr, "%zu results changed by exact integer arithmetic\n", changed);
 }
 
 
-bool IsValid(char input) {
-  return (
-    isdigit(input) || IsOperator(input) ||
-    input == 'p' || input == 'u' ||
-    input == 'i' || input == 'e' ||
-    input == 't' || input == 'a' ||
-    input == '(' || input == ')'
-  );
+// * Input made up piece by piece as it is read, so stress inputs of any size never sit in memory
+struct GeneratedStream : std::streambuf {
+  std::function<bool(std::string &)> generate; // ? Replaces piece with the next part of the input, false once there is none
+  std::string piece;
+
+  explicit GeneratedStream(std::function<bool(std::string &)> generate) : generate(std::move(generate)) {}
+
+  int_type underflow() override {
+    piece.clear();
+
+    while (piece.empty()) {
+      if (!generate(piece)) {
+        return traits_type::eof();
+      }
+    }
+
+    setg(piece.data(), piece.data(), piece.data() + piece.size());
+    return traits_type::to_int_type(piece[0]);
+  }
+};
+
+
+/*
+  * Streams generated inputs of megabytes each through EvaluateStream and reports the peak resident memory after each,
+  * which should stay flat however large the inputs get: a single flat line, lines nested just within maxDepth,
+  * corpus lines, one line nested far past maxDepth, one number of the whole size and random malformed text.
+*/
+void RunStressTest(size_t megabytes, size_t maxDepth, size_t maxTokens, size_t maxLiteral) {
+  size_t size = megabytes << 20;
+  std::mt19937_64 generator(1);
+  size_t depth = std::min<size_t>(maxDepth, size / 4) - 1; // ? Opening parentheses, which with the '+' fill the operator stack
+
+  struct Case {
+    const char *name;
+    std::function<bool(std::string &)> generate;
+  };
+
+  // ? Every case writes at least size bytes, then whatever ends its last line properly
+  auto Produce = [size](std::function<void(std::string &)> piece, std::function<void(std::string &)> tail) {
+    return [size, piece, tail, produced = size_t(0), done = false](std::string &output) mutable {
+      if (done) {
+        return false;
+      }
+
+      if (produced < size) {
+        piece(output);
+        produced += output.size();
+      } else {
+        tail(output);
+        done = true;
+      }
+
+      return true;
+    };
+  };
+
+  Case cases[] = {
+    { "flat", Produce([](std::string &output) {
+      for (int i = 0; i < 1000; ++i) {
+        output += "1+2*3-4/5+";
+      }
+    }, [](std::string &output) { output += "1\n"; }) },
+    { "nested", Produce([depth](std::string &output) {
+      output.append(depth, '(');
+      output += "1+1";
+      output.append(depth, ')');
+      output += '\n';
+    }, [](std::string &) {}) },
+    { "corpus", Produce([&generator](std::string &output) {
+      CorpusOptions options;
+
+      for (int i = 0; i < 1000; ++i) {
+        GenerateExpression(generator, options, options.length, options.depth, output);
+        output += '\n';
+      }
+    }, [](std::string &) {}) },
+    { "too deep", Produce([](std::string &output) { output.append(1 << 16, '('); }, [](std::string &output) { output += "1\n"; }) },
+    { "literal", Produce([](std::string &output) { output.append(1 << 16, '7'); }, [](std::string &output) { output += '\n'; }) },
+    { "malformed", Produce([&generator](std::string &output) {
+      static const char characters[] = "()(),+-*^.0123456789 eroot\n"; // ? No '/', whose divisions by zero would flood stderr
+
+      for (int i = 0; i < (1 << 16); ++i) {
+        output += characters[generator() % (sizeof(characters) - 1)];
+      }
+    }, [](std::string &output) { output += '\n'; }) }
+  };
+
+  std::string tokenLimit = (maxTokens == SIZE_MAX) ? "none" : std::to_string(maxTokens);
+  fprintf(stderr, "%zu MiB per case, depth limit %zu, token limit %s, literal limit %zu, %zu KiB resident before\n", megabytes, maxDepth,
+    tokenLimit.c_str(), maxLiteral, PeakResidentBytes() >> 10);
+  std::cerr << "case         lines   errors  too deep  too many  too long      MB/s  peak KiB\n";
+
+  for (Case &testCase : cases) {
+    GeneratedStream buffer(std::move(testCase.generate));
+    std::istream inputStream(&buffer);
+    auto start = std::chrono::steady_clock::now();
+
+    StreamCounts counts = EvaluateStream(inputStream, maxDepth, maxTokens, maxLiteral, [](FusedStatus, double) {});
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    fprintf(stderr, "%-9s %8zu %8zu %9zu %9zu %9zu %9.1f %9zu\n", testCase.name, counts.lines, counts.errors, counts.tooDeep,
+      counts.tooManyTokens, counts.literalsTooLong, size / 1e6 / elapsed.count(), PeakResidentBytes() >> 10);
+  }
 }
 
 
-// * Removes whitespaces from a string
-void CleanString(std::string &inputString) {
-  inputString.erase(remove_if(inputString.begin(), inputString.end(), [](unsigned char x) { return !IsValid(x); }), inputString.end());
+// * Distance between a and b in representable doubles, 0 when both are NaN
+uint64_t UlpDistance(double a, double b) {
+  if (std::isnan(a) || std::isnan(b)) {
+    return (std::isnan(a) && std::isnan(b)) ? 0 : UINT64_MAX;
+  }
+
+  int64_t bitsA, bitsB;
+  memcpy(&bitsA, &a, sizeof(bitsA));
+  memcpy(&bitsB, &b, sizeof(bitsB));
+
+  // ? Negative doubles count down from -0, so the integers are in the same order as the values
+  bitsA = (bitsA < 0) ? INT64_MIN - bitsA : bitsA;
+  bitsB = (bitsB < 0) ? INT64_MIN - bitsB : bitsB;
+  return (bitsA > bitsB) ? static_cast<uint64_t>(bitsA) - bitsB : static_cast<uint64_t>(bitsB) - bitsA;
 }
 
 
-// * Tokenise the input string
-void Tokenise(std::vector<std::string> &tokens, const std::string input) {
-  std::string currentToken;
+// ? Everything OptimizeProgram rewrites, each the last operation of its formula so its error is not amplified by the ones after it
+static const char *const optimizerCases[] = {
+  "x^0", "x^1", "x^2", "x^3", "x^4", "x^7", "x^16", "x^0.5", "x^-2", "(x*y)^3", "max(x,y)^3", "abs(x-y)^2",
+  "2 root x", "3 root (x*y)", "0.5 root x", "x root y", "2^3*x+4/2-2^0.5", "x/(y-y)"
+};
 
-  for (int i = 0; i <= input.length(); ++i) {
-    char currentChar = (i < input.length()) ? input[i] : '\0';
 
-    // ? Checks if the - means substract or negative.
-    if (currentChar == '-' && (!i || IsOperator(input[i - 1]))) {
-      currentToken += currentChar;
+/*
+  * Runs the cases above and every line of inputStream with and without OptimizeProgram, on random values of their variables.
+  * A case may differ by 1 ulp, the bound MAX_POWER_CHAIN was chosen for. Operations after a power can amplify its ulp,
+  * (x+1)^3-x^3 by orders of magnitude, so lines of inputStream only have to agree on NaN, infinities, zeros, signs
+  * and divisions by zero, and how far apart they are is only reported.
+*/
+bool CheckOptimizer(std::istream *inputStream) {
+  static const double specials[] = { 0, -0.0, 1, -1, INFINITY, -INFINITY, NAN };
+  std::vector<std::string> lines(std::begin(optimizerCases), std::end(optimizerCases));
+  size_t caseCount = lines.size();
+  std::string line;
+  std::mt19937_64 generator(1);
+  std::uniform_real_distribution<double> mantissa(1, 10), exponent(-40, 40);
+  std::vector<double> values;
+  TokenList tokens;
+  ValueStack stack;
+  size_t rows = 0, differing = 0, mismatches = 0;
+  uint64_t maxUlp = 0;
+
+  while (inputStream && getline(*inputStream, line)) {
+    lines.push_back(line);
+  }
+
+  for (size_t i = 0; i < lines.size(); ++i) {
+    const std::string &text = lines[i];
+    Program program;
+
+    line = text;
+    tokens.clear();
+    CleanString(line);
+    Tokenise(tokens, line);
+    InfixToPostfix(tokens);
+
+    if (CompilePostfix(tokens, program, engineOptions)) {
       continue;
     }
 
-    // ? Checks if current char is a digit or a '.'
-    if (isdigit(currentChar) || currentChar == '.') {
-      currentToken += currentChar;
-      continue;
+    Program optimized = program;
+    OptimizeProgram(optimized);
+    values.resize(program.variables.size());
+
+    // ? Without variables one row is enough
+    for (size_t row = 0; row < (values.empty() ? 1 : 1000); ++row) {
+      for (double &value : values) {
+        value = (generator() % 8) ? std::copysign(mantissa(generator) * pow(10, exponent(generator)), (generator() & 1) ? 1.0 : -1.0) :
+          specials[generator() % std::size(specials)];
+      }
+
+      double expected = -1, result = -1; // ? What both give when they divide by zero
+      bool expectedDivision = static_cast<bool>(RunProgram(program, stack, values.data(), expected));
+      bool division = static_cast<bool>(RunProgram(optimized, stack, values.data(), result));
+      uint64_t ulp = UlpDistance(expected, result);
+
+      rows++;
+      differing += ulp != 0;
+      maxUlp = std::max(maxUlp, ulp);
+
+      bool sameKind = (
+        std::isnan(expected) == std::isnan(result) && std::isinf(expected) == std::isinf(result) &&
+        (expected == 0) == (result == 0) && (std::isnan(expected) || std::signbit(expected) == std::signbit(result)) &&
+        expectedDivision == division
+      );
+
+      if ((!sameKind || (i < caseCount && ulp > 1)) && mismatches++ < 10) {
+        std::cerr << text << ": optimized gave " << std::setprecision(17) << result << " instead of " << expected << std::setprecision(6) << '\n';
+      }
     }
+  }
 
-    //? Checks if current char is pi, e, or tau
-    if (currentChar == 'e') {
-      tokens.push_back("2.7182818284");
-      if (i && isdigit(input[i - 1])) tokens.push_back("*");
-      continue;
+  std::cerr << rows << " rows, " << differing << " differ, by at most " << maxUlp << " ulp\n";
+  std::cerr << mismatches << " mismatches\n";
+  return !mismatches;
+}
+
+
+/*
+  * Times every built-in function on count random arguments, called straight from libm, through RunProgram and through the SIMD kernel,
+  * the last two in both tiers, and measures the fast tier against libm in ulps.
+  * The SIMD kernel has to match RunProgram bit for bit in either tier.
+*/
+void RunFunctionBenchmark(size_t count) {
+  struct Function {
+    const char *name;
+    double (*unary)(double); // ? The libm function it is timed and checked against
+    double (*binary)(double, double);
+    double low, high; // ? Arguments are uniform in [low, high], or 2^x with x uniform in it when exponential is set
+    bool exponential;
+  };
+  static const Function functions[] = {
+    { "sqrt", sqrt, nullptr, -1074, 1023, true },
+    { "abs", fabs, nullptr, -1000, 1000, false },
+    { "exp", exp, nullptr, -745, 709, false },
+    { "log", log, nullptr, -1074, 1023, true },
+    { "sin", sin, nullptr, -1000, 1000, false },
+    { "cos", cos, nullptr, -1000, 1000, false },
+    { "min", nullptr, fmin, -1000, 1000, false },
+    { "max", nullptr, fmax, -1000, 1000, false }
+  };
+
+  count = std::max<size_t>(4, count / 4 * 4); // ? Whole vectors, so the SIMD kernel evaluates every row
+  std::mt19937_64 generator(20240601);
+  std::vector<double> a(count), b(count), packed(count * 2), expected(count), scalar(count), simd(count);
+  const double *columns[] = { a.data(), b.data() };
+  size_t passes = std::max<size_t>(1, (1 << 22) / count);
+  size_t mismatches = 0;
+  ValueStack stack;
+
+  auto Time = [&](auto run) {
+    auto start = std::chrono::steady_clock::now();
+
+    for (size_t pass = 0; pass < passes; ++pass) {
+      run();
     }
 
-    if (input.substr(i, 2) == "pi") {
-      tokens.push_back("3.1415926535");
-      if (i && isdigit(input[i - 1])) tokens.push_back("*");
-      i++;
-      continue;
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / (passes * count);
+  };
+
+  std::cerr << "function  libm ns  scalar ns    simd ns  fast scalar ns  fast simd ns  max ulp  mean ulp\n";
+
+  for (const Function &function : functions) {
+    std::uniform_real_distribution<double> distribution(function.low, function.high);
+    Program program;
+
+    for (size_t i = 0; i < count; ++i) {
+      a[i] = function.exponential ? exp2(distribution(generator)) : distribution(generator);
+      b[i] = distribution(generator);
+      packed[i * 2] = a[i];
+      packed[i * 2 + 1] = b[i];
     }
 
-    if (input.substr(i, 3) == "tau") {
-      tokens.push_back("6.2831853071");
-      if (i && isdigit(input[i - 1])) tokens.push_back("*");
-      i += 2;
-      continue;
+    program.variables = { "x", "y" };
+    program.code = { { OpCode::Load, 0, 0 }, { OpCode::Load, 1, 0 }, { FunctionOpCode(function.name), 0, 0 } };
+    program.maxDepth = 2;
+
+    if (function.unary) {
+      program.code.erase(program.code.begin() + 1);
+      program.maxDepth = 1;
     }
 
-    // ? If current char is an operator, then it means that the previous digits are complete
-    if (!currentToken.empty()) {
-      tokens.push_back(currentToken); 
-      currentToken.clear(); 
+    double libmTime = Time([&] {
+      for (size_t i = 0; i < count; ++i) {
+        expected[i] = function.unary ? function.unary(a[i]) : function.binary(a[i], b[i]);
+      }
+    });
+
+    double times[2][2] = {}; // ? Indexed by fast tier, then SIMD
+    uint64_t maxUlp = 0;
+    double totalUlp = 0;
+
+    for (int fast = 0; fast < 2; ++fast) {
+      program.fastFunctions = fast;
+
+      times[fast][0] = Time([&] {
+        for (size_t i = 0; i < count; ++i) {
+          RunProgram(program, stack, &packed[i * 2], scalar[i]);
+        }
+      });
+
+#ifdef HAS_X86_SIMD
+      ColumnStacks stacks;
+      bool divisionByZero = false;
+
+      if (simdLevel == SimdLevel::Avx2) {
+        times[fast][1] = Time([&] { RunProgramAvx2(program, columns, count, simd.data(), stacks.avx2, divisionByZero); });
+      } else if (simdLevel == SimdLevel::Sse2) {
+        times[fast][1] = Time([&] { RunProgramSse2(program, columns, count, simd.data(), stacks.sse2, divisionByZero); });
+      }
+
+      for (size_t i = 0; times[fast][1] && i < count; ++i) {
+        if (!SameResult(scalar[i], simd[i]) && mismatches++ < 10) {
+          std::cerr << function.name << (fast ? " (fast)" : "") << " of " << std::setprecision(17) << a[i] << ": SIMD gave " << simd[i]
+                    << " instead of " << scalar[i] << std::setprecision(6) << '\n';
+        }
+      }
+#else
+      (void)columns;
+#endif
     }
 
-    // ? Avoid pushing an empty token for the end of the string
-    if (currentChar != '\0' && !isalpha(currentChar)) {
-      tokens.push_back(std::string(1, currentChar)); 
+    for (size_t i = 0; i < count; ++i) {
+      uint64_t ulp = UlpDistance(scalar[i], expected[i]);
+      maxUlp = std::max(maxUlp, ulp);
+      totalUlp += ulp;
     }
+
+    fprintf(stderr, "%-8s %8.2f %10.2f %10.2f %15.2f %13.2f %8llu %9.3f\n", function.name, libmTime, times[0][0], times[0][1], times[1][0], times[1][1],
+            static_cast<unsigned long long>(maxUlp), totalUlp / count);
   }
+
+  std::cerr << count << " arguments per function, " << mismatches << " SIMD mismatches\n";
 }
 
 
-int Precedence(std::string operation) {
-  if (operation == "+" || operation == "-") return 1;
-  if (operation == "*" || operation == "/") return 2;
-  if (operation == "^") return 3; // ? Assuming ^ has the highest precedence
-  return 0; // ? Default for unsupported operators
+// * text with every character CleanString would drop turned into a space, which calc::compile skips without moving any position
+std::string BlankInvalid(std::string text) {
+  for (char &c : text) {
+    if (!IsValid(c)) {
+      c = ' ';
+    }
+  }
+
+  return text;
 }
 
 
-/*
-  * Applies the shunting yard algorithm to converts infix to postfix notation
-  * https://en.wikipedia.org/wiki/Shunting_yard_algorithm#The_algorithm_in_detail
-*/
-void InfixToPostfix(std::vector<std::string> &input) {
-  std::vector<std::string> output, stack;
+enum class Mode {
+  Interactive,
+  Batch,
+  Csv,
+  Binary,
+  BenchInterpreter,
+  ValidateJit,
+  CheckConstexpr,
+  BenchLibrary,
+  GenerateCorpus,
+  BenchStages,
+  BenchThreads,
+  Incremental,
+  BenchIncremental,
+  BenchFused,
+  BenchFunctions,
+  BenchIntegers,
+  Stream,
+  Stress,
+  CheckBatch,
+  CheckOptimizer
+};
 
-  for (std::string token : input) {
-    // ? If token is a digit, push it to output.
-    if (StrIsDigit(token)) {
-      output.push_back(token);
-      continue;
-    }
 
-    // ? If token is operator, push it to stack
-    if (IsOperator(token[0])) {      
-      while (!stack.empty() && Precedence(stack.back()) >= Precedence(token)) {
-        output.push_back(stack.back());
-        stack.pop_back();
+int main(int argc, char *argv[]) {
+  Mode mode = Mode::Interactive;
+  bool cacheResults = false;
+  size_t cacheMegabytes = 0;
+  int threadCount = 1;
+  size_t benchIterations = 10000000;
+  size_t validateExpressions = 10000;
+  size_t corpusSize = 100000;
+  size_t editTokens = 10000;
+  size_t functionArguments = 1 << 16;
+  size_t stressMegabytes = 100;
+  size_t maxDepth = 10000; // ? Limits of --stream and --stress, in stack entries, in values and operators per line and in characters per number
+  size_t maxTokens = SIZE_MAX;
+  size_t maxLiteral = 1 << 16;
+  bool printStats = false;
+  bool sharedSubexpressions = false;
+  bool pipelined = false;
+  int decimalPrecision = 0; // ? Significant digits of the decimal backend, 0 uses doubles
+  CorpusOptions corpusOptions;
+  std::string inputFile;
+  std::string formula;
+  std::string columnList;
+
+  std::ios::sync_with_stdio(false);
+
+  for (int i = 1; i < argc; ++i) {
+    std::string option = argv[i];
+
+    if (option == "--batch" || option == "--csv" || option == "--binary") {
+      // ? --batch [file] evaluates one expression per line from the file or stdin
+      // ? --csv [file] and --binary [file] evaluate --formula once per row of the file or stdin
+      mode = (option == "--batch") ? Mode::Batch : (option == "--csv") ? Mode::Csv : Mode::Binary;
+
+      if (i + 1 < argc && argv[i + 1][0] != '-') {
+        inputFile = argv[++i];
       }
+    } else if (option == "--bench-interpreter") { // ? --bench-interpreter [iterations] times the interpreters on --formula
+      mode = Mode::BenchInterpreter;
 
-      stack.push_back(token);
-    }
+      if (i + 1 < argc && argv[i + 1][0] != '-') {
+        benchIterations = std::stoul(argv[++i]);
+      }
+    } else if (option == "--validate-jit") { // ? --validate-jit [expressions] checks native code on random expressions
+      mode = Mode::ValidateJit;
 
-    if (token == "(") {
-      stack.push_back(token);
-      continue;
-    }
+      if (i + 1 < argc && argv[i + 1][0] != '-') {
+        validateExpressions = std::stoul(argv[++i]);
+      }
+    } else if (option == "--bench-library") { // ? --bench-library [iterations] times in process library calls against a process per call
+      mode = Mode::BenchLibrary;
 
-    if (token == ")") {
-      while (!stack.empty() && stack.back() != "(") {
-        output.push_back(stack.back());
-        stack.pop_back();
+      if (i + 1 < argc && argv[i + 1][0] != '-') {
+        benchIterations = std::stoul(argv[++i]);
       }
-      // ? Pop the left parenthesis from the stack
-      if (!stack.empty()) {
-        stack.pop_back();
+    } else if (option == "--generate-corpus") { // ? --generate-corpus [count] writes random expressions shaped by the options below
+      mode = Mode::GenerateCorpus;
+
+      if (i + 1 < argc && argv[i + 1][0] != '-') {
+        corpusSize = std::stoul(argv[++i]);
+      }
+    } else if (option == "--seed" && i + 1 < argc) {
+      corpusOptions.seed = std::stoull(argv[++i]);
+    } else if (option == "--length" && i + 1 < argc) {
+      corpusOptions.length = std::max(1, std::stoi(argv[++i]));
+    } else if (option == "--depth" && i + 1 < argc) {
+      corpusOptions.depth = std::stoi(argv[++i]);
+    } else if (option == "--constants" && i + 1 < argc) { // ? Chance of an operand being a named constant, 0 to 1
+      corpusOptions.constants = std::stod(argv[++i]);
+    } else if (option == "--operators" && i + 1 < argc) { // ? Operators to draw from, any of +-*/^
+      corpusOptions.operators = argv[++i];
+    } else if (option == "--integers") { // ? Generated corpora use only whole numbers
+      corpusOptions.integers = true;
+    } else if (option == "--bench-stages") { // ? --bench-stages [file] times every stage over a corpus and prints JSON
+      mode = Mode::BenchStages;
+
+      if (i + 1 < argc && argv[i + 1][0] != '-') {
+        inputFile = argv[++i];
+      }
+    } else if (option == "--bench-threads") { // ? --bench-threads [file] times --batch at every thread count up to the core count and prints JSON
+      mode = Mode::BenchThreads;
+
+      if (i + 1 < argc && argv[i + 1][0] != '-') {
+        inputFile = argv[++i];
+      }
+    } else if (option == "--incremental") { // ? Reads an expression and then edits of it, re-evaluating only what each edit touches
+      mode = Mode::Incremental;
+    } else if (option == "--bench-incremental") { // ? --bench-incremental [tokens] times keystrokes on a generated expression
+      mode = Mode::BenchIncremental;
+
+      if (i + 1 < argc && argv[i + 1][0] != '-') {
+        editTokens = std::stoul(argv[++i]);
+      }
+    } else if (option == "--fused") { // ? Evaluates without compiling, in one pass over the text
+      fusedEvaluation = true;
+    } else if (option == "--bench-fused") { // ? --bench-fused [file] compares one pass evaluation with compiling, by expression size
+      mode = Mode::BenchFused;
+
+      if (i + 1 < argc && argv[i + 1][0] != '-') {
+        inputFile = argv[++i];
+      }
+    } else if (option == "--bench-integers") { // ? --bench-integers [file] times compiling and running with exact integers against doubles only
+      mode = Mode::BenchIntegers;
+
+      if (i + 1 < argc && argv[i + 1][0] != '-') {
+        inputFile = argv[++i];
+      }
+    } else if (option == "--stream") { // ? --stream [file] evaluates like --batch --fused in memory bounded by --max-depth, however long the lines
+      mode = Mode::Stream;
+
+      if (i + 1 < argc && argv[i + 1][0] != '-') {
+        inputFile = argv[++i];
+      }
+    } else if (option == "--stress") { // ? --stress [MiB] streams generated inputs that large and reports peak memory
+      mode = Mode::Stress;
+
+      if (i + 1 < argc && argv[i + 1][0] != '-') {
+        stressMegabytes = std::stoul(argv[++i]);
+      }
+    } else if (option == "--max-depth" && i + 1 < argc) { // ? --max-depth <N> fails --stream lines nested deeper than N
+      maxDepth = std::max<size_t>(1, std::stoul(argv[++i]));
+    } else if (option == "--max-tokens" && i + 1 < argc) { // ? --max-tokens <N> fails --stream lines with more than N values and operators
+      maxTokens = std::stoul(argv[++i]);
+    } else if (option == "--max-literal" && i + 1 < argc) { // ? --max-literal <N> fails --stream lines with a number longer than N characters
+      maxLiteral = std::max<size_t>(1, std::stoul(argv[++i]));
+    } else if (option == "--no-integers") { // ? Evaluates integers as doubles too, instead of exactly while they fit in int64
+      engineOptions.integers = false;
+    } else if (option == "--fast-functions") { // ? exp, log, sin and cos use polynomial approximations instead of libm
+      engineOptions.fastFunctions = true;
+    } else if (option == "--bench-functions") { // ? --bench-functions [count] times the built-in functions and measures the fast ones against libm
+      mode = Mode::BenchFunctions;
+
+      if (i + 1 < argc && argv[i + 1][0] != '-') {
+        functionArguments = std::stoul(argv[++i]);
+      }
+    } else if (option == "--check-optimizer") { // ? --check-optimizer [file] compares optimized programs with unoptimized ones
+      mode = Mode::CheckOptimizer;
+
+      if (i + 1 < argc && argv[i + 1][0] != '-') {
+        inputFile = argv[++i];
+      }
+    } else if (option == "--check-batch") { // ? Checks what batch lines with long literals, malformed numbers and divisions by zero print
+      mode = Mode::CheckBatch;
+    } else if (option == "--check-constexpr") { // ? Compares Calculator.hpp with the runtime engine
+      mode = Mode::CheckConstexpr;
+    } else if (option == "--formula" && i + 1 < argc) {
+      formula = argv[++i];
+    } else if (option == "--columns" && i + 1 < argc) { // ? Names of the columns of a --binary file, in record order
+      columnList = argv[++i];
+    } else if (option == "--cache" && i + 1 < argc) { // ? --cache <MiB> caches compiled programs up to that size
+      cacheMegabytes = std::stoul(argv[++i]);
+    } else if (option == "--shared") { // ? Evaluates a whole --batch as one graph, so subexpressions shared between lines run once
+      sharedSubexpressions = true;
+    } else if (option == "--pipeline") { // ? Runs the stages of a --batch concurrently, one thread each
+      pipelined = true;
+    } else if (option == "--cache-results") { // ? Also cache the results of cached programs
+      cacheResults = true;
+    } else if (option == "--threads" && i + 1 < argc) { // ? --threads <N> evaluates batches on N threads, 0 uses every core
+      threadCount = std::stoi(argv[++i]);
+
+      if (threadCount <= 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+      }
+    } else if (option == "--precision" && i + 1 < argc) { // ? --precision <digits> evaluates with decimals rounded to that many significant digits
+      decimalPrecision = std::stoi(argv[++i]);
+
+      if (decimalPrecision < 1) {
+        std::cerr << "--precision needs at least 1 digit" << '\n';
+        return 1;
       }
+    } else if (option == "--stats") { // ? Prints stage timings, stack depths and error counts to stderr on exit
+      printStats = true;
+    } else if (option == "--no-optimize") { // ? Evaluates programs exactly as compiled
+      engineOptions.optimize = false;
+    } else if (option == "--jit-threshold" && i + 1 < argc) { // ? --jit-threshold <rows> compiles a formula to native code once it is that hot, 0 never does
+      jitThreshold = std::stoul(argv[++i]);
+    } else if (option == "--simd" && i + 1 < argc) { // ? --simd scalar|sse2|avx2 caps the evaluation kernel
+      std::string level = argv[++i];
+      SimdLevel requested = (level == "avx2") ? SimdLevel::Avx2 : (level == "sse2") ? SimdLevel::Sse2 : SimdLevel::Scalar;
+      simdLevel = std::min(simdLevel, requested);
+    } else {
+      std::cerr << "Unknown option " << option << '\n';
+      return 1;
     }
   }
 
-  while (!stack.empty()) {
-    output.push_back(stack.back());
-    stack.pop_back();
+  if (decimalPrecision && mode != Mode::Batch && mode != Mode::Interactive) {
+    std::cerr << "--precision only works with --batch and typed expressions" << '\n';
+    return 1;
   }
 
-  input = output;
-}
+  // ? --shared, --precision and --pipeline each replace the batch loop that --fused, --cache and --threads tune
+  if (mode == Mode::Batch) {
+    int variants = sharedSubexpressions + (decimalPrecision > 0) + pipelined;
+    bool tuned = fusedEvaluation || cacheMegabytes || cacheResults || threadCount != 1;
 
+    if (variants > 1 || (variants && tuned)) {
+      std::cerr << "--shared, --precision and --pipeline work neither together nor with --fused, --cache, --cache-results or --threads" << '\n';
+      return 1;
+    }
 
-double PerformOperation(double a, double b, char operation) {
-  switch (operation) {
-    case '*':
-      return a * b;
-    case '/':
-      if (!b) {
-        std::cerr << "Division by zero!" << '\n';
-        break;
-      }
-      return a / b;
-    case '+':
-      return a + b;
-    case '-':
-      return a - b;
-    case '^':
-      return pow(a, b);
+    // ? --fused compiles nothing, so there would be nothing for the cache to keep
+    if (fusedEvaluation && (cacheMegabytes || cacheResults)) {
+      std::cerr << "--fused works neither with --cache nor with --cache-results" << '\n';
+      return 1;
+    }
   }
 
-  return -1;
-}
+#ifdef CALCULATOR_STATS
+#ifdef SIGUSR1
+  StartStatsSignalThread(); // ? Before any other thread starts, so they all inherit the blocked signal
+#endif
 
+  if (printStats) {
+    atexit(PrintStats);
+  }
+#else
+  if (printStats) {
+    std::cerr << "Stats are not compiled in, build with -DCALCULATOR_STATS" << '\n';
+  }
+#endif
 
-double PostfixEvaluation(std::vector<std::string> tokens) {
-  std::vector<double> stack;
+  if (mode == Mode::ValidateJit) {
+#ifdef HAS_JIT
+    return ValidateJit(validateExpressions) ? 0 : 1;
+#else
+    std::cerr << "Native code is not supported on this platform" << '\n';
+    return 1;
+#endif
+  }
 
-  for (std::string token : tokens) {
-    if (StrIsDigit(token)) {
-      stack.push_back(stod(token));
-      continue;
+  if (mode == Mode::GenerateCorpus) {
+    if (corpusOptions.operators.empty() || corpusOptions.operators.find_first_not_of("+-*/^") != std::string::npos) {
+      std::cerr << "--operators takes any of +-*/^" << '\n';
+      return 1;
     }
 
-    double num2 = stack.back(); stack.pop_back(); // ? Second operand
-    double num1 = stack.back(); stack.pop_back(); // ? First operand
-    double result = PerformOperation(num1, num2, token[0]);
-    stack.push_back(result);
+    RunGenerateCorpus(corpusOptions, corpusSize);
+    return 0;
   }
 
-  if (stack.size() != 1) {
-    std::cerr << "Too many operands!" << '\n';
-    return -1;
+  if (mode == Mode::BenchIncremental) {
+    RunIncrementalBenchmark(corpusOptions, editTokens, 2000);
+    return 0;
   }
 
-  return stack.back();
-}
+  if (mode == Mode::Incremental) {
+    RunIncremental(std::cin);
+    return 0;
+  }
 
+  if (mode == Mode::BenchLibrary) {
+    RunLibraryBenchmark(argv[0], benchIterations);
+    return 0;
+  }
 
-void PrintVector(const std::vector<std::string> input) {
-  int totalLen = 0;
+  if (mode == Mode::BenchFunctions) {
+    RunFunctionBenchmark(functionArguments);
+    return 0;
+  }
 
-  for (std::string s : input) {
-    totalLen += s.length();
+  if (mode == Mode::Stress) {
+    RunStressTest(stressMegabytes, maxDepth, maxTokens, maxLiteral);
+    return 0;
   }
 
-  totalLen += (input.size() * 2);
+  if (mode == Mode::CheckBatch) {
+    return CheckBatch() ? 0 : 1;
+  }
 
-  for (int i = input.size(); i > 2; --i) {
-    if (i & 1) {
-      totalLen += 2;
+  if (mode == Mode::CheckConstexpr) {
+#ifdef HAS_CONSTEXPR_CALC
+    return CheckConstexpr() ? 0 : 1;
+#else
+    std::cerr << "Calculator.hpp needs C++20, build with -std=c++20" << '\n';
+    return 1;
+#endif
+  }
+
+  std::ifstream file;
+
+  if (!inputFile.empty()) {
+    file.open(inputFile, std::ios::binary);
+
+    if (!file) {
+      std::cerr << "Could not open " << inputFile << '\n';
+      return 1;
     }
   }
 
-  std::cout << "\e[1;36m╭";
+  std::istream &inputStream = inputFile.empty() ? std::cin : file;
 
-  for (int i = 0; i < totalLen; ++i) {
-    std::cout << "─";
+  if (mode == Mode::BenchThreads) {
+    // ? --threads raises or lowers the last count, which is the core count otherwise
+    RunThreadBenchmark(inputStream, (threadCount != 1) ? threadCount : std::max(1u, std::thread::hardware_concurrency()));
+    return 0;
   }
 
-  std::cout << "╮\n│";
+  if (mode == Mode::BenchStages) {
+    RunStageBenchmark(inputStream);
+    return 0;
+  }
 
-  for (std::string s : input) {
-    std::cout << "\e[1;37m " << s << " \e[1;36m│";
+  if (mode == Mode::CheckOptimizer) {
+    return CheckOptimizer(inputFile.empty() ? nullptr : &inputStream) ? 0 : 1;
   }
 
-  std::cout << "\n╰";
+  if (mode == Mode::BenchFused) {
+    RunFusedBenchmark(inputStream);
+    return 0;
+  }
 
-  for (int i = 0; i < totalLen; ++i) {
-    std::cout << "─";
+  if (mode == Mode::BenchIntegers) {
+    RunIntegerBenchmark(inputStream);
+    return 0;
   }
 
-  std::cout << "╯\n";
-}
+  if (mode == Mode::Stream) {
+    RunStream(inputStream, maxDepth, maxTokens, maxLiteral);
+    return 0;
+  }
+
+  if (mode == Mode::Batch && sharedSubexpressions) {
+    RunDagBatch(inputStream);
+    return 0;
+  }
+
+  if (mode == Mode::Batch && decimalPrecision) {
+    RunDecimalBatch(inputStream, decimalPrecision);
+    return 0;
+  }
+
+  if (mode == Mode::Batch && pipelined) {
+    RunPipelinedBatch(inputStream);
+    return 0;
+  }
 
+  if (mode == Mode::Batch) {
+    MappedFile mappedFile;
+    bool mapped = !inputFile.empty() && mappedFile.Map(inputFile);
 
-int main() {
-  std::vector<std::string> tokens;
+    RunBatch(inputStream, mapped ? &mappedFile : nullptr, threadCount, cacheMegabytes << 20, cacheResults);
+    return 0;
+  }
+
+  if (mode == Mode::Csv || mode == Mode::Binary || mode == Mode::BenchInterpreter) {
+    Program program;
+    calc::Options options = engineOptions;
+    options.optimize = false; // ? Done below instead, to say how much it removed
+    calc::Error error = calc::compile(BlankInvalid(formula), program, options);
+
+    if (error) {
+      std::cerr << "Invalid formula: " << calc::message(error.code) << " at column " << error.position + 1 << '\n';
+      return 1;
+    }
+
+    if (engineOptions.optimize) {
+      size_t compiledInstructions = program.code.size();
+      std::cerr << "Optimizer removed " << OptimizeProgram(program) << " of " << compiledInstructions << " instructions\n";
+    }
+
+    if (mode == Mode::BenchInterpreter) {
+      RunInterpreterBenchmark(program, benchIterations);
+      return 0;
+    }
+
+    if (mode == Mode::Binary && columnList.empty()) {
+      std::cerr << "--binary needs --columns" << '\n';
+      return 1;
+    }
+
+    bool success = (mode == Mode::Csv) ?
+      RunCsv(inputStream, program) :
+      RunBinary(inputStream, program, SplitNames(columnList));
+
+    return success ? 0 : 1;
+  }
+
+  TokenList tokens;
+  ValueStack stack;
   std::string input;
+  Program program;
 
   getline(std::cin, input);
 
-  CleanString(input); // ? Cleans the string from any letters and whitespaces
+  // ? Errors go through the pipeline below, which reports them in more detail
+  if (fusedEvaluation && !decimalPrecision) {
+    double result;
+    char number[NUMBER_LENGTH];
+
+    if (FusedEvaluation(input, result) == FusedStatus::Ok) {
+      std::cout << "\n\e[1;37mResult: " << std::string_view(number, FormatNumber(number, result)) << '\n';
+      return 0;
+    }
+  }
+
+  std::string original = BlankInvalid(input); // ? Errors are reported against what was typed
+
+  CleanString(input); // ? Cleans the string from whitespaces and unknown characters
 
   Tokenise(tokens, input); // ? Tokenize the input
 
@@ -268,6 +5443,39 @@ int main() {
   std::cout << "\nInfix:\n";
   PrintVector(tokens); // ? Print the tokens
 
-  std::cout << "\n\e[1;37mResult: " << std::setprecision(11) << PostfixEvaluation(tokens) << '\n'; // ? Print result
+  calc::Error error = calc::compile(original, program, engineOptions); // ? Turn what was typed into a program, so errors point into it
+
+  if (error) {
+    std::cerr << "Invalid expression: " << calc::message(error.code) << " at column " << error.position + 1 << '\n';
+    return 1;
+  }
+
+  if (!program.variables.empty()) {
+    std::cerr << "Unknown variable " << program.variables[0] << '\n';
+    STATS_ERROR(StatError::UnknownVariable);
+    return 1;
+  }
+
+  if (decimalPrecision) {
+    calc::Decimal result;
+
+    if (!DecimalPostfixEvaluation(tokens, decimalPrecision, result)) {
+      return 1;
+    }
+
+    std::cout << "\n\e[1;37mResult: " << calc::toString(result) << '\n';
+    return 0;
+  }
+
+  char number[NUMBER_LENGTH];
+  double result;
+  error = RunProgram(program, stack, result);
+
+  if (error) {
+    std::cerr << "Division by zero at column " << error.position + 1 << '\n';
+    return 1;
+  }
+
+  std::cout << "\n\e[1;37mResult: " << std::string_view(number, FormatNumber(number, result)) << '\n'; // ? Print result
   return 0;
 }
\ No newline at end of file
@@ -3,7 +3,41 @@
 #include <vector>
 #include <stack>
 #include <cmath>
+#include <fstream>
+#include <chrono>
+#include <memory_resource>
+#include <string_view>
+#include <new>
+#include <charconv>
+#include <cstring>
 #include <stdio.h>
+#include <stdlib.h>
+#include "Calculator-Arena.hpp"
+
+#ifdef __linux__
+#define HAS_EPOLL // ? The server mode is built on epoll, so it is Linux only
+#include <algorithm>
+#include <thread>
+#include <unordered_map>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+#define WRITE_BUFFER_SIZE (1 << 20)
+#define READ_BUFFER_SIZE (64 << 10)
+#define MAX_REQUEST_SIZE (1 << 20)
+#define MAX_EVENTS 256
+#define MAX_LATENCY_SAMPLES (1 << 20)
+#define NUMBER_LENGTH 24 // ? Longest shortest round-trip double, -2.2250738585072014e-308
+
+
+using Token = std::pmr::string;
+using TokenList = std::pmr::vector<Token>;
 
 
 // ? Functions that is used to make other functions function functionally
@@ -22,7 +56,43 @@ bool isroot(const char inputChar) {
 }
 
 
-int Precedence(std::string operation) {
+// ? Negative numbers start with '-', so the first char alone does not tell them apart from operators
+bool isnumber(std::string_view token) {
+  return isdigit(token[0]) || (token.length() > 1 && token[0] == '-');
+}
+
+
+// * Parses a whole number token with from_chars, false if any of it is left over, like in "--5" or "5.-3"
+bool ParseNumber(std::string_view token, double &value) {
+  const char *end = token.data() + token.length();
+  std::from_chars_result read = std::from_chars(token.data(), end, value);
+
+  if (read.ec == std::errc::result_out_of_range) {
+    value = strtod(std::string(token).c_str(), nullptr); // ? from_chars leaves value alone, strtod gives infinity or zero
+  }
+
+  return read.ec != std::errc::invalid_argument && read.ptr == end;
+}
+
+
+// * Writes the shortest text that reads back as exactly value and returns its length, buffer needs NUMBER_LENGTH bytes
+size_t FormatNumber(char *buffer, double value) {
+  return std::to_chars(buffer, buffer + NUMBER_LENGTH, value).ptr - buffer;
+}
+
+
+// * Formats value and a newline straight onto the end of output
+void AppendNumber(std::string &output, double value) {
+  size_t used = output.size();
+
+  output.resize(used + NUMBER_LENGTH + 1);
+  used += FormatNumber(&output[used], value);
+  output[used++] = '\n';
+  output.resize(used);
+}
+
+
+int Precedence(std::string_view operation) {
   if (operation == "+" || operation == "-") return 1;
   if (operation == "*" || operation == "/") return 2;
   if (operation == "^" || operation == "$") return 3;
@@ -30,13 +100,16 @@ int Precedence(std::string operation) {
 }
 
 
+bool dividedByZero = false; // ? Set by every division by zero, batch lines print "error" and the interactive prompt says so
+
+
 double PerformOperation(double a, double b, char operation) {
   switch (operation) {
     case '*':
       return a * b;
     case '/':
       if (!b) {
-        std::cerr << "Division by zero!" << '\n';
+        dividedByZero = true;
         break;
       }
       return a / b;
@@ -58,31 +131,32 @@ double PerformOperation(double a, double b, char operation) {
 /*
   * Checks if there are any constants in the given string
 */
-void CheckConstants(std::vector<std::string> &tokens, int &index, const std::string str) {
+void CheckConstants(TokenList &tokens, int &index, const std::string &str) {
   bool isSuccess = false;
   int addLen;
+  char number[NUMBER_LENGTH];
 
 
   if (str[index] == 'e') {
-    tokens.push_back(std::to_string(M_E));
+    tokens.emplace_back(number, FormatNumber(number, M_E));
     isSuccess = true;
     addLen = 0;
-  } else if (str.substr(index, 2) == "pi") {
-    tokens.push_back(std::to_string(M_PI));
+  } else if (str.compare(index, 2, "pi") == 0) {
+    tokens.emplace_back(number, FormatNumber(number, M_PI));
     isSuccess = true;
     addLen = 1;
-  } else if (str.substr(index, 3) == "tau") {
-    tokens.push_back(std::to_string(M_PI * 2.0000000000));
+  } else if (str.compare(index, 3, "tau") == 0) {
+    tokens.emplace_back(number, FormatNumber(number, M_PI * 2.0000000000));
     isSuccess = true;
     addLen = 2;
-  } else if (str.substr(index, 4) == "root") {
-    tokens.push_back("$"); // ? $ is a character that is used to replace "sqrt"
+  } else if (str.compare(index, 4, "root") == 0) {
+    tokens.emplace_back("$"); // ? $ is a character that is used to replace "sqrt"
     index += 3;
     return;
   }
 
   if (isSuccess && index && isdigit(str[index - 1])) {
-    tokens.push_back("*");
+    tokens.emplace_back("*");
     index += addLen;
   }
 }
@@ -91,12 +165,13 @@ void CheckConstants(std::vector<std::string> &tokens, int &index, const std::str
 /*
   * Tokenise inputString
   * 
-  * @param inputTokens The token vector that is going to be filled with the tokens
+  * @param tokens The token vector that is going to be filled with the tokens, its allocator backs every token
   * @param inputString The string that is going to be vectorised
 */
-void Tokenise(std::vector<std::string> &inputTokens, const std::string inputString) {
-  std::vector<std::string> tokens;
-  std::string currentToken;
+void Tokenise(TokenList &tokens, const std::string &inputString) {
+  Token currentToken(tokens.get_allocator());
+
+  tokens.clear();
 
   for (int i = 0; i <= inputString.length(); ++i) {
     char currentChar = (i < inputString.length()) ? inputString[i] : '\0';
@@ -124,11 +199,9 @@ void Tokenise(std::vector<std::string> &inputTokens, const std::string inputStri
 
     // ? Avoid pushing an empty token for the end of the string
     if (currentChar != '\0' && !isalpha(currentChar)) {
-      tokens.push_back(std::string(1, currentChar)); 
+      tokens.emplace_back(1, currentChar);
     }
   }
-
-  inputTokens = tokens;
 }
 
 
@@ -136,12 +209,12 @@ void Tokenise(std::vector<std::string> &inputTokens, const std::string inputStri
   * Applies the shunting yard algorithm to converts infix to postfix notation
   * source: https://en.wikipedia.org/wiki/Shunting_yard_algorithm#The_algorithm_in_detail
 */
-void ToPostfix(std::vector<std::string> &tokens) {
-  std::vector<std::string> postfixOutput;
-  std::stack<std::string> stack;
+void ToPostfix(TokenList &tokens) {
+  TokenList postfixOutput(tokens.get_allocator());
+  std::stack<Token, TokenList> stack(tokens.get_allocator());
 
-  for (const std::string token : tokens) {
-    if (isdigit(token[0])) {
+  for (const Token &token : tokens) {
+    if (isnumber(token)) {
       postfixOutput.push_back(token);
     } else if (isoperator(token[0])) {
       while (!stack.empty() && Precedence(stack.top()) >= Precedence(token)) {
@@ -165,32 +238,44 @@ void ToPostfix(std::vector<std::string> &tokens) {
     stack.pop();
   }
 
-  tokens = postfixOutput;
+  tokens.swap(postfixOutput);
 }
 
 
 /*
   * Perform operations / evaluate the answer from the postfix tokens
+  * Returns false if the tokens do not form a valid postfix expression
 */
-double EvaluatePostfix(std::vector<std::string> tokens) {
-  std::stack<double> stack;
+bool EvaluatePostfix(const TokenList &tokens, double &result) {
+  std::stack<double, std::pmr::vector<double>> stack(tokens.get_allocator());
+
+  for (const Token &token : tokens) {
+    if (isnumber(token)) {
+      double value;
 
-  for (const std::string token : tokens) {
-    if (isdigit(token[0])) {
-      stack.push(std::stod(token));
+      if (!ParseNumber(token, value)) {
+        return false;
+      }
+
+      stack.push(value);
       continue;
     }
 
+    if (stack.size() < 2) {
+      return false;
+    }
+
     double b = stack.top(); stack.pop();
     double a = stack.top(); stack.pop();
     stack.push(PerformOperation(a, b, token[0]));
   }
 
   if (stack.size() != 1) {
-    exit(1);
+    return false;
   }
 
-  return stack.top();
+  result = stack.top();
+  return true;
 }
 
 
@@ -210,7 +295,547 @@ void CleanString(std::string &inputString) {
 }
 
 
-int main() {
+// * Collects output and writes it to stdout in large blocks
+struct BufferedWriter {
+  std::string buffer;
+
+  BufferedWriter() { buffer.reserve(WRITE_BUFFER_SIZE); }
+  ~BufferedWriter() { Flush(); }
+
+  void Write(const char *data, size_t length) {
+    buffer.append(data, length);
+
+    if (buffer.size() >= WRITE_BUFFER_SIZE) {
+      Flush();
+    }
+  }
+
+  void WriteNumber(double value) {
+    AppendNumber(buffer, value);
+
+    if (buffer.size() >= WRITE_BUFFER_SIZE) {
+      Flush();
+    }
+  }
+
+  void Flush() {
+    fwrite(buffer.data(), 1, buffer.size(), stdout);
+    buffer.clear();
+  }
+};
+
+
+/*
+  * Cleans, tokenises and evaluates one expression out of arena, which is reset first
+  * line is cleaned in place, returns false if it is not a valid expression or divides by zero
+*/
+bool EvaluateLine(std::string &line, Arena &arena, double &result) {
+  CleanString(line);
+  arena.Reset();
+
+  TokenList tokens(&arena);
+  Tokenise(tokens, line);
+  ToPostfix(tokens);
+  dividedByZero = false;
+  return EvaluatePostfix(tokens, result) && !dividedByZero;
+}
+
+
+/*
+  * Evaluates every line of inputStream and writes one result per line to stdout
+  * Lines that cannot be evaluated print "error" and the batch carries on
+  * Every line is evaluated out of one arena, so heap allocations stop once it has warmed up
+*/
+void RunBatch(std::istream &inputStream) {
+  std::string line;
+  BufferedWriter writer;
+  Arena arena;
+  size_t lineCount = 0;
+  size_t allocations = 0;
+  size_t allocatingLines = 0;
+  double result;
+
+  auto start = std::chrono::steady_clock::now();
+
+  while (getline(inputStream, line)) {
+    size_t allocationsBefore = heapAllocations;
+    lineCount++;
+
+    if (EvaluateLine(line, arena, result)) {
+      writer.WriteNumber(result);
+    } else {
+      writer.Write("error\n", 6);
+    }
+
+    if (heapAllocations != allocationsBefore) {
+      allocations += heapAllocations - allocationsBefore;
+      allocatingLines++;
+    }
+  }
+
+  writer.Flush();
+
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  fprintf(stderr, "%zu lines in %fs (%.0f lines/s)\n", lineCount, elapsed.count(), lineCount / elapsed.count());
+  fprintf(stderr, "Heap allocations: %zu while evaluating, in %zu of %zu lines\n", allocations, allocatingLines, lineCount);
+}
+
+
+/*
+  * Times clean, tokenise, postfix and evaluate separately over every line of inputStream and prints one JSON object
+  * Each stage runs over the whole corpus before the next one starts
+*/
+void RunStageBenchmark(std::istream &inputStream) {
+  std::vector<std::string> lines;
+  std::string line;
+  size_t bytes = 0;
+
+  while (getline(inputStream, line)) {
+    bytes += line.size() + 1;
+    lines.push_back(line);
+  }
+
+  std::vector<TokenList> tokens(lines.size());
+  std::vector<double> stageSeconds;
+  double checksum = 0; // ? Sum of the finite results
+  size_t errors = 0;
+  size_t nonFinite = 0;
+  double result;
+
+  auto Stage = [&](auto run) {
+    auto start = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < lines.size(); ++i) {
+      run(i);
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    stageSeconds.push_back(elapsed.count());
+  };
+
+  Stage([&](size_t i) { CleanString(lines[i]); });
+  Stage([&](size_t i) { Tokenise(tokens[i], lines[i]); });
+  Stage([&](size_t i) { ToPostfix(tokens[i]); });
+  Stage([&](size_t i) {
+    if (!EvaluatePostfix(tokens[i], result)) {
+      errors++;
+    } else if (std::isfinite(result)) {
+      checksum += result;
+    } else {
+      nonFinite++;
+    }
+  });
+
+  static const char *const stageNames[] = { "clean", "tokenize", "postfix", "evaluate" };
+  double total = 0;
+
+  printf("{\"implementation\": \"C++/Calculator-2.cpp\", \"expressions\": %zu, \"bytes\": %zu, \"stages\": {", lines.size(), bytes);
+
+  for (size_t stage = 0; stage < stageSeconds.size(); ++stage) {
+    total += stageSeconds[stage];
+    printf("%s\"%s\": {\"seconds\": %.9f, \"ns_per_expression\": %.3f}", stage ? ", " : "", stageNames[stage], stageSeconds[stage], lines.empty() ? 0.0 : stageSeconds[stage] * 1e9 / lines.size());
+  }
+
+  printf("}, \"total_seconds\": %.9f, \"errors\": %zu, \"non_finite\": %zu, \"checksum\": %.17g}\n", total, errors, nonFinite, checksum);
+}
+
+
+#ifdef HAS_EPOLL
+volatile sig_atomic_t stopServer = 0;
+
+
+void StopServer(int) {
+  stopServer = 1;
+}
+
+
+// * Value at fraction of the sorted samples, samples gets partially reordered
+double Percentile(std::vector<double> &samples, double fraction) {
+  if (samples.empty()) {
+    return 0;
+  }
+
+  size_t index = std::min(samples.size() - 1, static_cast<size_t>(fraction * samples.size()));
+  std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+  return samples[index];
+}
+
+
+bool SetNonBlocking(int fd) {
+  int flags = fcntl(fd, F_GETFL, 0);
+  return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+
+// * One client of the server, requests are newline framed expressions and every answer is one line
+struct Connection {
+  std::string input;
+  std::string output;
+  bool closed = false;
+  bool finished = false; // ? The client has sent everything, it is closed once its answers are written
+  uint32_t events = EPOLLIN; // ? What it is registered with epoll for, EPOLLOUT while the socket buffer is full
+};
+
+
+// * Writes as much of the pending output as the socket takes, false if the client is gone
+bool FlushConnection(int epoll, int fd, Connection &connection) {
+  size_t written = 0;
+
+  while (written < connection.output.size()) {
+    ssize_t count = write(fd, connection.output.data() + written, connection.output.size() - written);
+
+    if (count < 0) {
+      if (errno == EINTR) continue;
+      if (errno != EAGAIN && errno != EWOULDBLOCK) return false;
+      break;
+    }
+
+    written += count;
+  }
+
+  connection.output.erase(0, written);
+
+  // ? A finished client stays readable at its end of file, so it is only watched for room to write
+  uint32_t events = 0;
+
+  if (!connection.finished) {
+    events |= EPOLLIN;
+  }
+
+  if (!connection.output.empty()) {
+    events |= EPOLLOUT;
+  }
+
+  if (events != connection.events) {
+    epoll_event event = {};
+    event.events = events;
+    event.data.fd = fd;
+    epoll_ctl(epoll, EPOLL_CTL_MOD, fd, &event);
+    connection.events = events;
+  }
+
+  return true;
+}
+
+
+/*
+  * Serves newline framed expressions on the Unix domain socket at path until SIGINT or SIGTERM
+  * Everything that arrives in one epoll wakeup is read first and then evaluated as one batch on a warm arena,
+  * latency is measured from the wakeup to the answer being handed to the socket
+*/
+int RunServer(const char *path) {
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un address = {};
+
+  if (listener < 0 || strlen(path) >= sizeof(address.sun_path)) {
+    fprintf(stderr, "Could not create a socket at %s\n", path);
+    return 1;
+  }
+
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, path);
+  unlink(path);
+
+  if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) || listen(listener, SOMAXCONN) || !SetNonBlocking(listener)) {
+    fprintf(stderr, "Could not listen on %s\n", path);
+    return 1;
+  }
+
+  // ? No SA_RESTART, so the signal wakes epoll_wait up
+  struct sigaction action = {};
+  action.sa_handler = StopServer;
+  sigaction(SIGINT, &action, nullptr);
+  sigaction(SIGTERM, &action, nullptr);
+  signal(SIGPIPE, SIG_IGN);
+
+  int epoll = epoll_create1(0);
+  epoll_event event = {};
+  event.events = EPOLLIN;
+  event.data.fd = listener;
+  epoll_ctl(epoll, EPOLL_CTL_ADD, listener, &event);
+
+  std::unordered_map<int, Connection> connections;
+  std::vector<int> readable;
+  epoll_event events[MAX_EVENTS];
+  char buffer[READ_BUFFER_SIZE];
+  std::string line;
+  Arena arena;
+  double result;
+  std::vector<double> latencies; // ? Microseconds, the oldest samples are overwritten once it is full
+  size_t requestCount = 0;
+  size_t batchCount = 0;
+  size_t largestBatch = 0;
+
+  fprintf(stderr, "Serving on %s\n", path);
+
+  while (!stopServer) {
+    int eventCount = epoll_wait(epoll, events, MAX_EVENTS, -1);
+
+    if (eventCount < 0) {
+      if (errno == EINTR) continue;
+      break;
+    }
+
+    auto wakeup = std::chrono::steady_clock::now();
+    readable.clear();
+
+    // * Read everything that has arrived
+
+    for (int i = 0; i < eventCount; ++i) {
+      int fd = events[i].data.fd;
+
+      if (fd == listener) {
+        int client;
+
+        while ((client = accept(listener, nullptr, nullptr)) >= 0) {
+          SetNonBlocking(client);
+          event.events = EPOLLIN;
+          event.data.fd = client;
+          epoll_ctl(epoll, EPOLL_CTL_ADD, client, &event);
+          connections[client];
+        }
+
+        continue;
+      }
+
+      Connection &connection = connections[fd];
+
+      if ((events[i].events & EPOLLOUT) && !FlushConnection(epoll, fd, connection)) {
+        connection.closed = true;
+      }
+
+      // ? Nothing more to read, so it only goes on to be answered or closed below
+      if (connection.closed || connection.finished) {
+        readable.push_back(fd);
+        continue;
+      }
+
+      if (!(events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+        continue;
+      }
+
+      ssize_t count;
+
+      while ((count = read(fd, buffer, sizeof(buffer))) > 0) {
+        connection.input.append(buffer, count);
+      }
+
+      // ? End of file still gets the answers to the requests that came before it
+      if (count == 0) {
+        connection.finished = true;
+      } else if ((errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) || connection.input.size() > MAX_REQUEST_SIZE) {
+        connection.closed = true;
+      }
+
+      readable.push_back(fd);
+    }
+
+    // * Evaluate every complete request of the wakeup as one batch
+
+    size_t batchSize = 0;
+
+    for (int fd : readable) {
+      Connection &connection = connections[fd];
+      size_t start = 0;
+      size_t end;
+
+      while ((end = connection.input.find('\n', start)) != std::string::npos) {
+        line.assign(connection.input, start, end - start);
+        start = end + 1;
+        batchSize++;
+
+        if (EvaluateLine(line, arena, result)) {
+          AppendNumber(connection.output, result);
+        } else {
+          connection.output.append("error\n", 6);
+        }
+      }
+
+      connection.input.erase(0, start);
+    }
+
+    // * Answer and drop the clients that are gone
+
+    for (int fd : readable) {
+      Connection &connection = connections[fd];
+
+      if (!connection.closed) {
+        connection.closed = !FlushConnection(epoll, fd, connection);
+      }
+
+      if (connection.closed || (connection.finished && connection.output.empty())) {
+        epoll_ctl(epoll, EPOLL_CTL_DEL, fd, nullptr);
+        close(fd);
+        connections.erase(fd);
+      }
+    }
+
+    if (batchSize) {
+      std::chrono::duration<double, std::micro> latency = std::chrono::steady_clock::now() - wakeup;
+
+      for (size_t i = 0; i < batchSize; ++i, ++requestCount) {
+        if (latencies.size() < MAX_LATENCY_SAMPLES) {
+          latencies.push_back(latency.count());
+        } else {
+          latencies[requestCount % MAX_LATENCY_SAMPLES] = latency.count();
+        }
+      }
+
+      batchCount++;
+      largestBatch = std::max(largestBatch, batchSize);
+    }
+  }
+
+  for (auto &[fd, connection] : connections) {
+    close(fd);
+  }
+
+  close(epoll);
+  close(listener);
+  unlink(path);
+
+  fprintf(stderr, "%zu requests in %zu batches (%.1f per batch, largest %zu)\n", requestCount, batchCount, batchCount ? static_cast<double>(requestCount) / batchCount : 0.0, largestBatch);
+  fprintf(stderr, "Server latency: p50 %.1fus, p99 %.1fus\n", Percentile(latencies, 0.5), Percentile(latencies, 0.99));
+  return 0;
+}
+
+
+/*
+  * Load generator for --serve, connectionCount clients each send requestCount expressions one at a time
+  * and time every round trip
+*/
+int RunLoad(const char *path, int connectionCount, size_t requestCount) {
+  static const char *const corpus[] = {
+    "17*(29+11)-8/2\n", "2*pi^2\n", "(1+2)*3-4/5\n", "3root27+2^0.5\n", "((2+3)*(4-1))^2/7\n", "10/4-2*(3-1)^2\n"
+  };
+  const size_t corpusSize = sizeof(corpus) / sizeof(corpus[0]);
+
+  std::vector<std::vector<double>> latencies(connectionCount);
+  std::vector<std::thread> clients;
+  std::vector<size_t> failures(connectionCount);
+
+  auto start = std::chrono::steady_clock::now();
+
+  for (int client = 0; client < connectionCount; ++client) {
+    clients.emplace_back([&, client] {
+      int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+      sockaddr_un address = {};
+      address.sun_family = AF_UNIX;
+      strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+
+      if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address))) {
+        failures[client] = requestCount;
+        return;
+      }
+
+      char buffer[256];
+      latencies[client].reserve(requestCount);
+
+      for (size_t i = 0; i < requestCount; ++i) {
+        const char *request = corpus[(client + i) % corpusSize];
+        auto sent = std::chrono::steady_clock::now();
+
+        if (write(fd, request, strlen(request)) < 0) {
+          failures[client] += requestCount - i;
+          break;
+        }
+
+        // ? One request is in flight at a time, so the answer is everything up to the newline
+        ssize_t count = 0;
+        size_t received = 0;
+
+        while ((count = read(fd, buffer + received, sizeof(buffer) - received)) > 0) {
+          received += count;
+
+          if (buffer[received - 1] == '\n') break;
+        }
+
+        if (count <= 0) {
+          failures[client] += requestCount - i;
+          break;
+        }
+
+        std::chrono::duration<double, std::micro> latency = std::chrono::steady_clock::now() - sent;
+        latencies[client].push_back(latency.count());
+      }
+
+      close(fd);
+    });
+  }
+
+  for (std::thread &client : clients) {
+    client.join();
+  }
+
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  std::vector<double> all;
+  size_t failed = 0;
+
+  for (int client = 0; client < connectionCount; ++client) {
+    all.insert(all.end(), latencies[client].begin(), latencies[client].end());
+    failed += failures[client];
+  }
+
+  fprintf(stderr, "%zu requests on %d connections in %fs (%.0f requests/s), %zu failed\n", all.size(), connectionCount, elapsed.count(), all.size() / elapsed.count(), failed);
+  fprintf(stderr, "Round trip latency: p50 %.1fus, p99 %.1fus\n", Percentile(all, 0.5), Percentile(all, 0.99));
+  return failed ? 1 : 0;
+}
+#endif
+
+
+int main(int argc, char *argv[]) {
+  // * --batch [file] evaluates one expression per line from the file or stdin
+  // * --bench-stages [file] times every stage over a corpus and prints JSON
+  // * --serve <socket> answers expressions sent to a Unix domain socket, --load <socket> [connections] [requests] benchmarks it
+
+#ifdef HAS_EPOLL
+  if (argc > 2 && std::string(argv[1]) == "--serve") {
+    return RunServer(argv[2]);
+  }
+
+  if (argc > 2 && std::string(argv[1]) == "--load") {
+    int connectionCount = (argc > 3) ? atoi(argv[3]) : 16;
+    size_t requestCount = (argc > 4) ? strtoul(argv[4], nullptr, 10) : 10000;
+    return RunLoad(argv[2], std::max(1, connectionCount), requestCount);
+  }
+#endif
+
+  if (argc > 1 && std::string(argv[1]) == "--bench-stages") {
+    if (argc < 3) {
+      RunStageBenchmark(std::cin);
+      return 0;
+    }
+
+    std::ifstream file(argv[2]);
+
+    if (!file) {
+      fprintf(stderr, "Could not open %s\n", argv[2]);
+      return 1;
+    }
+
+    RunStageBenchmark(file);
+    return 0;
+  }
+
+  if (argc > 1 && std::string(argv[1]) == "--batch") {
+    std::ios::sync_with_stdio(false);
+
+    if (argc < 3) {
+      RunBatch(std::cin);
+      return 0;
+    }
+
+    std::ifstream file(argv[2]);
+
+    if (!file) {
+      fprintf(stderr, "Could not open %s\n", argv[2]);
+      return 1;
+    }
+
+    RunBatch(file);
+    return 0;
+  }
+
   std::string input;
   getline(std::cin, input);
 
@@ -220,7 +845,7 @@ int main() {
 
   // * Tokenise the string
 
-  std::vector<std::string> tokens;
+  TokenList tokens;
   Tokenise(tokens, input);
 
   // * Turning the infix tokens into postfix
@@ -231,7 +856,20 @@ int main() {
     std::cout << token << ", ";
   }
 
-  printf("Result: %.5f\n", EvaluatePostfix(tokens));
+  double result;
+  dividedByZero = false;
+
+  if (!EvaluatePostfix(tokens, result)) {
+    return 1;
+  }
+
+  if (dividedByZero) {
+    std::cerr << "Division by zero!" << '\n';
+  }
+
+  char number[NUMBER_LENGTH];
+
+  printf("Result: %.*s\n", static_cast<int>(FormatNumber(number, result)), number);
 
   return 0;
 }
\ No newline at end of file
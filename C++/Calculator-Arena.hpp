@@ -0,0 +1,115 @@
+/*
+  * Allocation counting and the per-expression arena shared by Calculator-1.cpp and Calculator-2.cpp, header only and C++17.
+  *
+  * Replaces the global operator new and delete, so it has to be included by exactly one source file of a program.
+*/
+#ifndef CALCULATOR_ARENA_HPP
+#define CALCULATOR_ARENA_HPP
+
+#include <cstddef>
+#include <cstdlib>
+#include <memory_resource>
+#include <new>
+#include <vector>
+
+#define ARENA_INITIAL_SIZE (16 << 10)
+
+
+// * Heap allocations made by the current thread, counted by the replaced operator new below
+thread_local size_t heapAllocations = 0;
+
+
+void *operator new(size_t size) {
+  heapAllocations++;
+
+  if (void *pointer = malloc(size ? size : 1)) {
+    return pointer;
+  }
+
+  throw std::bad_alloc();
+}
+
+
+// ? GCC sees through the replaced operator new once allocators are constexpr and warns about pairing it with free
+#ifdef __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void operator delete(void *pointer) noexcept {
+  free(pointer);
+}
+
+
+void operator delete(void *pointer, size_t) noexcept {
+  free(pointer);
+}
+
+#ifdef __GNUC__
+#pragma GCC diagnostic pop
+#endif
+
+
+/*
+  * Bump allocator for the storage of one expression, reset before the next one.
+  * Memory comes from a single block that grows to fit the largest expression seen so far,
+  * so once it has warmed up an expression makes no heap allocations at all.
+*/
+struct Arena : std::pmr::memory_resource {
+  char *block;
+  size_t capacity;
+  size_t used = 0;
+  size_t overflowBytes = 0; // ? Bytes that did not fit in block since the last Reset
+  std::vector<void*> overflow;
+
+  explicit Arena(size_t size = ARENA_INITIAL_SIZE) : block(static_cast<char*>(::operator new(size))), capacity(size) {}
+  Arena(const Arena&) = delete;
+  Arena &operator=(const Arena&) = delete;
+
+  ~Arena() {
+    Reset();
+    ::operator delete(block);
+  }
+
+  // ? Frees everything at once, anything allocated from the arena must be gone by now
+  void Reset() {
+    for (void *pointer : overflow) {
+      ::operator delete(pointer);
+    }
+
+    overflow.clear();
+
+    if (overflowBytes) {
+      capacity = (capacity + overflowBytes) * 2;
+      ::operator delete(block);
+      block = static_cast<char*>(::operator new(capacity));
+      overflowBytes = 0;
+    }
+
+    used = 0;
+  }
+
+private:
+  void *do_allocate(size_t bytes, size_t alignment) override {
+    size_t start = (used + alignment - 1) & ~(alignment - 1);
+
+    if (start + bytes <= capacity) {
+      used = start + bytes;
+      return block + start;
+    }
+
+    // ? operator new already aligns for every type the calculator stores
+    overflowBytes += bytes + alignment;
+    overflow.push_back(::operator new(bytes));
+    return overflow.back();
+  }
+
+  void do_deallocate(void*, size_t, size_t) override {} // ? Reset frees everything at once
+
+  bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+    return this == &other;
+  }
+};
+
+
+#endif
@@ -0,0 +1,1207 @@
+/*
+  * Arbitrary precision decimal numbers for Calculator-1.cpp, header only and C++17.
+  *
+  * A calc::Decimal is mantissa * 10^exponent, with the mantissa stored in base 10^9 limbs.
+  * Every operation rounds its result to a given number of significant digits, half to even,
+  * so sums, differences and products that fit in the precision are exact.
+  * Mantissas of up to 72 digits live inside the Decimal, longer ones go to the heap,
+  * and mantissas of KARATSUBA_LIMBS limbs or more are multiplied with Karatsuba.
+*/
+#ifndef CALCULATOR_DECIMAL_HPP
+#define CALCULATOR_DECIMAL_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#define DECIMAL_INLINE_LIMBS 8
+#define KARATSUBA_LIMBS 32
+#define DECIMAL_GUARD_DIGITS 10
+
+
+namespace calc {
+
+
+namespace internal {
+
+
+constexpr uint32_t LIMB_BASE = 1000000000;
+constexpr int LIMB_DIGITS = 9;
+constexpr uint32_t POWERS_OF_TEN[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000 };
+
+
+/*
+  * Little endian limbs with no leading zero limbs, so zero has none.
+  * The first DECIMAL_INLINE_LIMBS limbs are stored inline and never allocate.
+*/
+struct Limbs {
+  Limbs() = default;
+  Limbs(const Limbs &other) { assign(other.data(), other.count); }
+  Limbs(Limbs &&other) noexcept { take(other); }
+  ~Limbs() { release(); }
+
+  Limbs &operator=(const Limbs &other) {
+    if (this != &other) {
+      assign(other.data(), other.count);
+    }
+
+    return *this;
+  }
+
+  Limbs &operator=(Limbs &&other) noexcept {
+    if (this != &other) {
+      release();
+      take(other);
+    }
+
+    return *this;
+  }
+
+  size_t size() const { return count; }
+  bool empty() const { return !count; }
+  uint32_t *data() { return heap ? heap : local; }
+  const uint32_t *data() const { return heap ? heap : local; }
+  uint32_t &operator[](size_t i) { return data()[i]; }
+  uint32_t operator[](size_t i) const { return data()[i]; }
+  uint32_t back() const { return data()[count - 1]; }
+
+  void reserve(size_t size) {
+    if (size <= capacity) {
+      return;
+    }
+
+    size_t grown = std::max(size, capacity * 2);
+    uint32_t *limbs = new uint32_t[grown];
+    memcpy(limbs, data(), count * sizeof(uint32_t));
+    delete[] heap;
+    heap = limbs;
+    capacity = grown;
+  }
+
+  // ? New limbs are zero
+  void resize(size_t size) {
+    reserve(size);
+
+    if (size > count) {
+      std::fill(data() + count, data() + size, 0);
+    }
+
+    count = size;
+  }
+
+  void push_back(uint32_t limb) {
+    reserve(count + 1);
+    data()[count++] = limb;
+  }
+
+  void clear() { count = 0; }
+
+  void trim() {
+    while (count && !data()[count - 1]) {
+      count--;
+    }
+  }
+
+private:
+  uint32_t local[DECIMAL_INLINE_LIMBS];
+  uint32_t *heap = nullptr;
+  size_t count = 0;
+  size_t capacity = DECIMAL_INLINE_LIMBS;
+
+  void assign(const uint32_t *limbs, size_t size) {
+    count = 0;
+    reserve(size);
+    memcpy(data(), limbs, size * sizeof(uint32_t));
+    count = size;
+  }
+
+  void take(Limbs &other) {
+    if (other.heap) {
+      heap = other.heap;
+      capacity = other.capacity;
+      other.heap = nullptr;
+      other.capacity = DECIMAL_INLINE_LIMBS;
+    } else {
+      memcpy(local, other.local, other.count * sizeof(uint32_t));
+    }
+
+    count = other.count;
+    other.count = 0;
+  }
+
+  void release() {
+    delete[] heap;
+    heap = nullptr;
+    capacity = DECIMAL_INLINE_LIMBS;
+  }
+};
+
+
+inline int CompareMagnitude(const uint32_t *a, size_t aSize, const uint32_t *b, size_t bSize) {
+  if (aSize != bSize) {
+    return aSize < bSize ? -1 : 1;
+  }
+
+  for (size_t i = aSize; i-- > 0;) {
+    if (a[i] != b[i]) {
+      return a[i] < b[i] ? -1 : 1;
+    }
+  }
+
+  return 0;
+}
+
+
+inline int CompareMagnitude(const Limbs &a, const Limbs &b) {
+  return CompareMagnitude(a.data(), a.size(), b.data(), b.size());
+}
+
+
+// * a += b << (shift limbs)
+inline void AddShifted(Limbs &a, const uint32_t *b, size_t bSize, size_t shift) {
+  if (a.size() < bSize + shift) {
+    a.resize(bSize + shift);
+  }
+
+  uint32_t carry = 0;
+  size_t i = 0;
+
+  for (; i < bSize || carry; ++i) {
+    if (shift + i == a.size()) {
+      a.push_back(0);
+    }
+
+    uint32_t sum = a[shift + i] + (i < bSize ? b[i] : 0) + carry;
+    carry = sum >= LIMB_BASE;
+    a[shift + i] = carry ? sum - LIMB_BASE : sum;
+  }
+}
+
+
+// * a -= b, where a is at least b
+inline void SubtractInPlace(Limbs &a, const uint32_t *b, size_t bSize) {
+  uint32_t borrow = 0;
+
+  for (size_t i = 0; i < bSize || borrow; ++i) {
+    uint32_t subtrahend = (i < bSize ? b[i] : 0) + borrow;
+    borrow = a[i] < subtrahend;
+    a[i] = borrow ? a[i] + LIMB_BASE - subtrahend : a[i] - subtrahend;
+  }
+
+  a.trim();
+}
+
+
+// * a = a * multiplier + addend
+inline void MultiplySmall(Limbs &a, uint32_t multiplier, uint32_t addend = 0) {
+  uint64_t carry = addend;
+
+  for (size_t i = 0; i < a.size(); ++i) {
+    uint64_t product = static_cast<uint64_t>(a[i]) * multiplier + carry;
+    a[i] = static_cast<uint32_t>(product % LIMB_BASE);
+    carry = product / LIMB_BASE;
+  }
+
+  if (carry) {
+    a.push_back(static_cast<uint32_t>(carry));
+  }
+
+  a.trim();
+}
+
+
+// * a /= divisor, returns the remainder
+inline uint32_t DivideSmall(Limbs &a, uint32_t divisor) {
+  uint64_t remainder = 0;
+
+  for (size_t i = a.size(); i-- > 0;) {
+    uint64_t current = remainder * LIMB_BASE + a[i];
+    a[i] = static_cast<uint32_t>(current / divisor);
+    remainder = current % divisor;
+  }
+
+  a.trim();
+  return static_cast<uint32_t>(remainder);
+}
+
+
+inline void MultiplySchoolbook(const uint32_t *a, size_t aSize, const uint32_t *b, size_t bSize, uint32_t *result) {
+  std::fill(result, result + aSize + bSize, 0);
+
+  for (size_t i = 0; i < aSize; ++i) {
+    uint64_t carry = 0;
+
+    for (size_t j = 0; j < bSize; ++j) {
+      uint64_t current = result[i + j] + static_cast<uint64_t>(a[i]) * b[j] + carry;
+      result[i + j] = static_cast<uint32_t>(current % LIMB_BASE);
+      carry = current / LIMB_BASE;
+    }
+
+    result[i + bSize] = static_cast<uint32_t>(carry);
+  }
+}
+
+
+inline Limbs Slice(const uint32_t *limbs, size_t size) {
+  Limbs slice;
+  slice.resize(size);
+  std::copy(limbs, limbs + size, slice.data());
+  slice.trim();
+  return slice;
+}
+
+
+/*
+  * result = a * b, splitting both halves at the same limb as long as the shorter one still has KARATSUBA_LIMBS limbs.
+  * (a1 B + a0)(b1 B + b0) = a1 b1 B^2 + ((a0 + a1)(b0 + b1) - a0 b0 - a1 b1) B + a0 b0, three products instead of four.
+*/
+inline void Multiply(const uint32_t *a, size_t aSize, const uint32_t *b, size_t bSize, Limbs &result) {
+  if (aSize < bSize) {
+    std::swap(a, b);
+    std::swap(aSize, bSize);
+  }
+
+  if (bSize < KARATSUBA_LIMBS) {
+    result.clear();
+    result.resize(aSize + bSize);
+
+    if (bSize) {
+      MultiplySchoolbook(a, aSize, b, bSize, result.data());
+    }
+
+    result.trim();
+    return;
+  }
+
+  size_t half = aSize / 2;
+
+  // ? Unbalanced operands, b fits in the low half of a
+  if (bSize <= half) {
+    Limbs low, high;
+    Multiply(a, half, b, bSize, low);
+    Multiply(a + half, aSize - half, b, bSize, high);
+    result = std::move(low);
+    AddShifted(result, high.data(), high.size(), half);
+    result.trim();
+    return;
+  }
+
+  Limbs a0 = Slice(a, half), a1 = Slice(a + half, aSize - half);
+  Limbs b0 = Slice(b, half), b1 = Slice(b + half, bSize - half);
+  Limbs low, high, middle;
+
+  Multiply(a0.data(), a0.size(), b0.data(), b0.size(), low);
+  Multiply(a1.data(), a1.size(), b1.data(), b1.size(), high);
+
+  AddShifted(a0, a1.data(), a1.size(), 0);
+  AddShifted(b0, b1.data(), b1.size(), 0);
+  Multiply(a0.data(), a0.size(), b0.data(), b0.size(), middle);
+  SubtractInPlace(middle, low.data(), low.size());
+  SubtractInPlace(middle, high.data(), high.size());
+
+  result = std::move(low);
+  AddShifted(result, middle.data(), middle.size(), half);
+  AddShifted(result, high.data(), high.size(), half * 2);
+  result.trim();
+}
+
+
+/*
+  * quotient = numerator / divisor with Knuth's algorithm D, returns whether there is a remainder.
+  * divisor must not be zero.
+*/
+inline bool Divide(const Limbs &numerator, const Limbs &divisor, Limbs &quotient) {
+  if (CompareMagnitude(numerator, divisor) < 0) {
+    quotient.clear();
+    return !numerator.empty();
+  }
+
+  if (divisor.size() == 1) {
+    quotient = numerator;
+    return DivideSmall(quotient, divisor[0]) != 0;
+  }
+
+  // ? Scale both so the top limb of the divisor is at least half the base, which keeps every quotient estimate off by at most 2
+  uint32_t scale = static_cast<uint32_t>(LIMB_BASE / (static_cast<uint64_t>(divisor.back()) + 1));
+  Limbs u = numerator, v = divisor;
+  size_t n = v.size();
+
+  MultiplySmall(u, scale);
+  MultiplySmall(v, scale);
+  u.resize(numerator.size() + 1);
+
+  size_t m = u.size() - n - 1;
+  quotient.resize(m + 1);
+
+  for (size_t j = m + 1; j-- > 0;) {
+    uint64_t top = static_cast<uint64_t>(u[j + n]) * LIMB_BASE + u[j + n - 1];
+    uint64_t estimate = top / v[n - 1];
+    uint64_t remainder = top % v[n - 1];
+
+    while (estimate >= LIMB_BASE || estimate * v[n - 2] > remainder * LIMB_BASE + u[j + n - 2]) {
+      estimate--;
+      remainder += v[n - 1];
+
+      if (remainder >= LIMB_BASE) {
+        break;
+      }
+    }
+
+    // ? u[j .. j + n] -= estimate * v
+    uint64_t carry = 0;
+    int64_t borrow = 0;
+
+    for (size_t i = 0; i < n; ++i) {
+      uint64_t product = estimate * v[i] + carry;
+      carry = product / LIMB_BASE;
+      int64_t difference = static_cast<int64_t>(u[i + j]) - static_cast<int64_t>(product % LIMB_BASE) - borrow;
+      borrow = difference < 0;
+      u[i + j] = static_cast<uint32_t>(borrow ? difference + LIMB_BASE : difference);
+    }
+
+    int64_t difference = static_cast<int64_t>(u[j + n]) - static_cast<int64_t>(carry) - borrow;
+
+    // ? The estimate was one too big, add v back
+    if (difference < 0) {
+      estimate--;
+      uint32_t addCarry = 0;
+
+      for (size_t i = 0; i < n; ++i) {
+        uint32_t sum = u[i + j] + v[i] + addCarry;
+        addCarry = sum >= LIMB_BASE;
+        u[i + j] = addCarry ? sum - LIMB_BASE : sum;
+      }
+
+      difference += addCarry;
+    }
+
+    u[j + n] = static_cast<uint32_t>(difference);
+    quotient[j] = static_cast<uint32_t>(estimate);
+  }
+
+  quotient.trim();
+
+  for (size_t i = 0; i < n; ++i) {
+    if (u[i]) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+
+inline int64_t DigitCount(const Limbs &limbs) {
+  if (limbs.empty()) {
+    return 0;
+  }
+
+  int digits = 1;
+
+  while (digits < LIMB_DIGITS && limbs.back() >= POWERS_OF_TEN[digits]) {
+    digits++;
+  }
+
+  return static_cast<int64_t>(limbs.size() - 1) * LIMB_DIGITS + digits;
+}
+
+
+inline void MultiplyPowerOfTen(Limbs &limbs, int64_t power) {
+  if (limbs.empty() || !power) {
+    return;
+  }
+
+  size_t shift = static_cast<size_t>(power / LIMB_DIGITS);
+
+  if (shift) {
+    size_t size = limbs.size();
+    limbs.resize(size + shift);
+    std::copy_backward(limbs.data(), limbs.data() + size, limbs.data() + size + shift);
+    std::fill(limbs.data(), limbs.data() + shift, 0);
+  }
+
+  MultiplySmall(limbs, POWERS_OF_TEN[power % LIMB_DIGITS]);
+}
+
+
+// * limbs /= 10^power, returns the last digit dropped and sets sticky if any digit below it was not zero
+inline uint32_t DividePowerOfTen(Limbs &limbs, int64_t power, bool &sticky) {
+  sticky = false;
+
+  if (power <= 0) {
+    return 0;
+  }
+
+  // ? Whole limbs below the last dropped digit only feed sticky
+  size_t shift = static_cast<size_t>((power - 1) / LIMB_DIGITS);
+
+  for (size_t i = 0; i < std::min(shift, limbs.size()); ++i) {
+    sticky |= limbs[i] != 0;
+  }
+
+  if (shift >= limbs.size()) {
+    limbs.clear();
+    return 0;
+  }
+
+  std::copy(limbs.data() + shift, limbs.data() + limbs.size(), limbs.data());
+  limbs.resize(limbs.size() - shift);
+
+  int rest = static_cast<int>(power - static_cast<int64_t>(shift) * LIMB_DIGITS);
+  sticky |= DivideSmall(limbs, POWERS_OF_TEN[rest - 1]) != 0;
+  return DivideSmall(limbs, 10);
+}
+
+
+} // namespace internal
+
+
+struct Decimal {
+  bool negative = false;
+  internal::Limbs mantissa;
+  int64_t exponent = 0; // ? Value is mantissa * 10^exponent
+
+  bool isZero() const { return mantissa.empty(); }
+
+  // ? Position just above the leading digit, so 10^(adjusted - 1) <= |value| < 10^adjusted
+  int64_t adjusted() const { return exponent + internal::DigitCount(mantissa); }
+};
+
+
+inline Decimal fromInteger(int64_t value) {
+  Decimal result;
+  uint64_t magnitude = value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+
+  result.negative = value < 0;
+
+  while (magnitude) {
+    result.mantissa.push_back(static_cast<uint32_t>(magnitude % internal::LIMB_BASE));
+    magnitude /= internal::LIMB_BASE;
+  }
+
+  return result;
+}
+
+
+// * Rounds value to precision significant digits, half to even
+inline void round(Decimal &value, int precision) {
+  int64_t excess = internal::DigitCount(value.mantissa) - precision;
+
+  if (excess <= 0) {
+    return;
+  }
+
+  bool sticky;
+  uint32_t dropped = internal::DividePowerOfTen(value.mantissa, excess, sticky);
+  value.exponent += excess;
+
+  if (dropped > 5 || (dropped == 5 && (sticky || (!value.mantissa.empty() && value.mantissa[0] & 1)))) {
+    internal::MultiplySmall(value.mantissa, 1, 1);
+
+    // ? 999 rounding up to 1000 grew a digit, which is always a zero
+    if (internal::DigitCount(value.mantissa) > precision) {
+      internal::DivideSmall(value.mantissa, 10);
+      value.exponent++;
+    }
+  }
+
+  if (value.isZero()) {
+    value.negative = false;
+  }
+}
+
+
+// * Parses [-]digits[.digits][e[-]digits], false if anything else is left
+inline bool parse(std::string_view text, int precision, Decimal &value) {
+  size_t i = 0;
+  bool anyDigit = false;
+  uint32_t limb = 0;
+  int limbDigits = 0;
+
+  value = Decimal();
+
+  if (i < text.length() && (text[i] == '-' || text[i] == '+')) {
+    value.negative = text[i++] == '-';
+  }
+
+  // ? Digits gather into one limb at a time, then shift into the mantissa
+  auto flush = [&] {
+    internal::MultiplySmall(value.mantissa, internal::POWERS_OF_TEN[limbDigits], limb);
+    limb = 0;
+    limbDigits = 0;
+  };
+
+  bool seenPoint = false;
+
+  for (; i < text.length(); ++i) {
+    char c = text[i];
+
+    if (c == '.' && !seenPoint) {
+      seenPoint = true;
+      continue;
+    }
+
+    if (c < '0' || c > '9') {
+      break;
+    }
+
+    anyDigit = true;
+    limb = limb * 10 + (c - '0');
+
+    if (seenPoint) {
+      value.exponent--;
+    }
+
+    if (++limbDigits == internal::LIMB_DIGITS) {
+      flush();
+    }
+  }
+
+  if (limbDigits) {
+    flush();
+  }
+
+  if (!anyDigit) {
+    return false;
+  }
+
+  if (i < text.length() && (text[i] == 'e' || text[i] == 'E')) {
+    char *end;
+    std::string exponent(text.substr(i + 1));
+    long long power = strtoll(exponent.c_str(), &end, 10);
+
+    if (exponent.empty() || *end) {
+      return false;
+    }
+
+    value.exponent += power;
+    i = text.length();
+  }
+
+  if (i != text.length()) {
+    return false;
+  }
+
+  round(value, precision);
+
+  if (value.isZero()) {
+    value.negative = false;
+  }
+
+  return true;
+}
+
+
+/*
+  * Formats value in positional notation, or in scientific notation when that would take
+  * more than 40 zeros, without trailing zeros after the decimal point.
+*/
+inline std::string toString(const Decimal &value) {
+  if (value.isZero()) {
+    return "0";
+  }
+
+  Decimal trimmed = value;
+  bool sticky;
+
+  while (trimmed.mantissa[0] % 10 == 0) {
+    internal::DividePowerOfTen(trimmed.mantissa, 1, sticky);
+    trimmed.exponent++;
+  }
+
+  std::string digits;
+  char limb[16];
+
+  for (size_t i = trimmed.mantissa.size(); i-- > 0;) {
+    snprintf(limb, sizeof(limb), i + 1 == trimmed.mantissa.size() ? "%u" : "%09u", trimmed.mantissa[i]);
+    digits += limb;
+  }
+
+  std::string result = trimmed.negative ? "-" : "";
+  int64_t length = static_cast<int64_t>(digits.length());
+  int64_t point = length + trimmed.exponent; // ? Digits before the decimal point
+
+  if (trimmed.exponent >= 0 && trimmed.exponent <= 40) {
+    result += digits;
+    result.append(trimmed.exponent, '0');
+  } else if (point > 0 && trimmed.exponent < 0) {
+    result += digits.substr(0, point);
+    result += '.';
+    result += digits.substr(point);
+  } else if (point <= 0 && point > -40) {
+    result += "0.";
+    result.append(-point, '0');
+    result += digits;
+  } else {
+    result += digits[0];
+
+    if (length > 1) {
+      result += '.';
+      result += digits.substr(1);
+    }
+
+    result += 'e';
+    result += std::to_string(point - 1);
+  }
+
+  return result;
+}
+
+
+inline double toDouble(const Decimal &value) {
+  return strtod(toString(value).c_str(), nullptr);
+}
+
+
+// * Decimal with the 17 significant digits of a finite double
+inline Decimal fromDouble(double number) {
+  char text[32];
+  Decimal value;
+
+  snprintf(text, sizeof(text), "%.17g", number);
+  parse(text, 17, value);
+  return value;
+}
+
+
+inline int compare(const Decimal &a, const Decimal &b) {
+  if (a.negative != b.negative) {
+    return (a.isZero() && b.isZero()) ? 0 : a.negative ? -1 : 1;
+  }
+
+  int sign = a.negative ? -1 : 1;
+
+  if (a.isZero() || b.isZero()) {
+    return a.isZero() ? (b.isZero() ? 0 : -sign) : sign;
+  }
+
+  if (a.adjusted() != b.adjusted()) {
+    return a.adjusted() < b.adjusted() ? -sign : sign;
+  }
+
+  internal::Limbs aMantissa = a.mantissa, bMantissa = b.mantissa;
+  internal::MultiplyPowerOfTen(aMantissa, a.exponent - std::min(a.exponent, b.exponent));
+  internal::MultiplyPowerOfTen(bMantissa, b.exponent - std::min(a.exponent, b.exponent));
+  return internal::CompareMagnitude(aMantissa, bMantissa) * sign;
+}
+
+
+inline Decimal negate(Decimal value) {
+  value.negative = !value.negative && !value.isZero();
+  return value;
+}
+
+
+inline Decimal add(const Decimal &a, const Decimal &b, int precision) {
+  if (a.isZero() || b.isZero()) {
+    Decimal result = a.isZero() ? b : a;
+    round(result, precision);
+    return result;
+  }
+
+  Decimal x = a, y = b;
+
+  // ? Lining up exponents that are far apart would build huge mantissas,
+  // ? a smaller operand entirely below the rounding digit of the larger only matters as a sticky bit
+  if (x.adjusted() < y.adjusted()) {
+    std::swap(x, y);
+  }
+
+  int64_t floor = x.adjusted() - precision - 2;
+
+  if (y.adjusted() < floor) {
+    y.mantissa = fromInteger(1).mantissa;
+    y.exponent = std::min(x.exponent, floor) - 1;
+  }
+
+  int64_t exponent = std::min(x.exponent, y.exponent);
+  internal::MultiplyPowerOfTen(x.mantissa, x.exponent - exponent);
+  internal::MultiplyPowerOfTen(y.mantissa, y.exponent - exponent);
+
+  Decimal result;
+  result.exponent = exponent;
+
+  if (x.negative == y.negative) {
+    result.negative = x.negative;
+    result.mantissa = std::move(x.mantissa);
+    internal::AddShifted(result.mantissa, y.mantissa.data(), y.mantissa.size(), 0);
+  } else if (internal::CompareMagnitude(x.mantissa, y.mantissa) >= 0) {
+    result.negative = x.negative;
+    result.mantissa = std::move(x.mantissa);
+    internal::SubtractInPlace(result.mantissa, y.mantissa.data(), y.mantissa.size());
+  } else {
+    result.negative = y.negative;
+    result.mantissa = std::move(y.mantissa);
+    internal::SubtractInPlace(result.mantissa, x.mantissa.data(), x.mantissa.size());
+  }
+
+  if (result.isZero()) {
+    result.negative = false;
+  }
+
+  round(result, precision);
+  return result;
+}
+
+
+inline Decimal subtract(const Decimal &a, const Decimal &b, int precision) {
+  return add(a, negate(b), precision);
+}
+
+
+inline Decimal multiply(const Decimal &a, const Decimal &b, int precision) {
+  Decimal result;
+
+  if (a.isZero() || b.isZero()) {
+    return result;
+  }
+
+  internal::Multiply(a.mantissa.data(), a.mantissa.size(), b.mantissa.data(), b.mantissa.size(), result.mantissa);
+  result.negative = a.negative != b.negative;
+  result.exponent = a.exponent + b.exponent;
+  round(result, precision);
+  return result;
+}
+
+
+// * result = a / b rounded to precision digits, false on division by zero. result may be a or b
+inline bool divide(const Decimal &a, const Decimal &b, int precision, Decimal &quotient) {
+  if (b.isZero()) {
+    return false;
+  }
+
+  Decimal result;
+
+  if (a.isZero()) {
+    quotient = result;
+    return true;
+  }
+
+  // ? Enough extra digits on a that the quotient has precision + 2, the last one becomes the sticky digit
+  int64_t scale = std::max<int64_t>(0, precision + 2 + internal::DigitCount(b.mantissa) - internal::DigitCount(a.mantissa));
+  internal::Limbs numerator = a.mantissa;
+  internal::MultiplyPowerOfTen(numerator, scale);
+
+  bool inexact = internal::Divide(numerator, b.mantissa, result.mantissa);
+  result.exponent = a.exponent - b.exponent - scale;
+
+  if (inexact) {
+    internal::MultiplySmall(result.mantissa, 10, 1);
+    result.exponent--;
+  }
+
+  result.negative = a.negative != b.negative;
+  round(result, precision);
+  quotient = std::move(result);
+  return true;
+}
+
+
+// * True if value is a whole number, which is then stored in integer when it fits
+inline bool isInteger(const Decimal &value, int64_t &integer) {
+  if (value.isZero()) {
+    integer = 0;
+    return true;
+  }
+
+  if (value.exponent < 0) {
+    internal::Limbs mantissa = value.mantissa;
+    bool sticky;
+
+    if (internal::DividePowerOfTen(mantissa, -value.exponent, sticky) || sticky) {
+      return false;
+    }
+  }
+
+  if (value.adjusted() > 18) {
+    integer = INT64_MAX;
+    return true;
+  }
+
+  Decimal whole = value;
+  bool sticky;
+
+  if (whole.exponent < 0) {
+    internal::DividePowerOfTen(whole.mantissa, -whole.exponent, sticky);
+  } else {
+    internal::MultiplyPowerOfTen(whole.mantissa, whole.exponent);
+  }
+
+  uint64_t magnitude = 0;
+
+  for (size_t i = whole.mantissa.size(); i-- > 0;) {
+    magnitude = magnitude * internal::LIMB_BASE + whole.mantissa[i];
+  }
+
+  integer = value.negative ? -static_cast<int64_t>(magnitude) : static_cast<int64_t>(magnitude);
+  return true;
+}
+
+
+// * Base raised to a whole power by repeated squaring, false for zero to a negative power
+inline bool powerInteger(const Decimal &base, int64_t power, int precision, Decimal &product) {
+  int working = precision + DECIMAL_GUARD_DIGITS;
+  uint64_t remaining = power < 0 ? 0 - static_cast<uint64_t>(power) : static_cast<uint64_t>(power);
+  Decimal square = base;
+  Decimal result = fromInteger(1);
+
+  while (remaining) {
+    if (remaining & 1) {
+      result = multiply(result, square, working);
+    }
+
+    remaining >>= 1;
+
+    if (remaining) {
+      square = multiply(square, square, working);
+    }
+  }
+
+  if (power < 0 && !divide(fromInteger(1), result, working, result)) {
+    return false;
+  }
+
+  round(result, precision);
+  product = std::move(result);
+  return true;
+}
+
+
+// * log10 of a non zero value, as a double even when the value is outside the range of doubles
+inline double log10Estimate(const Decimal &value) {
+  Decimal leading = value;
+  int64_t adjusted = value.adjusted();
+
+  leading.negative = false;
+  round(leading, 17);
+  leading.exponent -= adjusted;
+  return log10(toDouble(leading)) + static_cast<double>(adjusted);
+}
+
+
+// * 10^power for a power that may be far outside the range of doubles
+inline Decimal powerOfTenEstimate(double power) {
+  double whole = std::floor(power);
+  Decimal value = fromDouble(pow(10.0, power - whole));
+  value.exponent += static_cast<int64_t>(whole);
+  return value;
+}
+
+
+/*
+  * e^x, Taylor series on x / 2^k where 2^k brings x under 2^-8, then squared k times.
+  * Every squaring can double the error, so k / 3 more guard digits cover them.
+*/
+inline Decimal exponential(const Decimal &x, int precision) {
+  int squarings = 0;
+
+  if (!x.isZero()) {
+    double magnitude = log10Estimate(x) / log10(2.0);
+    squarings = std::max(0, static_cast<int>(magnitude) + 9);
+  }
+
+  int working = precision + DECIMAL_GUARD_DIGITS + squarings / 3;
+  Decimal reduced = x;
+  Decimal half = fromInteger(5);
+  half.exponent = -1;
+
+  for (int i = 0; i < squarings; ++i) {
+    reduced = multiply(reduced, half, working);
+  }
+
+  Decimal sum = fromInteger(1), term = fromInteger(1), next;
+
+  for (int n = 1; n < 10000; ++n) {
+    term = multiply(term, reduced, working);
+    divide(term, fromInteger(n), working, term);
+
+    if (term.isZero() || term.adjusted() < sum.adjusted() - working) {
+      break;
+    }
+
+    sum = add(sum, term, working);
+  }
+
+  for (int i = 0; i < squarings; ++i) {
+    sum = multiply(sum, sum, working);
+  }
+
+  round(sum, precision);
+  return sum;
+}
+
+
+/*
+  * Natural logarithm of a positive value with Halley's iteration y += 2 (x - e^y) / (x + e^y),
+  * which triples the correct digits of the estimate from doubles every step.
+*/
+inline bool logarithm(const Decimal &x, int precision, Decimal &result) {
+  if (x.isZero() || x.negative) {
+    return false;
+  }
+
+  int working = precision + DECIMAL_GUARD_DIGITS;
+  Decimal y = fromDouble(log10Estimate(x) * log(10.0));
+
+  for (int i = 0; i < 64; ++i) {
+    Decimal power = exponential(y, working);
+    Decimal correction;
+    divide(multiply(fromInteger(2), subtract(x, power, working), working), add(x, power, working), working, correction);
+
+    y = add(y, correction, working);
+
+    if (correction.isZero() || correction.adjusted() < y.adjusted() - working + 2) {
+      break;
+    }
+  }
+
+  round(y, precision);
+  result = y;
+  return true;
+}
+
+
+// * atan(1 / n) = 1/n - 1/(3 n^3) + 1/(5 n^5) - ...
+inline Decimal arctangentInverse(int64_t n, int precision) {
+  Decimal power, term, sum;
+  Decimal square = fromInteger(n * n);
+
+  divide(fromInteger(1), fromInteger(n), precision, power);
+  sum = power;
+
+  for (int64_t k = 1; ; ++k) {
+    divide(power, square, precision, power);
+    divide(power, fromInteger(2 * k + 1), precision, term);
+
+    if (term.isZero() || term.adjusted() < sum.adjusted() - precision) {
+      break;
+    }
+
+    sum = (k & 1) ? subtract(sum, term, precision) : add(sum, term, precision);
+  }
+
+  return sum;
+}
+
+
+// * Machin's formula, pi = 16 atan(1/5) - 4 atan(1/239), with guard digits and remembered for the last precision asked for
+inline const Decimal &piWithGuardDigits(int precision) {
+  thread_local int cachedPrecision = 0;
+  thread_local Decimal cached;
+
+  if (cachedPrecision != precision) {
+    int working = precision + DECIMAL_GUARD_DIGITS;
+    cached = subtract(multiply(fromInteger(16), arctangentInverse(5, working), working),
+      multiply(fromInteger(4), arctangentInverse(239, working), working), working);
+    cachedPrecision = precision;
+  }
+
+  return cached;
+}
+
+
+inline Decimal pi(int precision) {
+  Decimal value = piWithGuardDigits(precision);
+  round(value, precision);
+  return value;
+}
+
+
+inline Decimal tau(int precision) {
+  return multiply(piWithGuardDigits(precision), fromInteger(2), precision);
+}
+
+
+inline Decimal euler(int precision) {
+  thread_local int cachedPrecision = 0;
+  thread_local Decimal cached;
+
+  if (cachedPrecision != precision) {
+    cached = exponential(fromInteger(1), precision);
+    cachedPrecision = precision;
+  }
+
+  return cached;
+}
+
+
+/*
+  * base^power. Whole powers are exact when the result fits in precision digits,
+  * other powers go through exponential and logarithm and need a positive base.
+*/
+inline bool power(const Decimal &base, const Decimal &power, int precision, Decimal &result) {
+  int64_t integer;
+
+  if (isInteger(power, integer) && integer != INT64_MAX) {
+    return powerInteger(base, integer, precision, result);
+  }
+
+  if (base.isZero()) {
+    result = Decimal();
+    return !power.negative;
+  }
+
+  Decimal logBase;
+
+  if (!logarithm(base, precision + DECIMAL_GUARD_DIGITS, logBase)) {
+    return false;
+  }
+
+  result = exponential(multiply(logBase, power, precision + DECIMAL_GUARD_DIGITS), precision);
+  return true;
+}
+
+
+/*
+  * The degree-th root of radicand. Whole degrees use Newton's iteration
+  * x = ((n - 1) x + r / x^(n - 1)) / n from a double estimate, so odd roots of negative numbers work.
+*/
+inline bool root(const Decimal &degree, const Decimal &radicand, int precision, Decimal &result) {
+  int64_t n;
+
+  if (degree.isZero()) {
+    return false;
+  }
+
+  if (!isInteger(degree, n) || n < 1 || n > 1000000) {
+    Decimal inverse;
+    divide(fromInteger(1), degree, precision + DECIMAL_GUARD_DIGITS, inverse);
+    return power(radicand, inverse, precision, result);
+  }
+
+  if (radicand.isZero() || n == 1) {
+    result = radicand;
+    round(result, precision);
+    return true;
+  }
+
+  if (radicand.negative && n % 2 == 0) {
+    return false;
+  }
+
+  int working = precision + DECIMAL_GUARD_DIGITS;
+  Decimal magnitude = radicand;
+  magnitude.negative = false;
+
+  Decimal x = powerOfTenEstimate(log10Estimate(magnitude) / static_cast<double>(n));
+  Decimal degreeValue = fromInteger(n), previous = fromInteger(n - 1);
+
+  for (int i = 0; i < 64; ++i) {
+    Decimal power, quotient, next;
+    powerInteger(x, n - 1, working, power);
+    divide(magnitude, power, working, quotient);
+    divide(add(multiply(previous, x, working), quotient, working), degreeValue, working, next);
+
+    Decimal change = subtract(next, x, working);
+    x = next;
+
+    if (change.isZero() || change.adjusted() < x.adjusted() - working + 2) {
+      break;
+    }
+  }
+
+  round(x, precision);
+
+  // ? Newton lands next to exact roots, which are worth snapping to
+  Decimal check;
+  powerInteger(x, n, working, check);
+
+  if (compare(check, magnitude) != 0 && precision > 2) {
+    Decimal exact = x;
+    round(exact, precision - 2);
+    powerInteger(exact, n, working, check);
+
+    if (compare(check, magnitude) == 0) {
+      x = exact;
+    }
+  }
+
+  x.negative = radicand.negative;
+  result = x;
+  return true;
+}
+
+
+/*
+  * Applies one of the calculator's operators, "a root b" for '$'.
+  * False for a division by zero and for results that are not real numbers.
+*/
+inline bool operate(char operation, const Decimal &a, const Decimal &b, int precision, Decimal &result) {
+  Decimal value;
+  bool success = true;
+
+  switch (operation) {
+    case '+':
+      value = add(a, b, precision);
+      break;
+    case '-':
+      value = subtract(a, b, precision);
+      break;
+    case '*':
+      value = multiply(a, b, precision);
+      break;
+    case '/':
+      success = divide(a, b, precision, value);
+      break;
+    case '^':
+      success = power(a, b, precision, value);
+      break;
+    case '$':
+      success = root(a, b, precision, value);
+      break;
+    default:
+      return false;
+  }
+
+  if (success) {
+    result = std::move(value); // ? result may be a or b
+  }
+
+  return success;
+}
+
+
+/*
+  * Applies the built-in function of Calculator-1.cpp called name to arguments, which holds two values for min and max and one otherwise.
+  * False for results that are not real numbers, and for sin and cos, which have no decimal version.
+*/
+inline bool apply(std::string_view name, const Decimal *arguments, int precision, Decimal &result) {
+  const Decimal &a = arguments[0];
+  Decimal value;
+
+  if (name == "sqrt") {
+    if (!root(fromInteger(2), a, precision, value)) {
+      return false;
+    }
+  } else if (name == "exp") {
+    value = exponential(a, precision);
+  } else if (name == "log") {
+    if (!logarithm(a, precision, value)) {
+      return false;
+    }
+  } else if (name == "abs") {
+    value = a;
+    value.negative = false;
+  } else if (name == "min" || name == "max") {
+    int order = compare(a, arguments[1]);
+    value = ((name == "min") ? order < 0 : order > 0) ? a : arguments[1];
+  } else {
+    return false;
+  }
+
+  result = std::move(value); // ? result may be one of the arguments
+  return true;
+}
+
+
+} // namespace calc
+
+
+#endif
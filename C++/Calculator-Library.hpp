@@ -0,0 +1,1280 @@
+/*
+  * The evaluation engine of Calculator-1.cpp as a header only C++17 library.
+  *
+  * calc::compile turns an expression into a calc::Program, calc::evaluate runs one.
+  * Both report failures as a calc::Error holding an error code and the offset of the offending character
+  * in the expression as given, and neither writes to stdio or keeps global state.
+  * A compiled program is never modified by evaluate, so any number of threads can evaluate it at once.
+  *
+  * Below them are the stages Calculator-1.cpp drives one by one: CleanString, Tokenise, InfixToPostfix,
+  * CompilePostfix, OptimizeProgram and RunProgram, with the arithmetic they share. Calculator-1.cpp is a client
+  * of this header like any other program, its fused evaluator, column kernels and native code build on these pieces.
+*/
+#ifndef CALCULATOR_LIBRARY_HPP
+#define CALCULATOR_LIBRARY_HPP
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// ? Instrumentation hooks, empty unless the program defines them before including this header
+#ifndef CALC_STATS_TIMER
+#define CALC_STATS_TIMER(stage)
+#endif
+#ifndef CALC_STATS_TOKENS
+#define CALC_STATS_TOKENS(count)
+#endif
+#ifndef CALC_STATS_OPERATOR_STACK
+#define CALC_STATS_OPERATOR_STACK(depth)
+#endif
+#ifndef CALC_STATS_VALUE_STACK
+#define CALC_STATS_VALUE_STACK(depth)
+#endif
+#ifndef CALC_STATS_ERROR
+#define CALC_STATS_ERROR(kind)
+#endif
+
+#ifndef LANE_INLINE
+#define LANE_INLINE inline // ? Calculator-1.cpp forces inlining, so its SIMD kernels get the fast functions compiled for their own instruction set
+#endif
+
+#define MAX_POWER_CHAIN 3 // ? x^2 and x^3 are within 1 ulp of pow, x^4 is already 2 ulps off and x^16 12, --check-optimizer holds the optimizer to 1
+
+
+namespace calc {
+
+
+enum class ErrorCode {
+  None,
+  EmptyExpression,
+  UnexpectedCharacter, // ? Anything but whitespace that CleanString would silently drop
+  InvalidNumber,
+  MissingOperand,
+  MissingOperator, // ? Two operands with nothing to combine them
+  UnbalancedParenthesis,
+  UnknownVariable, // ? A variable that evaluate was not given a value for
+  DivisionByZero,
+  UnexpectedComma, // ? A ',' outside of the parentheses of a call
+  ArgumentCount // ? A call with more or fewer arguments than its function takes
+};
+
+
+struct Error {
+  ErrorCode code = ErrorCode::None;
+  size_t position = 0; // ? Offset into the expression as given, whitespace included
+
+  explicit operator bool() const { return code != ErrorCode::None; }
+};
+
+
+inline const char *message(ErrorCode code) {
+  switch (code) {
+    case ErrorCode::None: return "no error";
+    case ErrorCode::EmptyExpression: return "empty expression";
+    case ErrorCode::UnexpectedCharacter: return "unexpected character";
+    case ErrorCode::InvalidNumber: return "invalid number";
+    case ErrorCode::MissingOperand: return "missing operand";
+    case ErrorCode::MissingOperator: return "missing operator";
+    case ErrorCode::UnbalancedParenthesis: return "unbalanced parenthesis";
+    case ErrorCode::UnknownVariable: return "unknown variable";
+    case ErrorCode::DivisionByZero: return "division by zero";
+    case ErrorCode::UnexpectedComma: return "unexpected comma";
+    case ErrorCode::ArgumentCount: return "wrong number of arguments";
+  }
+
+  return "unknown error";
+}
+
+
+struct Options {
+  bool integers = true; // ? Integer literals stay exact int64 while the arithmetic on them does, off makes every number a double
+  bool fastFunctions = false; // ? exp, log, sin and cos use the polynomials of the fast tier instead of libm
+  bool optimize = true; // ? Only read by compile, which runs OptimizeProgram when it is set
+};
+
+
+using TokenList = std::pmr::vector<std::string_view>;
+using ValueStack = std::pmr::vector<double>;
+
+
+inline bool StrIsDigit(std::string_view input) {
+  if (input.empty()) {
+    return false;
+  }
+
+  int dotCount = 0;
+  bool hasDigit = false;
+
+  for (char c : input) {
+    if (c == '.') {
+      dotCount++;
+
+      if (dotCount > 1) {
+        return false;
+      }
+    } else if (isdigit(c)) {
+      hasDigit = true;
+    } else if (c != '-') {
+      return false;
+    }
+  }
+
+  return hasDigit; // ? A lone "-" is the subtraction operator, not a number
+}
+
+
+inline bool IsOperator(char inputChar = ' ') {
+  return inputChar == '+' || inputChar == '-' || inputChar == '*' || inputChar == '/' || inputChar == '^' || inputChar == '.' || inputChar == '$';
+}
+
+
+// * Checks if inputChar can start or continue a constant or variable name
+inline bool IsNameChar(char inputChar) {
+  return isalnum(inputChar) || inputChar == '_';
+}
+
+
+inline bool IsIdentifier(std::string_view input) {
+  return !input.empty() && (isalpha(input[0]) || input[0] == '_');
+}
+
+
+inline bool IsValid(char input) {
+  return (
+    isdigit(input) || IsOperator(input) ||
+    IsNameChar(input) ||
+    input == '(' || input == ')' || input == ','
+  );
+}
+
+
+// * Returns the value of the constant called name, or nullptr if name is a variable
+inline const char *ConstantValue(std::string_view name) {
+  if (name == "e") return "2.7182818284";
+  if (name == "pi") return "3.1415926535";
+  if (name == "tau") return "6.2831853071";
+  return nullptr;
+}
+
+
+// * Returns how many arguments the built-in function called name takes, or 0 if there is no such function
+inline int FunctionArity(std::string_view name) {
+  if (name == "sqrt" || name == "exp" || name == "log" || name == "sin" || name == "cos" || name == "abs") return 1;
+  if (name == "min" || name == "max") return 2;
+  return 0;
+}
+
+
+// * Checks if a '-' after previous is the sign of a number rather than a subtraction
+inline bool StartsOperand(char previous) {
+  return IsOperator(previous) || previous == '(' || previous == ',';
+}
+
+
+/*
+  * Removes whitespaces and unknown characters from data in place and returns the new length.
+  * Nothing is written before the first removed character, so clean input is never touched.
+*/
+inline size_t CleanRange(char *data, size_t length) {
+  CALC_STATS_TIMER(Clean);
+  size_t index = 0;
+
+  while (index < length && IsValid(data[index])) {
+    index++;
+  }
+
+  for (size_t i = index; i < length; ++i) {
+    if (IsValid(data[i])) {
+      data[index++] = data[i];
+    }
+  }
+
+  return index;
+}
+
+
+// * Removes whitespaces from a string
+inline void CleanString(std::string &inputString) {
+  inputString.resize(CleanRange(inputString.data(), inputString.length()));
+}
+
+
+/*
+  * Tokenise the input string
+  * Tokens are slices of input or of static strings, so input has to outlive them.
+*/
+inline void Tokenise(TokenList &tokens, std::string_view input) {
+  CALC_STATS_TIMER(Tokenise);
+  size_t tokenStart = 0; // ? Start of the number being read, the number spans up to i
+  bool inToken = false;
+  [[maybe_unused]] size_t firstToken = tokens.size(); // ? Callers may append to a list that already holds tokens
+
+  for (size_t i = 0; i <= input.length(); ++i) {
+    char currentChar = (i < input.length()) ? input[i] : '\0';
+
+    // ? Checks if the - means substract or negative.
+    // ? Checks if current char is a digit or a '.'
+    if ((currentChar == '-' && (!i || StartsOperand(input[i - 1]))) || isdigit(currentChar) || currentChar == '.') {
+      if (!inToken) {
+        tokenStart = i;
+        inToken = true;
+      }
+
+      continue;
+    }
+
+    std::string_view currentToken = inToken ? input.substr(tokenStart, i - tokenStart) : std::string_view();
+    inToken = false;
+
+    //? Checks if current char starts a name, which is either pi, e, tau, root or a variable
+    if (isalpha(currentChar) || currentChar == '_') {
+      // ? "a root b" is the a-th root of b, $ is the character that is used to replace "root"
+      if (input.compare(i, 4, "root") == 0 && (i + 4 == input.length() || (!isalpha(input[i + 4]) && input[i + 4] != '_'))) {
+        if (!currentToken.empty()) {
+          tokens.push_back(currentToken);
+        }
+
+        tokens.push_back("$");
+        i += 3;
+        continue;
+      }
+
+      size_t end = i;
+
+      while (end < input.length() && IsNameChar(input[end])) {
+        end++;
+      }
+
+      // ? A number right before a name multiplies it, a lone '-' negates it
+      if (currentToken == "-") {
+        tokens.push_back("-1");
+        tokens.push_back("*");
+      } else if (!currentToken.empty()) {
+        tokens.push_back(currentToken);
+        tokens.push_back("*");
+      }
+
+      std::string_view name = input.substr(i, end - i);
+      const char *constant = ConstantValue(name);
+      tokens.push_back(constant ? std::string_view(constant) : name);
+
+      i = end - 1;
+      continue;
+    }
+
+    // ? If current char is an operator, then it means that the previous digits are complete
+    if (!currentToken.empty()) {
+      tokens.push_back(currentToken);
+    }
+
+    // ? Avoid pushing an empty token for the end of the string
+    if (currentChar != '\0') {
+      tokens.push_back(input.substr(i, 1));
+    }
+  }
+
+  CALC_STATS_TOKENS(tokens.size() - firstToken);
+}
+
+
+inline int Precedence(std::string_view operation) {
+  if (operation == "+" || operation == "-") return 1;
+  if (operation == "*" || operation == "/") return 2;
+  if (operation == "^" || operation == "$") return 3; // ? Assuming ^ and root have the highest precedence
+  return 0; // ? Default for unsupported operators
+}
+
+
+/*
+  * Applies the shunting yard algorithm to converts infix to postfix notation
+  * https://en.wikipedia.org/wiki/Shunting_yard_algorithm#The_algorithm_in_detail
+  * A function call reaches the output as its name with the opening parenthesis, "sin(", so variables can still be called sin.
+  * A ',' outside of a call, or a call with the wrong number of arguments, is left in the output where no evaluator accepts it.
+*/
+inline void InfixToPostfix(TokenList &input) {
+  CALC_STATS_TIMER(Postfix);
+  TokenList output(input.get_allocator()), stack(input.get_allocator());
+  std::pmr::vector<int> arguments(input.get_allocator()); // ? Commas seen so far for every open parenthesis, -1 when it is not a call
+
+  output.reserve(input.size());
+  stack.reserve(input.size());
+
+  for (size_t i = 0; i < input.size(); ++i) {
+    std::string_view token = input[i];
+
+    // ? A function name directly followed by its parenthesis opens a call
+    if (IsIdentifier(token) && FunctionArity(token) && i + 1 < input.size() && input[i + 1] == "(" && input[i + 1].data() == token.data() + token.length()) {
+      stack.push_back(std::string_view(token.data(), token.length() + 1));
+      arguments.push_back(0);
+      CALC_STATS_OPERATOR_STACK(stack.size());
+      i++;
+      continue;
+    }
+
+    // ? If token is a digit or a variable, push it to output.
+    if (StrIsDigit(token) || IsIdentifier(token)) {
+      output.push_back(token);
+      continue;
+    }
+
+    // ? A malformed number like "2.52.5" goes to the output as well, where compiling rejects it
+    if (!IsOperator(token[0]) && token != "(" && token != ")" && token != ",") {
+      output.push_back(token);
+      continue;
+    }
+
+    // ? If token is operator, push it to stack
+    if (IsOperator(token[0])) {      
+      while (!stack.empty() && Precedence(stack.back()) >= Precedence(token)) {
+        output.push_back(stack.back());
+        stack.pop_back();
+      }
+
+      stack.push_back(token);
+      CALC_STATS_OPERATOR_STACK(stack.size());
+    }
+
+    if (token == "(") {
+      stack.push_back(token);
+      arguments.push_back(-1);
+      CALC_STATS_OPERATOR_STACK(stack.size());
+      continue;
+    }
+
+    if (token == ")" || token == ",") {
+      while (!stack.empty() && stack.back().back() != '(') {
+        output.push_back(stack.back());
+        stack.pop_back();
+      }
+
+      if (stack.empty() || (token == "," && arguments.back() < 0)) {
+        if (token == ",") {
+          output.push_back(token);
+        }
+
+        continue;
+      }
+
+      if (token == ",") {
+        arguments.back()++;
+        continue;
+      }
+
+      // ? Pop the left parenthesis from the stack, a call goes to the output with it
+      if (stack.back() != "(") {
+        output.push_back(stack.back());
+
+        if (arguments.back() + 1 != FunctionArity(stack.back().substr(0, stack.back().length() - 1))) {
+          output.push_back(token);
+        }
+      }
+
+      stack.pop_back();
+      arguments.pop_back();
+    }
+  }
+
+  // ? Unclosed calls leave their parenthesis behind as well
+  while (!stack.empty()) {
+    output.push_back(stack.back().back() == '(' ? stack.back().substr(stack.back().length() - 1) : stack.back());
+    stack.pop_back();
+  }
+
+  input.swap(output);
+}
+
+
+/*
+  * Reads the longest number at the start of [first, last) with from_chars, and returns where it ends, or first if there is none.
+  * Rounds like strtod, which it also takes a leading '+' from, but it skips no whitespace and reads no hexadecimal.
+*/
+inline const char *ReadNumber(const char *first, const char *last, double &value) {
+  const char *start = first + (last - first > 1 && *first == '+' && first[1] != '-');
+  std::from_chars_result read = std::from_chars(start, last, value);
+
+  if (read.ec == std::errc::result_out_of_range) {
+    value = strtod(std::string(start, read.ptr).c_str(), nullptr); // ? from_chars leaves value alone, strtod gives infinity or zero
+  } else if (read.ec != std::errc()) {
+    return first;
+  }
+
+  return read.ptr;
+}
+
+
+// * Parses a whole number token, false if from_chars leaves any of it over, like in "--5" or "5.-3"
+inline bool ParseNumber(std::string_view token, double &value) {
+  const char *end = token.data() + token.length();
+  return !token.empty() && ReadNumber(token.data(), end, value) == end;
+}
+
+
+// * Binary operator or min and max on doubles, a division by zero gives what IEEE 754 does and is for the caller to report
+inline double PerformOperation(double a, double b, char operation) {
+  switch (operation) {
+    case '*':
+      return a * b;
+    case '/':
+      return a / b;
+    case '+':
+      return a + b;
+    case '-':
+      return a - b;
+    case '^':
+      return pow(a, b);
+    case '$':
+      return pow(b, (1 / a));
+    case 'm': // ? min and max give b when either is NaN, like the minpd and maxpd the SIMD kernels use
+      return a < b ? a : b;
+    case 'M':
+      return a > b ? a : b;
+  }
+
+  return NAN;
+}
+
+
+// * a + b, a - b and a * b on int64, false instead of overflowing
+inline bool CheckedAdd(int64_t a, int64_t b, int64_t &result) {
+  if (b > 0 ? a > INT64_MAX - b : a < INT64_MIN - b) {
+    return false;
+  }
+
+  result = a + b;
+  return true;
+}
+
+
+inline bool CheckedSubtract(int64_t a, int64_t b, int64_t &result) {
+  if (b > 0 ? a < INT64_MIN + b : a > INT64_MAX + b) {
+    return false;
+  }
+
+  result = a - b;
+  return true;
+}
+
+
+inline bool CheckedMultiply(int64_t a, int64_t b, int64_t &result) {
+  if (a > 0 ? (b > 0 ? a > INT64_MAX / b : b < INT64_MIN / a) : (b > 0 ? a < INT64_MIN / b : a && b < INT64_MAX / a)) {
+    return false;
+  }
+
+  result = a * b;
+  return true;
+}
+
+
+/*
+  * PerformOperation on integers, with ^ as exponentiation by squaring.
+  * Returns false when the result is not an exact int64, that is on overflow, a division with a remainder or by zero,
+  * a negative exponent and every root, which leaves the operation to PerformOperation on doubles.
+*/
+inline bool PerformIntegerOperation(int64_t a, int64_t b, char operation, int64_t &result) {
+  switch (operation) {
+    case '+':
+      return CheckedAdd(a, b, result);
+    case '-':
+      return CheckedSubtract(a, b, result);
+    case '*':
+      return CheckedMultiply(a, b, result);
+    case '/':
+      if (!b || (a == INT64_MIN && b == -1) || a % b) {
+        return false;
+      }
+
+      result = a / b;
+      return true;
+    case '^':
+      if (b < 0) {
+        return false;
+      }
+
+      for (result = 1; b; b >>= 1) {
+        if ((b & 1) && !CheckedMultiply(result, a, result)) {
+          return false;
+        }
+
+        if (b > 1 && !CheckedMultiply(a, a, a)) {
+          return false;
+        }
+      }
+
+      return true;
+    case 'm':
+      result = std::min(a, b);
+      return true;
+    case 'M':
+      result = std::max(a, b);
+      return true;
+  }
+
+  return false;
+}
+
+
+/*
+  * Number that keeps the int64 it came from while integer arithmetic on it stays exact.
+  * value always holds it as a double, and is all that is left once isInteger is false.
+*/
+struct ExactValue {
+  double value = 0;
+  int64_t integer = 0;
+  bool isInteger = false;
+};
+
+
+// * ParseNumber, keeping the exact value of tokens that are whole numbers within int64 unless integers is off
+inline bool ParseExactNumber(std::string_view token, ExactValue &number, bool integers = true) {
+  std::from_chars_result read = std::from_chars(token.data(), token.data() + token.length(), number.integer);
+
+  number.isInteger = integers && read.ec == std::errc() && read.ptr == token.data() + token.length();
+
+  if (number.isInteger) {
+    number.value = static_cast<double>(number.integer);
+    return true;
+  }
+
+  return ParseNumber(token, number.value);
+}
+
+
+// * ParseExactNumber for literals that are known to be well formed, like the constants
+inline ExactValue ParseExactNumber(std::string_view token, bool integers = true) {
+  ExactValue number;
+  ParseExactNumber(token, number, integers);
+  return number;
+}
+
+
+// * Stays an integer only if both operands are and PerformIntegerOperation is exact, otherwise promotes both to double
+inline ExactValue PerformExactOperation(const ExactValue &a, const ExactValue &b, char operation) {
+  ExactValue result;
+
+  if (a.isInteger && b.isInteger && PerformIntegerOperation(a.integer, b.integer, operation, result.integer)) {
+    result.value = static_cast<double>(result.integer);
+    result.isInteger = true;
+  } else {
+    result.value = PerformOperation(a.value, b.value, operation);
+  }
+
+  return result;
+}
+
+
+/*
+  * Instruction set of a compiled program.
+  * Operators share their character so they can be handed straight to PerformOperation.
+*/
+enum class OpCode : char {
+  Push = '\0',
+  Load = '\1',
+  Add = '+',
+  Subtract = '-',
+  Multiply = '*',
+  Divide = '/',
+  Power = '^',
+  Root = '$',
+  Minimum = 'm', // ? Built-in functions, the ones below Maximum take one operand
+  Maximum = 'M',
+  SquareRoot = 's',
+  Absolute = 'a',
+  Exponential = 'e',
+  Logarithm = 'l',
+  Sine = 'S',
+  Cosine = 'C',
+  PowerInt = 'i' // ? Only comes out of OptimizeProgram
+};
+
+
+struct Instruction {
+  OpCode opCode;
+  int slot; // ? Index into Program::variables for OpCode::Load, exponent for OpCode::PowerInt, unused otherwise
+  double value; // ? Pre-parsed literal for OpCode::Push, unused otherwise
+};
+
+
+inline bool IsUnary(OpCode opCode) {
+  return (
+    opCode == OpCode::SquareRoot || opCode == OpCode::Absolute || opCode == OpCode::Exponential ||
+    opCode == OpCode::Logarithm || opCode == OpCode::Sine || opCode == OpCode::Cosine ||
+    opCode == OpCode::PowerInt
+  );
+}
+
+
+// * OpCode of the built-in function called name, which FunctionArity has to know
+inline OpCode FunctionOpCode(std::string_view name) {
+  if (name == "sqrt") return OpCode::SquareRoot;
+  if (name == "abs") return OpCode::Absolute;
+  if (name == "exp") return OpCode::Exponential;
+  if (name == "log") return OpCode::Logarithm;
+  if (name == "sin") return OpCode::Sine;
+  if (name == "cos") return OpCode::Cosine;
+  return name == "min" ? OpCode::Minimum : OpCode::Maximum;
+}
+
+
+// * Raises base to a non-negative integer power with a chain of multiplications
+inline double PowerBySquaring(double base, int exponent) {
+  double result = 1;
+
+  while (exponent) {
+    if (exponent & 1) {
+      result *= base;
+    }
+
+    base *= base;
+    exponent >>= 1;
+  }
+
+  return result;
+}
+
+
+/*
+  * What the fast functions need from a double or from a vector of doubles, so one template serves RunProgram and the SIMD kernels.
+  * Bits holds the lanes as unsigned integers, and masks are Bits with every bit of a lane set or clear.
+  * Only double is specialised here, Calculator-1.cpp adds the vectors of its SSE2 and AVX2 kernels.
+*/
+template <typename V> struct LaneMath;
+
+
+template <> struct LaneMath<double> {
+  typedef uint64_t Bits;
+
+  static LANE_INLINE double Splat(double value) { return value; }
+  static LANE_INLINE Bits Less(double a, double b) { return a < b ? ~Bits(0) : 0; }
+  static LANE_INLINE Bits Equal(double a, double b) { return a == b ? ~Bits(0) : 0; }
+  static LANE_INLINE bool Any(Bits mask) { return mask != 0; }
+
+  static LANE_INLINE Bits ToBits(double x) {
+    Bits bits;
+    memcpy(&bits, &x, sizeof(bits));
+    return bits;
+  }
+
+  static LANE_INLINE double FromBits(Bits bits) {
+    double x;
+    memcpy(&x, &bits, sizeof(x));
+    return x;
+  }
+
+  template <typename Function> static LANE_INLINE double Map(double x, Function function) { return function(x); }
+};
+
+
+// * a where mask is set and b elsewhere
+template <typename V>
+LANE_INLINE V Select(const typename LaneMath<V>::Bits &mask, const V &a, const V &b) {
+  typedef LaneMath<V> L;
+  return L::FromBits((L::ToBits(a) & mask) | (L::ToBits(b) & ~mask));
+}
+
+
+// * Evaluates the polynomial with the given coefficients, highest power first
+template <typename V, size_t count>
+LANE_INLINE V Horner(const V &x, const double (&coefficients)[count]) {
+  V result = LaneMath<V>::Splat(coefficients[0]);
+
+  for (size_t i = 1; i < count; ++i) {
+    result = result * x + coefficients[i];
+  }
+
+  return result;
+}
+
+
+// * 2^k for integral k from -1022 to 1023, built straight into the exponent bits
+template <typename V>
+LANE_INLINE V PowerOfTwo(const V &k) {
+  typedef LaneMath<V> L;
+  return L::FromBits((L::ToBits(k + 0x1.8p52) + 1023) << 52);
+}
+
+
+/*
+  * Fast tier of the built-in functions, written once for a double and for the SIMD vectors.
+  * Nothing is fused into an FMA, so the vector lanes match the scalar results bit for bit.
+  * Adding 0x1.8p52 rounds to an integer and leaves it in the low bits of the sum, which is how they split off exponents and quadrants.
+  * Errors against the correctly rounded result, as measured by --bench-functions, are in the comment of each function.
+*/
+
+// ? Within 1 ulp. exp(r) with |r| <= ln 2 / 2 is a degree 13 Taylor polynomial, scaled by 2^k in two steps so results near the ends of the range keep their bits
+template <typename V>
+LANE_INLINE V FastExp(const V &argument) {
+  typedef LaneMath<V> L;
+  static const double coefficients[] = {
+    1.0 / 6227020800, 1.0 / 479001600, 1.0 / 39916800, 1.0 / 3628800, 1.0 / 362880, 1.0 / 40320,
+    1.0 / 5040, 1.0 / 720, 1.0 / 120, 1.0 / 24, 1.0 / 6, 1.0 / 2
+  };
+
+  // ? Beyond these the result is infinite or zero anyway, NaN lanes are left as they are
+  V x = Select(L::Less(L::Splat(710), argument), L::Splat(710), argument);
+  x = Select(L::Less(x, L::Splat(-746)), L::Splat(-746), x);
+
+  V k = (x * 0x1.71547652b82fep0 + 0x1.8p52) - 0x1.8p52; // ? Nearest integer to x / ln 2
+  V r = (x - k * 0x1.62e42feep-1) - k * 0x1.a39ef35793c76p-33; // ? ln 2 in two parts, k times the first one is exact
+  V half = (k * 0.5 + 0x1.8p52) - 0x1.8p52;
+
+  return (1 + (r + r * r * Horner(r, coefficients))) * PowerOfTwo(half) * PowerOfTwo(k - half);
+}
+
+
+// ? Within 1 ulp. log(1 + f) = 2 atanh(s) with s = f / (2 + f) and the mantissa brought to [sqrt(2) / 2, sqrt(2)], the series from fdlibm
+template <typename V>
+LANE_INLINE V FastLog(const V &x) {
+  typedef LaneMath<V> L;
+  typedef typename L::Bits Bits;
+  static const double coefficients[] = {
+    1.479819860511658591e-01, 1.531383769920937332e-01, 1.818357216161805012e-01, 2.222219843214978396e-01,
+    2.857142874366239149e-01, 3.999999999940941908e-01, 6.666666666666735130e-01
+  };
+
+  Bits subnormal = L::Less(x, L::Splat(0x1p-1022));
+  Bits bits = L::ToBits(Select(subnormal, x * 0x1p54, x));
+  V exponent = (L::FromBits((bits >> 52) | 0x4330000000000000) - (0x1p52 + 1023)) - Select(subnormal, L::Splat(54), L::Splat(0));
+  V mantissa = L::FromBits((bits & 0x000FFFFFFFFFFFFF) | 0x3FF0000000000000);
+  Bits large = L::Less(L::Splat(0x1.6a09e667f3bcdp0), mantissa);
+
+  mantissa = Select(large, mantissa * 0.5, mantissa);
+  exponent = exponent + Select(large, L::Splat(1), L::Splat(0));
+
+  V f = mantissa - 1;
+  V s = f / (2 + f);
+  V z = s * s;
+  V halfSquare = 0.5 * f * f;
+  V result = exponent * 0x1.62e42feep-1 - ((halfSquare - (s * (halfSquare + z * Horner(z, coefficients)) + exponent * 0x1.a39ef35793c76p-33)) - f);
+
+  // ? Negative arguments give the NaN x86 makes for invalid operations, as libm's log does
+  result = Select(L::Equal(x, L::Splat(0)), L::Splat(-HUGE_VAL), result);
+  result = Select(L::Less(x, L::Splat(0)), L::Splat(-NAN), result);
+  return Select(L::Equal(x, L::Splat(HUGE_VAL)) | ~L::Equal(x, x), x, result);
+}
+
+
+/*
+  * sin(x + offset * pi / 2) for |x| <= 2^20, the fdlibm kernels on x less the nearest multiple of pi / 2.
+  * pi / 2 is split in parts short enough that the multiple of each is exact below 2^20.
+*/
+template <typename V>
+LANE_INLINE V SineQuadrant(const V &x, uint64_t offset) {
+  typedef LaneMath<V> L;
+  static const double sineCoefficients[] = {
+    1.58969099521155010221e-10, -2.50507602534068634195e-08, 2.75573137070700676789e-06,
+    -1.98412698298579493134e-04, 8.33333333332248946124e-03, -1.66666666666666324348e-01
+  };
+  static const double cosineCoefficients[] = {
+    -1.13596475577881948265e-11, 2.08757232129817482790e-09, -2.75573143513906633035e-07,
+    2.48015872894767294178e-05, -1.38888888888741095749e-03, 4.16666666666666019037e-02
+  };
+
+  V shifted = x * 0x1.45f306dc9c883p-1 + 0x1.8p52;
+  V q = shifted - 0x1.8p52; // ? Nearest integer to x / (pi / 2)
+  V r = (((x - q * 1.57079632673412561417e+00) - q * 6.07710050630396597660e-11) - q * 2.02226624871116645580e-21) - q * 8.47842766036889956997e-32;
+  V z = r * r;
+  V sine = r + z * r * Horner(z, sineCoefficients);
+  V halfZ = 0.5 * z;
+  V w = 1 - halfZ;
+  V cosine = w + (((1 - w) - halfZ) + z * z * Horner(z, cosineCoefficients));
+
+  typename L::Bits quadrant = L::ToBits(shifted) + offset;
+  V result = Select(-(quadrant & 1), cosine, sine);
+  return L::FromBits(L::ToBits(result) ^ ((quadrant & 2) << 62));
+}
+
+
+// ? Within 2 ulps for |x| <= 2^20 and 1 ulp for small x, vectors with any lane beyond that, infinite or NaN go to libm lane by lane
+template <typename V>
+LANE_INLINE V FastSine(const V &x) {
+  typedef LaneMath<V> L;
+
+  if (L::Any(~L::Less(L::FromBits(L::ToBits(x) & 0x7FFFFFFFFFFFFFFF), L::Splat(0x1p20)))) {
+    return L::Map(x, [](double a) { return sin(a); });
+  }
+
+  return SineQuadrant(x, 0);
+}
+
+
+// ? Same bounds as FastSine
+template <typename V>
+LANE_INLINE V FastCosine(const V &x) {
+  typedef LaneMath<V> L;
+
+  if (L::Any(~L::Less(L::FromBits(L::ToBits(x) & 0x7FFFFFFFFFFFFFFF), L::Splat(0x1p20)))) {
+    return L::Map(x, [](double a) { return cos(a); });
+  }
+
+  return SineQuadrant(x, 1);
+}
+
+
+// * Built-in function of one argument, with function being the OpCode and fast picking the fast tier over libm
+inline double PerformFunction(double a, char function, bool fast = false) {
+  switch (static_cast<OpCode>(function)) {
+    case OpCode::SquareRoot:
+      return sqrt(a);
+    case OpCode::Absolute:
+      return fabs(a);
+    case OpCode::Exponential:
+      return fast ? FastExp(a) : exp(a);
+    case OpCode::Logarithm:
+      return fast ? FastLog(a) : log(a);
+    case OpCode::Sine:
+      return fast ? FastSine(a) : sin(a);
+    case OpCode::Cosine:
+      return fast ? FastCosine(a) : cos(a);
+    default:
+      return NAN;
+  }
+}
+
+
+inline double PerformUnaryOperation(double a, const Instruction &instruction, bool fast = false) {
+  if (instruction.opCode == OpCode::PowerInt) {
+    return PowerBySquaring(a, instruction.slot);
+  }
+
+  return PerformFunction(a, static_cast<char>(instruction.opCode), fast);
+}
+
+
+struct Program {
+  std::vector<Instruction> code;
+  std::vector<std::string> variables; // ? Names of the variables, in the order RunProgram expects their values
+  std::vector<size_t> positions; // ? Offset in the text of every instruction, only kept when CompilePostfix is given the text
+  int maxDepth = 0; // ? Deepest the value stack gets while running the program
+  bool fastFunctions = false; // ? Options::fastFunctions it was compiled with
+
+  // ? Index of the variable called name, or -1
+  int slot(std::string_view name) const {
+    auto found = std::find(variables.begin(), variables.end(), name);
+    return (found == variables.end()) ? -1 : static_cast<int>(found - variables.begin());
+  }
+};
+
+
+/*
+  * Compiles postfix tokens into a flat program with pre-parsed literals.
+  * Operators and min and max on integer literals are evaluated right away with checked int64 arithmetic,
+  * so integer subexpressions are exact until PerformIntegerOperation gives up and they become doubles.
+  * Returns an error if the tokens do not form a valid postfix expression. With the text the tokens were sliced from,
+  * errors and program.positions hold offsets into it, and tokens from static strings, like the '$' of root, give its end.
+*/
+inline Error CompilePostfix(const TokenList &tokens, Program &program, const Options &options = Options(), std::string_view text = std::string_view()) {
+  CALC_STATS_TIMER(Compile);
+  int depth = 0;
+  std::pmr::vector<int64_t> integers(tokens.get_allocator()); // ? Exact values of the integers on top of the stack, each a trailing OpCode::Push
+  bool tracked = !text.empty();
+
+  program.code.clear();
+  program.code.reserve(tokens.size());
+  program.variables.clear();
+  program.positions.clear();
+  program.maxDepth = 0;
+  program.fastFunctions = options.fastFunctions;
+
+  auto Position = [&](std::string_view token) {
+    return (token.data() >= text.data() && token.data() < text.data() + text.length()) ? static_cast<size_t>(token.data() - text.data()) : text.length();
+  };
+
+  auto Emit = [&](const Instruction &instruction, std::string_view token) {
+    program.code.push_back(instruction);
+
+    if (tracked) {
+      program.positions.push_back(Position(token));
+    }
+  };
+
+  auto Fail = [&](ErrorCode code, std::string_view token) {
+    CALC_STATS_ERROR(InvalidExpression);
+    return Error{ code, Position(token) };
+  };
+
+  auto FoldIntegers = [&](char operation) {
+    size_t count = integers.size();
+    int64_t result;
+
+    if (count < 2 || !PerformIntegerOperation(integers[count - 2], integers[count - 1], operation, result)) {
+      integers.clear(); // ? The result is a double, and the integers below it can only ever meet doubles now
+      return false;
+    }
+
+    integers.pop_back();
+    integers.back() = result;
+    program.code.pop_back();
+    program.code.back().value = static_cast<double>(result);
+
+    if (tracked) {
+      program.positions.pop_back();
+    }
+
+    return true;
+  };
+
+  for (size_t i = 0; i < tokens.size(); ++i) {
+    std::string_view token = tokens[i];
+
+    if (StrIsDigit(token)) {
+      ExactValue number;
+
+      if (!ParseExactNumber(token, number, options.integers)) {
+        return Fail(ErrorCode::InvalidNumber, token);
+      }
+
+      if (number.isInteger) {
+        integers.push_back(number.integer);
+      } else {
+        integers.clear();
+      }
+
+      Emit({ OpCode::Push, 0, number.value }, token);
+      program.maxDepth = std::max(program.maxDepth, ++depth);
+      continue;
+    }
+
+    // ? A call pops its arguments and pushes one result, like an operator
+    if (token.back() == '(') {
+      int arity = FunctionArity(token.substr(0, token.length() - 1));
+
+      // ? A lone '(' is one InfixToPostfix never saw closed
+      if (!arity) {
+        return Fail(ErrorCode::UnbalancedParenthesis, token);
+      }
+
+      // ? It follows a call with the wrong number of arguments by the ')' closing it
+      if (i + 1 < tokens.size() && tokens[i + 1] == ")") {
+        return Fail(ErrorCode::ArgumentCount, token);
+      }
+
+      if (depth < arity) {
+        return Fail(ErrorCode::MissingOperand, token);
+      }
+
+      OpCode function = FunctionOpCode(token.substr(0, token.length() - 1));
+      depth -= arity - 1;
+
+      if (arity == 1) {
+        integers.clear();
+      } else if (FoldIntegers(static_cast<char>(function))) {
+        continue;
+      }
+
+      Emit({ function, 0, 0 }, token);
+      continue;
+    }
+
+    if (IsIdentifier(token)) {
+      auto found = std::find(program.variables.begin(), program.variables.end(), token);
+
+      if (found == program.variables.end()) {
+        found = program.variables.insert(found, std::string(token));
+      }
+
+      integers.clear();
+      Emit({ OpCode::Load, static_cast<int>(found - program.variables.begin()), 0 }, token);
+      program.maxDepth = std::max(program.maxDepth, ++depth);
+      continue;
+    }
+
+    if (token == ",") {
+      return Fail(ErrorCode::UnexpectedComma, token);
+    }
+
+    // ? Every operator pops two operands and pushes one result, anything else is a malformed number like "2.5.5"
+    if (token.length() != 1 || !IsOperator(token[0]) || token[0] == '.') {
+      return Fail(ErrorCode::InvalidNumber, token);
+    }
+
+    if (depth < 2) {
+      return Fail(ErrorCode::MissingOperand, token);
+    }
+
+    depth--;
+
+    if (!FoldIntegers(token[0])) {
+      Emit({ static_cast<OpCode>(token[0]), 0, 0 }, token);
+    }
+  }
+
+  // ? Whatever comes last is an operand nothing combined with the ones before it
+  if (depth != 1) {
+    return depth ? Fail(ErrorCode::MissingOperator, tokens.back()) : Fail(ErrorCode::EmptyExpression, text.substr(0, 0));
+  }
+
+  return {};
+}
+
+
+/*
+  * Runs a compiled program on a preallocated value stack and leaves its value in result.
+  * The stack is only resized when the program needs more room than it has.
+  * variables holds one value per entry of program.variables and may be null for programs without any.
+  * A division by zero stops the program with an error at the '/', result is then left alone.
+*/
+inline Error RunProgram(const Program &program, ValueStack &stack, const double *variables, double &result) {
+  CALC_STATS_TIMER(Evaluate);
+  CALC_STATS_VALUE_STACK(program.maxDepth);
+
+  if (stack.size() < static_cast<size_t>(program.maxDepth)) {
+    stack.resize(program.maxDepth);
+  }
+
+  double *top = stack.data(); // ? One past the topmost value
+
+  for (size_t i = 0; i < program.code.size(); ++i) {
+    const Instruction &instruction = program.code[i];
+
+    if (instruction.opCode == OpCode::Push) {
+      *top++ = instruction.value;
+      continue;
+    }
+
+    if (instruction.opCode == OpCode::Load) {
+      *top++ = variables[instruction.slot];
+      continue;
+    }
+
+    if (IsUnary(instruction.opCode)) {
+      top[-1] = PerformUnaryOperation(top[-1], instruction, program.fastFunctions);
+      continue;
+    }
+
+    double num2 = *--top; // ? Second operand
+
+    if (instruction.opCode == OpCode::Divide && !num2) {
+      CALC_STATS_ERROR(DivisionByZero);
+      return { ErrorCode::DivisionByZero, program.positions.empty() ? 0 : program.positions[i] };
+    }
+
+    top[-1] = PerformOperation(top[-1], num2, static_cast<char>(instruction.opCode));
+  }
+
+  result = top[-1];
+  return {};
+}
+
+
+inline Error RunProgram(const Program &program, ValueStack &stack, double &result) {
+  return RunProgram(program, stack, nullptr, result);
+}
+
+
+/*
+  * Optimizing pass over a compiled program, run between compiling and evaluating it.
+  * Folds constant subexpressions, turns small integer powers into multiplication chains
+  * and roots of a constant degree into powers. Returns how many instructions it removed.
+  * The program is rewritten in place, positions included when it has them, resource only backs the bookkeeping stack.
+*/
+inline size_t OptimizeProgram(Program &program, std::pmr::memory_resource *resource = std::pmr::get_default_resource()) {
+  struct Operand {
+    size_t start; // ? Index of the first instruction computing the operand
+    bool isConstant; // ? The operand is a single OpCode::Push
+  };
+
+  std::pmr::vector<Operand> stack(resource);
+  std::vector<Instruction> &code = program.code;
+  std::vector<size_t> &positions = program.positions;
+  size_t originalSize = code.size();
+  size_t end = 0; // ? Optimized code is written over code[0, end), which never overtakes the instruction being read
+  bool tracked = !positions.empty();
+
+  auto Write = [&](size_t at, const Instruction &instruction, size_t from) {
+    code[at] = instruction;
+
+    if (tracked) {
+      positions[at] = positions[from];
+    }
+  };
+
+  stack.reserve(program.maxDepth);
+
+  for (size_t i = 0; i < originalSize; ++i) {
+    Instruction instruction = code[i];
+
+    if (instruction.opCode == OpCode::Push || instruction.opCode == OpCode::Load) {
+      stack.push_back({ end, instruction.opCode == OpCode::Push });
+      Write(end++, instruction, i);
+      continue;
+    }
+
+    if (IsUnary(instruction.opCode)) {
+      if (stack.back().isConstant) {
+        code[end - 1].value = PerformUnaryOperation(code[end - 1].value, instruction, program.fastFunctions);
+      } else {
+        Write(end++, instruction, i);
+      }
+
+      continue;
+    }
+
+    Operand b = stack.back(); stack.pop_back();
+    Operand &a = stack.back();
+    double bValue = code[b.start].value;
+
+    // ? Divisions by zero are left for the evaluator to report
+    if (a.isConstant && b.isConstant && !(instruction.opCode == OpCode::Divide && !bValue)) {
+      code[a.start].value = PerformOperation(code[a.start].value, bValue, static_cast<char>(instruction.opCode));
+      end--;
+      continue;
+    }
+
+    a.isConstant = false;
+
+    if (instruction.opCode == OpCode::Power && b.isConstant) {
+      if (bValue >= 0 && bValue <= MAX_POWER_CHAIN && bValue == floor(bValue)) {
+        end--;
+
+        if (bValue != 1) { // ? x^1 is x
+          Write(end++, { OpCode::PowerInt, static_cast<int>(bValue), 0 }, i);
+        }
+
+        continue;
+      }
+    }
+
+    /*
+      * "a root b" is pow(b, 1 / a), so a constant degree becomes the exponent and saves the division.
+      * sqrt and cbrt would be faster, but they differ from pow for negative numbers, -0 and -inf, and cbrt in the last bit,
+      * so the optimizer would change results.
+    */
+    if (instruction.opCode == OpCode::Root && code[a.start].opCode == OpCode::Push && b.start == a.start + 1) {
+      double exponent = 1 / code[a.start].value;
+
+      std::move(code.begin() + b.start, code.begin() + end, code.begin() + a.start);
+
+      if (tracked) {
+        std::move(positions.begin() + b.start, positions.begin() + end, positions.begin() + a.start);
+      }
+
+      Write(end - 1, { OpCode::Push, 0, exponent }, i);
+      Write(end++, { OpCode::Power, 0, 0 }, i);
+      continue;
+    }
+
+    Write(end++, instruction, i);
+  }
+
+  code.resize(end);
+
+  if (tracked) {
+    positions.resize(end);
+  }
+
+  // ? Removing the degree of a root can lower the stack depth
+  int depth = 0;
+  program.maxDepth = 0;
+
+  for (const Instruction &instruction : code) {
+    if (instruction.opCode == OpCode::Push || instruction.opCode == OpCode::Load) {
+      program.maxDepth = std::max(program.maxDepth, ++depth);
+    } else if (!IsUnary(instruction.opCode)) {
+      depth--;
+    }
+  }
+
+  return originalSize - end;
+}
+
+
+/*
+  * Compiles text, an expression as typed, into program, with every error and program.positions as offsets into it.
+  * Whitespace is skipped, but characters CleanString would drop and ')' without a '(' are errors here.
+*/
+inline Error compile(std::string_view text, Program &program, const Options &options = Options()) {
+  std::string cleaned;
+  std::vector<size_t> offsets; // ? Position in text of every character of cleaned, and of its end
+  TokenList tokens;
+  int open = 0;
+
+  for (size_t i = 0; i < text.length(); ++i) {
+    char c = text[i];
+
+    if (isspace(static_cast<unsigned char>(c))) {
+      continue;
+    }
+
+    if (static_cast<unsigned char>(c) > 127 || !IsValid(c)) {
+      CALC_STATS_ERROR(InvalidExpression);
+      return { ErrorCode::UnexpectedCharacter, i };
+    }
+
+    if (c == ')' && !open--) {
+      CALC_STATS_ERROR(InvalidExpression);
+      return { ErrorCode::UnbalancedParenthesis, i };
+    }
+
+    open += c == '(';
+    cleaned += c;
+    offsets.push_back(i);
+  }
+
+  offsets.push_back(text.length());
+  Tokenise(tokens, cleaned);
+  InfixToPostfix(tokens);
+
+  Error error = CompilePostfix(tokens, program, options, cleaned);
+
+  for (size_t &position : program.positions) {
+    position = offsets[position];
+  }
+
+  if (error) {
+    error.position = offsets[error.position];
+    program.code.clear();
+    program.variables.clear();
+    program.positions.clear();
+    program.maxDepth = 0;
+    return error;
+  }
+
+  if (options.optimize) {
+    OptimizeProgram(program);
+  }
+
+  return {};
+}
+
+
+/*
+  * Evaluates program with values[i] as the value of program.variables[i].
+  * Makes no heap allocations unless the program is deeper than 64 values.
+*/
+inline Error evaluate(const Program &program, const double *values, size_t valueCount, double &result) {
+  if (program.code.empty()) {
+    return { ErrorCode::EmptyExpression, 0 };
+  }
+
+  for (size_t i = 0; valueCount < program.variables.size() && i < program.code.size(); ++i) {
+    if (program.code[i].opCode == OpCode::Load && static_cast<size_t>(program.code[i].slot) >= valueCount) {
+      return { ErrorCode::UnknownVariable, program.positions.empty() ? 0 : program.positions[i] };
+    }
+  }
+
+  double buffer[64];
+  std::pmr::monotonic_buffer_resource resource(buffer, sizeof(buffer));
+  ValueStack stack(&resource);
+
+  return RunProgram(program, stack, values, result);
+}
+
+
+inline Error evaluate(const Program &program, double &result) {
+  return evaluate(program, nullptr, 0, result);
+}
+
+
+} // namespace calc
+
+
+#endif
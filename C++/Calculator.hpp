@@ -0,0 +1,1049 @@
+/*
+  * Compile time version of the calculator in Calculator-1.cpp, header only and C++20.
+  *
+  * calc::eval("2*pi^2") evaluates a constant expression while compiling, so it folds to a double.
+  * calc::compile<"x*x+1">() parses while compiling and returns a function of the variables in order of first use,
+  * calc::compile<"x*x+1">()(3) == 10, with nothing left to parse at runtime.
+  *
+  * Expressions are cleaned, tokenised and turned into postfix exactly like Calculator-1.cpp does, built-in functions included.
+  * Literals are read whole and rounded correctly, so they give the same double as from_chars.
+  * Invalid expressions and unknown variables in calc::eval are compile errors.
+  * Division by zero gives -1 like the column evaluators of Calculator-1.cpp, where Calculator-Library.hpp reports an error.
+  * While compiling, functions are worked out in long double and rounded once, which nearly always gives what <cmath> does.
+  * sin and cos reduce their argument with a long double pi, so they drift from <cmath> as it grows large.
+*/
+#ifndef CALCULATOR_HPP
+#define CALCULATOR_HPP
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+
+namespace calc {
+
+
+// * String literal usable as a template argument, calc::compile<"x*x+1">
+template <size_t N>
+struct FixedString {
+  char data[N] = {};
+
+  constexpr FixedString(const char (&text)[N]) {
+    for (size_t i = 0; i < N; ++i) {
+      data[i] = text[i];
+    }
+  }
+
+  constexpr std::string_view View() const {
+    return std::string_view(data, N - 1);
+  }
+};
+
+
+namespace detail {
+
+
+constexpr bool IsDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+
+constexpr bool IsAlpha(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+
+constexpr bool IsNameChar(char c) {
+  return IsDigit(c) || IsAlpha(c) || c == '_';
+}
+
+
+constexpr bool IsOperator(char c) {
+  return c == '+' || c == '-' || c == '*' || c == '/' || c == '^' || c == '.' || c == '$';
+}
+
+
+constexpr bool IsValid(char c) {
+  return IsOperator(c) || IsNameChar(c) || c == '(' || c == ')' || c == ',';
+}
+
+
+// * Checks if a '-' after previous is the sign of a number rather than a subtraction
+constexpr bool StartsOperand(char previous) {
+  return IsOperator(previous) || previous == '(' || previous == ',';
+}
+
+
+constexpr bool IsNumber(std::string_view token) {
+  int dotCount = 0;
+  bool hasDigit = false;
+
+  for (char c : token) {
+    if (c == '.') {
+      if (++dotCount > 1) {
+        return false;
+      }
+    } else if (IsDigit(c)) {
+      hasDigit = true;
+    } else if (c != '-') {
+      return false;
+    }
+  }
+
+  return hasDigit;
+}
+
+
+constexpr bool IsIdentifier(std::string_view token) {
+  return !token.empty() && (IsAlpha(token[0]) || token[0] == '_');
+}
+
+
+constexpr const char *ConstantValue(std::string_view name) {
+  if (name == "e") return "2.7182818284";
+  if (name == "pi") return "3.1415926535";
+  if (name == "tau") return "6.2831853071";
+  return nullptr;
+}
+
+
+constexpr int FunctionArity(std::string_view name) {
+  if (name == "sqrt" || name == "exp" || name == "log" || name == "sin" || name == "cos" || name == "abs") return 1;
+  if (name == "min" || name == "max") return 2;
+  return 0;
+}
+
+
+// * The OpCode Calculator-1.cpp gives the built-in function called name
+constexpr char FunctionOpCode(std::string_view name) {
+  if (name == "sqrt") return 's';
+  if (name == "abs") return 'a';
+  if (name == "exp") return 'e';
+  if (name == "log") return 'l';
+  if (name == "sin") return 'S';
+  if (name == "cos") return 'C';
+  return name == "min" ? 'm' : 'M';
+}
+
+
+constexpr bool IsUnary(char opCode) {
+  return opCode == 's' || opCode == 'a' || opCode == 'e' || opCode == 'l' || opCode == 'S' || opCode == 'C';
+}
+
+
+constexpr int Precedence(std::string_view operation) {
+  if (operation == "+" || operation == "-") return 1;
+  if (operation == "*" || operation == "/") return 2;
+  if (operation == "^" || operation == "$") return 3;
+  return 0;
+}
+
+
+// * Big unsigned integer for ParseNumber, 32 bit limbs with the lowest first and no leading zero limbs
+using Limbs = std::vector<uint32_t>;
+
+
+constexpr void MultiplyAdd(Limbs &number, uint32_t factor, uint32_t addend) {
+  uint64_t carry = addend;
+
+  for (uint32_t &limb : number) {
+    carry += static_cast<uint64_t>(limb) * factor;
+    limb = static_cast<uint32_t>(carry);
+    carry >>= 32;
+  }
+
+  if (carry) {
+    number.push_back(static_cast<uint32_t>(carry));
+  }
+}
+
+
+constexpr void ShiftLeft(Limbs &number, int bits) {
+  if (number.empty()) {
+    return;
+  }
+
+  number.insert(number.begin(), bits / 32, 0);
+  bits %= 32;
+
+  if (bits) {
+    uint32_t carry = 0;
+
+    for (uint32_t &limb : number) {
+      uint32_t next = limb >> (32 - bits);
+      limb = (limb << bits) | carry;
+      carry = next;
+    }
+
+    if (carry) {
+      number.push_back(carry);
+    }
+  }
+}
+
+
+constexpr void ShiftRightOne(Limbs &number) {
+  for (size_t i = 0; i < number.size(); ++i) {
+    number[i] = (number[i] >> 1) | (i + 1 < number.size() ? number[i + 1] << 31 : 0);
+  }
+
+  if (!number.empty() && !number.back()) {
+    number.pop_back();
+  }
+}
+
+
+constexpr int BitLength(const Limbs &number) {
+  if (number.empty()) {
+    return 0;
+  }
+
+  int bits = static_cast<int>(number.size() - 1) * 32;
+
+  for (uint32_t top = number.back(); top; top >>= 1) {
+    bits++;
+  }
+
+  return bits;
+}
+
+
+constexpr int Compare(const Limbs &a, const Limbs &b) {
+  if (a.size() != b.size()) {
+    return a.size() < b.size() ? -1 : 1;
+  }
+
+  for (size_t i = a.size(); i-- > 0;) {
+    if (a[i] != b[i]) {
+      return a[i] < b[i] ? -1 : 1;
+    }
+  }
+
+  return 0;
+}
+
+
+// * a -= b, where a is at least b
+constexpr void Subtract(Limbs &a, const Limbs &b) {
+  int64_t borrow = 0;
+
+  for (size_t i = 0; i < a.size(); ++i) {
+    int64_t difference = static_cast<int64_t>(a[i]) - (i < b.size() ? b[i] : 0) - borrow;
+    borrow = difference < 0;
+    a[i] = static_cast<uint32_t>(difference + (borrow << 32));
+  }
+
+  while (!a.empty() && !a.back()) {
+    a.pop_back();
+  }
+}
+
+
+/*
+  * Parses the whole of token like from_chars does, false if it is not a number.
+  * The digits over 10 to the number of decimals are divided as big integers into a 64 bit quotient and a remainder,
+  * which are rounded to nearest even once, so every literal gives the same double as strtod, subnormals included.
+*/
+constexpr bool ParseNumber(std::string_view token, double &value) {
+  size_t i = 0;
+  bool negative = i < token.length() && token[i] == '-';
+  bool seenPoint = false;
+  bool seenDigit = false;
+  Limbs numerator, denominator = { 1 };
+  int scale = 0; // ? value is numerator / denominator * 2^scale
+
+  for (i = negative; i < token.length(); ++i) {
+    if (token[i] == '.' && !seenPoint) {
+      seenPoint = true;
+    } else if (IsDigit(token[i])) {
+      seenDigit = true;
+
+      if (!numerator.empty() || token[i] != '0') {
+        MultiplyAdd(numerator, 10, token[i] - '0');
+      }
+
+      if (seenPoint) {
+        MultiplyAdd(denominator, 10, 0);
+      }
+    } else {
+      return false;
+    }
+  }
+
+  if (!seenDigit) {
+    return false;
+  }
+
+  if (numerator.empty()) {
+    value = negative ? -0.0 : 0.0;
+    return true;
+  }
+
+  // ? Scale so that the quotient is in [2^63, 2^64)
+  int shift = 64 - (BitLength(numerator) - BitLength(denominator));
+
+  if (shift > 0) {
+    ShiftLeft(numerator, shift);
+  } else {
+    ShiftLeft(denominator, -shift);
+  }
+
+  scale -= shift;
+  ShiftLeft(denominator, 64);
+
+  // ? The quotient of [2^63, 2^65) has 65 bits, then it is halved, otherwise the first step compares with denominator * 2^63
+  if (Compare(numerator, denominator) >= 0) {
+    scale++;
+  } else {
+    ShiftRightOne(denominator);
+  }
+
+  // ? Restoring division, one quotient bit per step
+  uint64_t quotient = 0;
+
+  for (int bit = 63; bit >= 0; --bit) {
+    if (Compare(numerator, denominator) >= 0) {
+      Subtract(numerator, denominator);
+      quotient |= uint64_t(1) << bit;
+    }
+
+    ShiftRightOne(denominator);
+  }
+
+  // ? Keep 53 bits, fewer for subnormals, and round the rest to nearest even with what the division left as sticky bit
+  int exponent = 63 + scale; // ? Of the leading bit
+  int drop = 11 + (exponent < -1022 ? -1022 - exponent : 0);
+
+  if (drop > 64) {
+    value = negative ? -0.0 : 0.0;
+    return true;
+  }
+
+  uint64_t mantissa = drop == 64 ? 0 : quotient >> drop;
+  uint64_t rest = drop == 64 ? quotient : quotient & ((uint64_t(1) << drop) - 1);
+  uint64_t half = uint64_t(1) << (drop - 1);
+
+  if (rest > half || (rest == half && (!numerator.empty() || (mantissa & 1)))) {
+    mantissa++;
+  }
+
+  // ? mantissa * 2^(scale + drop), exact at every step down and infinity past the largest double
+  double result = static_cast<double>(mantissa);
+
+  for (int power = scale + drop; power > 0; --power) {
+    result *= 2;
+  }
+
+  for (int power = scale + drop; power < 0; ++power) {
+    result /= 2;
+  }
+
+  value = negative ? -result : result;
+  return true;
+}
+
+
+// * Math for constant evaluation, <cmath> is not constexpr in C++20. Runs in long double and rounds once at the end
+constexpr long double Ln2 = 0.693147180559945309417232121458176568L;
+
+
+constexpr long double Exp(long double x) {
+  if (x != x) return x;
+  if (x > 11357) return std::numeric_limits<long double>::infinity();
+  if (x < -11400) return 0;
+
+  long long k = static_cast<long long>(x / Ln2 + (x < 0 ? -0.5L : 0.5L));
+  long double r = x - k * Ln2;
+  long double term = 1;
+  long double sum = 1;
+
+  for (int n = 1; n < 30 && term; ++n) {
+    term *= r / n;
+    sum += term;
+  }
+
+  for (; k > 0; k--) sum *= 2;
+  for (; k < 0; k++) sum /= 2;
+
+  return sum;
+}
+
+
+constexpr long double Log(long double x) {
+  if (x != x || x < 0) return std::numeric_limits<long double>::quiet_NaN();
+  if (x == 0) return -std::numeric_limits<long double>::infinity();
+  if (x == std::numeric_limits<long double>::infinity()) return x;
+
+  // ? x = m * 2^k with m in [sqrt(1/2), sqrt(2)), then log(m) = 2 * atanh((m - 1) / (m + 1))
+  long long k = 0;
+
+  for (; x >= 1.4142135623730950488L; k++) x /= 2;
+  for (; x < 0.7071067811865475244L; k--) x *= 2;
+
+  long double s = (x - 1) / (x + 1);
+  long double power = s;
+  long double sum = 0;
+
+  for (int n = 1; n < 80; n += 2) {
+    sum += power / n;
+    power *= s * s;
+  }
+
+  return 2 * sum + k * Ln2;
+}
+
+
+constexpr double Sqrt(double x) {
+  if (x != x || x < 0) return std::numeric_limits<double>::quiet_NaN();
+  if (x == 0 || x == std::numeric_limits<double>::infinity()) return x;
+
+  long double guess = x < 1 ? 1 : x;
+
+  for (int i = 0; i < 2000; ++i) {
+    long double next = (guess + x / guess) / 2;
+
+    if (next == guess) {
+      break;
+    }
+
+    guess = next;
+  }
+
+  return static_cast<double>(guess);
+}
+
+
+constexpr long double PowerBySquaring(long double base, int exponent) {
+  long double result = 1;
+
+  while (exponent) {
+    if (exponent & 1) {
+      result *= base;
+    }
+
+    base *= base;
+    exponent >>= 1;
+  }
+
+  return result;
+}
+
+
+constexpr double Pow(double a, double b) {
+  if (b == 0) return 1;
+  if (a != a || b != b) return std::numeric_limits<double>::quiet_NaN();
+
+  // ? Integer exponents multiply in long double, which nearly always rounds to the same double as pow
+  if (b > -1024 && b < 1024 && b == static_cast<int>(b)) {
+    int exponent = static_cast<int>(b);
+    return static_cast<double>(exponent > 0 ? PowerBySquaring(a, exponent) : 1 / PowerBySquaring(a, -exponent));
+  }
+
+  if (b == 0.5) return Sqrt(a);
+  if (a < 0) return std::numeric_limits<double>::quiet_NaN();
+  if (a == 0) return b > 0 ? 0 : std::numeric_limits<double>::infinity();
+
+  return static_cast<double>(Exp(b * Log(a)));
+}
+
+
+constexpr long double Pi = 3.141592653589793238462643383279502884L;
+
+
+// * sin, or cos when cosine is set, after taking out the nearest multiple of pi/2
+constexpr long double SineCosine(long double x, bool cosine) {
+  if (x != x || x - x != 0) return std::numeric_limits<long double>::quiet_NaN();
+
+  long long quadrant = static_cast<long long>(x / (Pi / 2) + (x < 0 ? -0.5L : 0.5L));
+  long double r = x - quadrant * (Pi / 2);
+  long double sine = 0, cosineSum = 0;
+  long double term = r;
+
+  // ? Taylor series of both, alternating terms r^n / n!
+  for (int n = 1; n < 40; n += 2) {
+    sine += term;
+    term *= -r * r / ((n + 1) * (n + 2));
+  }
+
+  term = 1;
+
+  for (int n = 0; n < 40; n += 2) {
+    cosineSum += term;
+    term *= -r * r / ((n + 1) * (n + 2));
+  }
+
+  switch ((quadrant + cosine) & 3) {
+    case 0: return sine;
+    case 1: return cosineSum;
+    case 2: return -sine;
+    default: return -cosineSum;
+  }
+}
+
+
+// * PerformFunction of Calculator-1.cpp, with <cmath> at runtime and the functions above while compiling
+constexpr double PerformFunction(double a, char function) {
+  bool constant = std::is_constant_evaluated();
+
+  switch (function) {
+    case 's':
+      return constant ? Sqrt(a) : std::sqrt(a);
+    case 'a':
+      return a < 0 ? -a : (a == 0 ? 0.0 : a);
+    case 'e':
+      return constant ? static_cast<double>(Exp(a)) : std::exp(a);
+    case 'l':
+      return constant ? static_cast<double>(Log(a)) : std::log(a);
+    case 'S':
+      return constant ? static_cast<double>(SineCosine(a, false)) : std::sin(a);
+    case 'C':
+      return constant ? static_cast<double>(SineCosine(a, true)) : std::cos(a);
+  }
+
+  return -1;
+}
+
+
+// * PerformOperation, with <cmath> at runtime and the functions above while compiling
+constexpr double PerformOperation(double a, double b, char operation) {
+  switch (operation) {
+    case '*':
+      return a * b;
+    case '/':
+      if (!b) {
+        break;
+      }
+      return a / b;
+    case '+':
+      return a + b;
+    case '-':
+      return a - b;
+    case '^':
+      return std::is_constant_evaluated() ? Pow(a, b) : std::pow(a, b);
+    case '$':
+      return std::is_constant_evaluated() ? Pow(b, 1 / a) : std::pow(b, 1 / a);
+    case 'm': // ? b when either is NaN, like the minpd and maxpd of Calculator-1.cpp
+      return a < b ? a : b;
+    case 'M':
+      return a > b ? a : b;
+  }
+
+  return -1;
+}
+
+
+// * CheckedAdd, CheckedSubtract and CheckedMultiply from Calculator-1.cpp, false instead of overflowing
+constexpr int64_t Int64Max = std::numeric_limits<int64_t>::max();
+constexpr int64_t Int64Min = std::numeric_limits<int64_t>::min();
+
+
+constexpr bool CheckedAdd(int64_t a, int64_t b, int64_t &result) {
+  if (b > 0 ? a > Int64Max - b : a < Int64Min - b) {
+    return false;
+  }
+
+  result = a + b;
+  return true;
+}
+
+
+constexpr bool CheckedSubtract(int64_t a, int64_t b, int64_t &result) {
+  if (b > 0 ? a < Int64Min + b : a > Int64Max + b) {
+    return false;
+  }
+
+  result = a - b;
+  return true;
+}
+
+
+constexpr bool CheckedMultiply(int64_t a, int64_t b, int64_t &result) {
+  if (a > 0 ? (b > 0 ? a > Int64Max / b : b < Int64Min / a) : (b > 0 ? a < Int64Min / b : a && b < Int64Max / a)) {
+    return false;
+  }
+
+  result = a * b;
+  return true;
+}
+
+
+// * PerformIntegerOperation from Calculator-1.cpp, false when the result is not an exact int64
+constexpr bool PerformIntegerOperation(int64_t a, int64_t b, char operation, int64_t &result) {
+  switch (operation) {
+    case '+':
+      return CheckedAdd(a, b, result);
+    case '-':
+      return CheckedSubtract(a, b, result);
+    case '*':
+      return CheckedMultiply(a, b, result);
+    case '/':
+      if (!b || (a == Int64Min && b == -1) || a % b) {
+        return false;
+      }
+
+      result = a / b;
+      return true;
+    case '^':
+      if (b < 0) {
+        return false;
+      }
+
+      for (result = 1; b; b >>= 1) {
+        if ((b & 1) && !CheckedMultiply(result, a, result)) {
+          return false;
+        }
+
+        if (b > 1 && !CheckedMultiply(a, a, a)) {
+          return false;
+        }
+      }
+
+      return true;
+    case 'm':
+      result = a < b ? a : b;
+      return true;
+    case 'M':
+      result = a > b ? a : b;
+      return true;
+  }
+
+  return false;
+}
+
+
+// * Reads token as an int64 like from_chars does, false unless it is a whole number that fits
+constexpr bool ParseInteger(std::string_view token, int64_t &value) {
+  bool negative = !token.empty() && token[0] == '-';
+  uint64_t limit = static_cast<uint64_t>(Int64Max) + negative;
+  uint64_t magnitude = 0;
+
+  if (token.length() == negative) {
+    return false;
+  }
+
+  for (size_t i = negative; i < token.length(); ++i) {
+    if (!IsDigit(token[i]) || magnitude > (limit - (token[i] - '0')) / 10) {
+      return false;
+    }
+
+    magnitude = magnitude * 10 + (token[i] - '0');
+  }
+
+  value = negative ? static_cast<int64_t>(0 - magnitude) : static_cast<int64_t>(magnitude);
+  return true;
+}
+
+
+// * Removes whitespaces and unknown characters
+constexpr std::string Clean(std::string_view input) {
+  std::string output;
+
+  for (char c : input) {
+    if (IsValid(c)) {
+      output += c;
+    }
+  }
+
+  return output;
+}
+
+
+// * Tokenise from Calculator-1.cpp, tokens are slices of input or of static strings
+constexpr std::vector<std::string_view> Tokenise(std::string_view input) {
+  std::vector<std::string_view> tokens;
+  size_t tokenStart = 0;
+  bool inToken = false;
+
+  for (size_t i = 0; i <= input.length(); ++i) {
+    char currentChar = (i < input.length()) ? input[i] : '\0';
+
+    if ((currentChar == '-' && (!i || StartsOperand(input[i - 1]))) || IsDigit(currentChar) || currentChar == '.') {
+      if (!inToken) {
+        tokenStart = i;
+        inToken = true;
+      }
+
+      continue;
+    }
+
+    std::string_view currentToken = inToken ? input.substr(tokenStart, i - tokenStart) : std::string_view();
+    inToken = false;
+
+    if (IsAlpha(currentChar) || currentChar == '_') {
+      if (input.substr(i, 4) == "root" && (i + 4 == input.length() || (!IsAlpha(input[i + 4]) && input[i + 4] != '_'))) {
+        if (!currentToken.empty()) {
+          tokens.push_back(currentToken);
+        }
+
+        tokens.push_back("$");
+        i += 3;
+        continue;
+      }
+
+      size_t end = i;
+
+      while (end < input.length() && IsNameChar(input[end])) {
+        end++;
+      }
+
+      if (currentToken == "-") {
+        tokens.push_back("-1");
+        tokens.push_back("*");
+      } else if (!currentToken.empty()) {
+        tokens.push_back(currentToken);
+        tokens.push_back("*");
+      }
+
+      std::string_view name = input.substr(i, end - i);
+      const char *constant = ConstantValue(name);
+      tokens.push_back(constant ? std::string_view(constant) : name);
+
+      i = end - 1;
+      continue;
+    }
+
+    if (!currentToken.empty()) {
+      tokens.push_back(currentToken);
+    }
+
+    if (currentChar != '\0') {
+      tokens.push_back(input.substr(i, 1));
+    }
+  }
+
+  return tokens;
+}
+
+
+// * Shunting yard from Calculator-1.cpp, a call reaches the output as its name with the opening parenthesis, "sin("
+constexpr std::vector<std::string_view> InfixToPostfix(const std::vector<std::string_view> &input) {
+  std::vector<std::string_view> output, stack;
+  std::vector<int> arguments; // ? Commas seen so far for every open parenthesis, -1 when it is not a call
+
+  for (size_t i = 0; i < input.size(); ++i) {
+    std::string_view token = input[i];
+
+    // ? A function name directly followed by its parenthesis opens a call
+    if (IsIdentifier(token) && FunctionArity(token) && i + 1 < input.size() && input[i + 1] == "(" && input[i + 1].data() == token.data() + token.length()) {
+      stack.push_back(std::string_view(token.data(), token.length() + 1));
+      arguments.push_back(0);
+      i++;
+      continue;
+    }
+
+    if (IsNumber(token) || IsIdentifier(token)) {
+      output.push_back(token);
+      continue;
+    }
+
+    if (IsOperator(token[0])) {
+      while (!stack.empty() && Precedence(stack.back()) >= Precedence(token)) {
+        output.push_back(stack.back());
+        stack.pop_back();
+      }
+
+      stack.push_back(token);
+    }
+
+    if (token == "(") {
+      stack.push_back(token);
+      arguments.push_back(-1);
+      continue;
+    }
+
+    // ? Misplaced commas and calls with the wrong number of arguments are left in the output for Compile to reject
+    if (token == ")" || token == ",") {
+      while (!stack.empty() && stack.back().back() != '(') {
+        output.push_back(stack.back());
+        stack.pop_back();
+      }
+
+      if (stack.empty() || (token == "," && arguments.back() < 0)) {
+        if (token == ",") {
+          output.push_back(token);
+        }
+
+        continue;
+      }
+
+      if (token == ",") {
+        arguments.back()++;
+        continue;
+      }
+
+      if (stack.back() != "(") {
+        output.push_back(stack.back());
+
+        if (arguments.back() + 1 != FunctionArity(stack.back().substr(0, stack.back().length() - 1))) {
+          output.push_back(token);
+        }
+      }
+
+      stack.pop_back();
+      arguments.pop_back();
+    }
+  }
+
+  while (!stack.empty()) {
+    output.push_back(stack.back().back() == '(' ? stack.back().substr(stack.back().length() - 1) : stack.back());
+    stack.pop_back();
+  }
+
+  return output;
+}
+
+
+struct Instruction {
+  char opCode; // ? '\0' pushes value, '\1' loads variable slot, anything else is the operator
+  int slot;
+  double value;
+};
+
+
+struct Program {
+  std::vector<Instruction> code;
+  std::vector<std::string> variables;
+  int maxDepth = 0;
+};
+
+
+/*
+  * CompilePostfix from Calculator-1.cpp, throwing while compiling makes an invalid expression a compile error.
+  * Integer subexpressions are folded with checked int64 arithmetic the same way, so "2^62+1-2^62" is exactly 1.
+*/
+constexpr Program Compile(std::string_view expression) {
+  std::string cleaned = Clean(expression);
+  Program program;
+  int depth = 0;
+  std::vector<int64_t> integers; // ? Exact values of the integers on top of the stack, each a trailing push
+
+  auto FoldIntegers = [&](char operation) {
+    size_t count = integers.size();
+    int64_t result = 0;
+
+    if (count < 2 || !PerformIntegerOperation(integers[count - 2], integers[count - 1], operation, result)) {
+      integers.clear();
+      return false;
+    }
+
+    integers.pop_back();
+    integers.back() = result;
+    program.code.pop_back();
+    program.code.back().value = static_cast<double>(result);
+    return true;
+  };
+
+  for (std::string_view token : InfixToPostfix(Tokenise(cleaned))) {
+    if (IsNumber(token)) {
+      int64_t integer = 0;
+
+      if (ParseInteger(token, integer)) {
+        integers.push_back(integer);
+        program.code.push_back({ '\0', 0, static_cast<double>(integer) });
+      } else {
+        integers.clear();
+        double value = 0;
+
+        if (!ParseNumber(token, value)) {
+          throw "Invalid expression!";
+        }
+
+        program.code.push_back({ '\0', 0, value });
+      }
+
+      program.maxDepth = std::max(program.maxDepth, ++depth);
+      continue;
+    }
+
+    // ? A call pops its arguments and pushes one result, like an operator
+    if (token.back() == '(') {
+      int arity = FunctionArity(token.substr(0, token.length() - 1));
+
+      if (!arity || depth < arity) {
+        throw "Invalid expression!";
+      }
+
+      char function = FunctionOpCode(token.substr(0, token.length() - 1));
+      depth -= arity - 1;
+
+      if (arity == 1) {
+        integers.clear();
+      } else if (FoldIntegers(function)) {
+        continue;
+      }
+
+      program.code.push_back({ function, 0, 0 });
+      continue;
+    }
+
+    if (IsIdentifier(token)) {
+      size_t slot = 0;
+
+      while (slot < program.variables.size() && program.variables[slot] != token) {
+        slot++;
+      }
+
+      if (slot == program.variables.size()) {
+        program.variables.emplace_back(token);
+      }
+
+      integers.clear();
+      program.code.push_back({ '\1', static_cast<int>(slot), 0 });
+      program.maxDepth = std::max(program.maxDepth, ++depth);
+      continue;
+    }
+
+    if (token.length() != 1 || !IsOperator(token[0]) || token[0] == '.' || depth < 2) {
+      throw "Invalid expression!";
+    }
+
+    depth--;
+
+    if (!FoldIntegers(token[0])) {
+      program.code.push_back({ token[0], 0, 0 });
+    }
+  }
+
+  if (depth != 1) {
+    throw "Invalid expression!";
+  }
+
+  return program;
+}
+
+
+// * Program with its size fixed, so it can be a template argument
+template <size_t Size, size_t VariableCount, size_t NameLength>
+struct FixedProgram {
+  std::array<Instruction, Size> code = {};
+  std::array<size_t, VariableCount + 1> nameStarts = {}; // ? Variable i is names[nameStarts[i], nameStarts[i + 1])
+  std::array<char, NameLength + 1> names = {};
+  int maxDepth = 0;
+};
+
+
+template <FixedString Expression>
+consteval auto Freeze() {
+  constexpr size_t size = Compile(Expression.View()).code.size();
+  constexpr size_t variableCount = Compile(Expression.View()).variables.size();
+  Program program = Compile(Expression.View());
+  FixedProgram<size, variableCount, Expression.View().length()> fixed;
+  size_t nameLength = 0;
+
+  for (size_t i = 0; i < size; ++i) {
+    fixed.code[i] = program.code[i];
+  }
+
+  for (size_t i = 0; i < variableCount; ++i) {
+    fixed.nameStarts[i] = nameLength;
+
+    for (char c : program.variables[i]) {
+      fixed.names[nameLength++] = c;
+    }
+  }
+
+  fixed.nameStarts[variableCount] = nameLength;
+  fixed.maxDepth = program.maxDepth;
+  return fixed;
+}
+
+
+} // namespace detail
+
+
+/*
+  * Function compiled from an expression, the program is unrolled into straight line code.
+  * Takes one double per variable, in order of first use, or a pointer to them.
+*/
+template <auto Program>
+struct Function {
+  static constexpr size_t arity = Program.nameStarts.size() - 1;
+
+  static constexpr std::string_view variable(size_t slot) {
+    return std::string_view(Program.names.data() + Program.nameStarts[slot], Program.nameStarts[slot + 1] - Program.nameStarts[slot]);
+  }
+
+  template <typename... Values>
+    requires (sizeof...(Values) == arity && (std::is_convertible_v<Values, double> && ...))
+  constexpr double operator()(Values... values) const {
+    const double variables[arity + 1] = { static_cast<double>(values)... };
+    return (*this)(variables);
+  }
+
+  constexpr double operator()(const double *variables) const {
+    double stack[Program.maxDepth] = {};
+    return Run<0, 0>(stack, variables);
+  }
+
+private:
+  template <size_t Index, int Depth>
+  static constexpr double Run(double *stack, const double *variables) {
+    if constexpr (Index == Program.code.size()) {
+      return stack[0];
+    } else {
+      constexpr detail::Instruction instruction = Program.code[Index];
+
+      if constexpr (instruction.opCode == '\0') {
+        stack[Depth] = instruction.value;
+        return Run<Index + 1, Depth + 1>(stack, variables);
+      } else if constexpr (instruction.opCode == '\1') {
+        stack[Depth] = variables[instruction.slot];
+        return Run<Index + 1, Depth + 1>(stack, variables);
+      } else if constexpr (detail::IsUnary(instruction.opCode)) {
+        stack[Depth - 1] = detail::PerformFunction(stack[Depth - 1], instruction.opCode);
+        return Run<Index + 1, Depth>(stack, variables);
+      } else {
+        stack[Depth - 2] = detail::PerformOperation(stack[Depth - 2], stack[Depth - 1], instruction.opCode);
+        return Run<Index + 1, Depth - 1>(stack, variables);
+      }
+    }
+  }
+};
+
+
+template <FixedString Expression>
+constexpr auto compile() {
+  return Function<detail::Freeze<Expression>()>();
+}
+
+
+// * Evaluates a constant expression while compiling
+consteval double eval(std::string_view expression) {
+  detail::Program program = detail::Compile(expression);
+  std::vector<double> stack;
+
+  if (!program.variables.empty()) {
+    throw "Unknown variable";
+  }
+
+  for (const detail::Instruction &instruction : program.code) {
+    if (instruction.opCode == '\0') {
+      stack.push_back(instruction.value);
+      continue;
+    }
+
+    if (detail::IsUnary(instruction.opCode)) {
+      stack.back() = detail::PerformFunction(stack.back(), instruction.opCode);
+      continue;
+    }
+
+    double b = stack.back();
+    stack.pop_back();
+    stack.back() = detail::PerformOperation(stack.back(), b, instruction.opCode);
+  }
+
+  return stack.back();
+}
+
+
+} // namespace calc
+
+
+#endif
@@ -5,12 +5,13 @@
 #include <stdlib.h>
 #include <math.h>
 #include <stdbool.h>
+#include <time.h>
 
 #define PI 3.14159265358979323846
 #define E 2.7182818284590452354
 #define TAU (PI * 2)
 #define INIT_CAPACITY 3
-#define MAX_SIZE 251
+#define LINE_CAPACITY 256 // ? Starting size of the line buffer, which doubles as needed
 
 
 /*
@@ -143,6 +144,7 @@ void CheckConstant(vector *tokens, int *index, const char *inputString) {
     snprintf(buffer, sizeof(buffer), "%.7f", E);
     AddToken(tokens, buffer);
     isSuccess = 1;
+    addLen = 0;
   } else if (!strncmp(&inputString[*index], "pi", 2)) {
     snprintf(buffer, sizeof(buffer), "%.7f", PI);
     AddToken(tokens, buffer);
@@ -181,11 +183,7 @@ double PerformOperation(double a, double b, char operation) {
     case '*':
       return a * b;
     case '/':
-      if (!b) {
-        fprintf(stderr, "Division by zero!");
-        exit(EXIT_FAILURE);
-      }
-      return a / b;
+      return a / b; // ? EvaluatePostfix catches zero divisors before they get here
     case '+':
       return a + b;
     case '-':
@@ -205,11 +203,12 @@ double PerformOperation(double a, double b, char operation) {
 // * Tokenise the inputString
 void Tokenise(vector *inputTokens, const char *inputString) {
   InitToken(inputTokens);
-  char currentToken[MAX_SIZE];
+  size_t length = strlen(inputString);
+  char *currentToken = (char*)malloc(length + 1); // ? No number can be longer than the whole input
   int currentTokenLen = 0;
 
-  for (int i = 0; i <= strlen(inputString); ++i) {
-    char currentChar = (i < strlen(inputString) ? inputString[i] : '\0');
+  for (int i = 0; i <= length; ++i) {
+    char currentChar = (i < length ? inputString[i] : '\0');
 
     // * Checks for '-' and if the '-' is a negative sign
     if (currentChar == '-' && (!i || isoperator(inputString[i - 1]) || inputString[i - 1] == '(')) {
@@ -238,6 +237,8 @@ void Tokenise(vector *inputTokens, const char *inputString) {
       AddToken(inputTokens, operatorToken);
     }
   }
+
+  free(currentToken);
 }
 
 /*
@@ -284,10 +285,15 @@ void ToPostfix(vector *tokens) {
 }
 
 
-double EvaluatePostfix(vector *tokens) {
+/*
+  * Evaluates the postfix tokens into result and frees them
+  * Returns NULL, or what is wrong with the expression if it has no value
+*/
+const char *EvaluatePostfix(vector *tokens, double *result) {
   StackD *stack = InitStackD();
+  const char *error = NULL;
 
-  for (int i = 0; i < tokens->size; ++i) {
+  for (int i = 0; i < tokens->size && !error; ++i) {
     char *token = tokens->tokens[i];
 
     if (isdigit(token[0])) {
@@ -295,28 +301,42 @@ double EvaluatePostfix(vector *tokens) {
       continue;
     }
 
+    if (stack->top < 1) {
+      error = "Not enough operands!";
+      break;
+    }
+
     double b = popD(stack);
     double a = popD(stack);
-    pushD(stack, PerformOperation(a, b, token[0]));
+
+    if (token[0] == '/' && !b) {
+      error = "Division by zero!";
+    } else {
+      pushD(stack, PerformOperation(a, b, token[0]));
+    }
+  }
+
+  if (!error && stack->top != 0) {
+    error = "Too many operators!";
   }
 
-  if (stack->top != 0) {
-    fprintf(stderr, "Too many operators!\n");
-    exit(EXIT_FAILURE);
+  if (!error) {
+    *result = topD(stack);
   }
 
-  double result = topD(stack);
   FreeToken(tokens);
+  free(stack->data);
   free(stack);
-  return result;
+  return error;
 }
 
 
 // * Cleans inputString from any whitespaces and unused characters
 char *CleanString(char *inputString) {
-  int index = 0;
+  size_t index = 0;
+  size_t length = strlen(inputString);
 
-  for (int i = 0; i < strlen(inputString); ++i) {
+  for (size_t i = 0; i < length; ++i) {
     const char c = inputString[i];
     
     if (isdigit(c) || isoperator(c) || isconstant(c) || isroot(c) || c == '(' || c == ')') {
@@ -331,10 +351,151 @@ char *CleanString(char *inputString) {
 }
 
 
-int main() {
-  char *input = (char*)malloc((sizeof(char)) * MAX_SIZE);
+// * Wall clock time in seconds
+double Seconds(void) {
+  struct timespec now;
+  timespec_get(&now, TIME_UTC);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+
+/*
+  * Times clean, tokenise, postfix and evaluate separately over every line of file and prints one JSON object
+  * Each stage runs over the whole corpus before the next one starts
+  * Lines that divide by zero or are not valid expressions are counted as errors, like in the other implementations
+*/
+void RunStageBenchmark(FILE *file) {
+  size_t length = 0;
+  size_t capacity = 1 << 16;
+  char *data = (char*)malloc(capacity);
+  size_t count;
+
+  while ((count = fread(data + length, 1, capacity - length, file)) > 0) {
+    length += count;
+
+    if (length == capacity) {
+      capacity *= 2;
+      data = (char*)realloc(data, capacity);
+    }
+  }
+
+  size_t lineCount = 0;
+  size_t lineCapacity = 1024;
+  char **lines = (char**)malloc(sizeof(char*) * lineCapacity);
+
+  for (size_t start = 0; start < length;) {
+    size_t end = start;
+
+    while (end < length && data[end] != '\n') end++;
+
+    if (lineCount == lineCapacity) {
+      lineCapacity *= 2;
+      lines = (char**)realloc(lines, sizeof(char*) * lineCapacity);
+    }
+
+    // ? Every line gets its own allocation since CleanString reallocates it
+    lines[lineCount] = (char*)malloc(end - start + 1);
+    memcpy(lines[lineCount], data + start, end - start);
+    lines[lineCount++][end - start] = '\0';
+    start = end + 1;
+  }
+
+  free(data);
+
+  vector *tokens = (vector*)malloc(sizeof(vector) * (lineCount ? lineCount : 1));
+  const char *stageNames[] = { "clean", "tokenize", "postfix", "evaluate" };
+  double stageSeconds[4];
+  double checksum = 0; // ? Sum of the finite results
+  size_t nonFinite = 0;
+  size_t errors = 0;
+  double start;
+
+  start = Seconds();
+  for (size_t i = 0; i < lineCount; ++i) lines[i] = CleanString(lines[i]);
+  stageSeconds[0] = Seconds() - start;
+
+  start = Seconds();
+  for (size_t i = 0; i < lineCount; ++i) Tokenise(&tokens[i], lines[i]);
+  stageSeconds[1] = Seconds() - start;
+
+  start = Seconds();
+  for (size_t i = 0; i < lineCount; ++i) ToPostfix(&tokens[i]);
+  stageSeconds[2] = Seconds() - start;
+
+  start = Seconds();
+  for (size_t i = 0; i < lineCount; ++i) {
+    double result;
+
+    if (EvaluatePostfix(&tokens[i], &result)) {
+      errors++;
+    } else if (isfinite(result)) {
+      checksum += result;
+    } else {
+      nonFinite++;
+    }
+  }
+  stageSeconds[3] = Seconds() - start;
+
+  for (size_t i = 0; i < lineCount; ++i) {
+    free(lines[i]);
+  }
+
+  free(lines);
+  free(tokens);
+
+  double total = 0;
+  printf("{\"implementation\": \"C/Calculator.c\", \"expressions\": %zu, \"bytes\": %zu, \"stages\": {", lineCount, length);
+
+  for (int stage = 0; stage < 4; ++stage) {
+    total += stageSeconds[stage];
+    printf("%s\"%s\": {\"seconds\": %.9f, \"ns_per_expression\": %.3f}", stage ? ", " : "", stageNames[stage], stageSeconds[stage], lineCount ? stageSeconds[stage] * 1e9 / lineCount : 0.0);
+  }
+
+  printf("}, \"total_seconds\": %.9f, \"errors\": %zu, \"non_finite\": %zu, \"checksum\": %.17g}\n", total, errors, nonFinite, checksum);
+}
+
+
+// * Reads a line of any length from file without its newline, empty at the end of the file
+char *ReadLine(FILE *file) {
+  size_t length = 0;
+  size_t capacity = LINE_CAPACITY;
+  char *line = (char*)malloc(capacity);
+  line[0] = '\0';
+
+  while (fgets(line + length, capacity - length, file)) {
+    length += strlen(line + length);
+
+    if (length && line[length - 1] == '\n') {
+      line[--length] = '\0';
+      break;
+    }
+
+    if (length == capacity - 1) {
+      capacity *= 2;
+      line = (char*)realloc(line, capacity);
+    }
+  }
+
+  return line;
+}
+
+
+int main(int argc, char *argv[]) {
+  // * --bench-stages [file] times every stage over a corpus and prints JSON
+  if (argc > 1 && !strcmp(argv[1], "--bench-stages")) {
+    FILE *file = (argc > 2) ? fopen(argv[2], "rb") : stdin;
+
+    if (!file) {
+      fprintf(stderr, "Could not open %s\n", argv[2]);
+      return 1;
+    }
+
+    RunStageBenchmark(file);
+    return 0;
+  }
+
   printf("Input: ");
-  scanf("%250[^\n]", input);
+  char *input = ReadLine(stdin);
 
   // * Cleans the string
   input = CleanString(input);
@@ -348,6 +509,14 @@ int main() {
   // * Turns the infix operation into postfix
   ToPostfix(&tokens);
 
-  printf("Result: %.5f\n", EvaluatePostfix(&tokens));
+  double result;
+  const char *error = EvaluatePostfix(&tokens, &result);
+
+  if (error) {
+    fprintf(stderr, "%s\n", error);
+    return EXIT_FAILURE;
+  }
+
+  printf("Result: %.5f\n", result);
   return 0;
 }
\ No newline at end of file
@@ -1,6 +1,10 @@
 use std::io;
+use std::io::Read;
 use std::char;
 use std::f64;
+use std::fs;
+use std::panic;
+use std::time::Instant;
 
 
 fn is_operator(c: char) -> bool {
@@ -41,76 +45,80 @@ fn perform_operation(a: f64, b: f64, operator: char) -> f64 {
 }
 
 
-fn handle_constants(input: &str, index: &mut usize, tokens: &mut Vec<String>) {
-    let chars: Vec<char> = input.chars().collect();
-    let size: usize = input.len();
-    let mut _is_success: bool = false;
-    let mut _add_index: usize = 0;
-
-    if chars[*index] == 'e' {
-        tokens.push(f64::consts::E.to_string());
-        _is_success = true;
-        _add_index = 1;
-    } else if chars[*index] == 'p' && *index + 1 < size && chars[*index + 1] == 'i' {
-        tokens.push(f64::consts::PI.to_string());
-        _is_success = true;
-        _add_index = 2;
-    } else if chars[*index] == 't' && *index + 2 < size && chars[*index + 1] == 'a' && chars[*index + 2] == 'u' {
-        tokens.push(f64::consts::TAU.to_string());
-        _is_success = true;
-        _add_index = 3;
-    } else if chars[*index] == 'r' && *index + 3 < size && chars[*index + 1] == 'o' && chars[*index + 2] == 'o' && chars[*index + 3] == 't' {
-        tokens.push("$".to_string());
-        *index += 4;
-        return;
-    }
+// ? Every operator takes two operands, a '-' that is a sign stays part of its number
+fn is_binary_operator(token: &str) -> bool {
+    matches!(token, "^" | "$" | "*" | "/" | "+" | "-")
+}
 
-    if _is_success {
-        if *index > 0 && chars[*index - 1].is_digit(10) {
-            tokens.push("*".to_string());
-        }
 
-        *index += _add_index;
+// ? The same rounded values as the C++ calculators, so every implementation sums the corpus to the same checksum
+fn constant_value(name: &str) -> Option<&'static str> {
+    match name {
+        "e" => Some("2.7182818284"),
+        "pi" => Some("3.1415926535"),
+        "tau" => Some("6.2831853071"),
+        _ => None
     }
 }
 
 
 fn tokenise(input_string: String) -> Vec<String> {
-    let string_index: Vec<char> = input_string.chars().collect();
+    let chars: Vec<char> = input_string.chars().collect();
     let mut tokens: Vec<String> = Vec::new();
     let mut current_token: String = String::new();
     let mut i: usize = 0;
 
-    while i < input_string.len() {
-        let current_char: char = string_index[i];
+    while i < chars.len() {
+        let current_char: char = chars[i];
 
-        // ? Checks if current_char is - and if the - means negative
-        if current_char == '-' && (i == 0 || input_string.chars().nth(i - 1).unwrap().is_digit(10)) {
+        // ? A - at the start, after an operator or after ( is a sign, and goes into the number like its digits
+        if (current_char == '-' && (i == 0 || is_operator(chars[i - 1]) || chars[i - 1] == '(')) || current_char.is_digit(10) || current_char == '.' {
             current_token.push(current_char);
             i += 1;
             continue;
         }
 
-        // ? Checks if current_char is a digit
-        if current_char.is_digit(10) || current_char == '.' {
-            current_token.push(current_char);
-            i += 1;
-            continue;
-        }
+        // ? Names are pi, e, tau or root, any other name is left as a token that evaluating rejects
+        if current_char.is_alphabetic() {
+            let mut end: usize = i;
 
-        // ? Checks for constants
-        handle_constants(&input_string, &mut i, &mut tokens);
+            while end < chars.len() && chars[end].is_alphabetic() {
+                end += 1;
+            }
 
-        // ? Checks if current_char is an operator
-        if is_operator(current_char) {
-            if !current_token.is_empty() {
-                tokens.push(current_token);
-                current_token = String::new();
+            let name: String = chars[i..end].iter().collect();
+
+            if name == "root" {
+                // ? "a root b" is the a-th root of b
+                if !current_token.is_empty() {
+                    tokens.push(std::mem::take(&mut current_token));
+                }
+
+                tokens.push("$".to_string());
+            } else {
+                // ? A number right before a name multiplies it, a lone '-' negates it
+                if current_token == "-" {
+                    tokens.push("-1".to_string());
+                    tokens.push("*".to_string());
+                    current_token.clear();
+                } else if !current_token.is_empty() {
+                    tokens.push(std::mem::take(&mut current_token));
+                    tokens.push("*".to_string());
+                }
+
+                tokens.push(constant_value(&name).map_or(name, |value| value.to_string()));
             }
 
-            tokens.push(current_char.to_string());
+            i = end;
+            continue;
+        }
+
+        // ? Anything else ends the number before it
+        if !current_token.is_empty() {
+            tokens.push(std::mem::take(&mut current_token));
         }
 
+        tokens.push(current_char.to_string());
         i += 1;
     }
 
@@ -126,52 +134,67 @@ fn tokenise(input_string: String) -> Vec<String> {
 /*
   * Applies the shunting yard algorithm to converts infix to postfix notation
   * source: https://en.wikipedia.org/wiki/Shunting_yard_algorithm#The_algorithm_in_detail
+  * Operators are left associative like in the other implementations, so 2^3^2 is (2^3)^2
+  * A ) without its ( is skipped, a ( without its ) is left in the output where evaluating rejects it
 */
 fn to_postfix(tokens: Vec<String>) -> Vec<String> {
     let mut postfix_tokens: Vec<String> = Vec::new();
     let mut stack: Vec<String> = Vec::new();
 
     for token in tokens {
-        if token.chars().nth(0).unwrap().is_digit(10) {
-            postfix_tokens.push(token);
-        } else if is_operator(token.chars().nth(0).unwrap()) {
-            while !stack.is_empty() && precedence(stack.last().unwrap()) >= precedence(&token.clone()) {
+        if is_binary_operator(&token) {
+            while !stack.is_empty() && precedence(stack.last().unwrap()) >= precedence(&token) {
                 postfix_tokens.push(stack.pop().unwrap());
             }
-            stack.push(token.clone());
+
+            stack.push(token);
         } else if token == "(" {
-            stack.push(token.clone());
+            stack.push(token);
         } else if token == ")" {
             while !stack.is_empty() && stack.last().unwrap() != "(" {
                 postfix_tokens.push(stack.pop().unwrap());
             }
 
-            if !stack.is_empty() {stack.pop();}
+            stack.pop();
+        } else {
+            postfix_tokens.push(token);
         }
     }
 
-    while !stack.is_empty() {
-        postfix_tokens.push(stack.pop().unwrap());
+    while let Some(token) = stack.pop() {
+        postfix_tokens.push(token);
     }
 
     postfix_tokens
 }
 
 
-fn eval_postfix(tokens: Vec<String>) -> f64 {
+// * Evaluates the postfix tokens, or says why they have no value
+fn eval_postfix(tokens: Vec<String>) -> Result<f64, &'static str> {
     let mut stack: Vec<f64> = Vec::new();
 
     for token in tokens {
-        if token.chars().nth(0).unwrap().is_digit(10) {
-            stack.push(token.parse::<f64>().unwrap());
-        } else {
-            let a: f64 = stack.pop().expect("ERR failed to pop!");
-            let b: f64 = stack.pop().expect("ERR failed to pop!");
-            stack.push(perform_operation(a, b, token.chars().next().unwrap()));
+        if !is_binary_operator(&token) {
+            stack.push(token.parse::<f64>().map_err(|_| "Invalid expression!")?);
+            continue;
+        }
+
+        // ? The second operand is on top of the stack
+        let b: f64 = stack.pop().ok_or("Not enough operands!")?;
+        let a: f64 = stack.pop().ok_or("Not enough operands!")?;
+        let operation: char = token.chars().next().unwrap();
+
+        if operation == '/' && b == 0.0 {
+            return Err("Division by zero!");
         }
+
+        stack.push(perform_operation(a, b, operation));
     }
 
-    stack.pop().expect("Invalid postfix operation!")
+    match stack[..] {
+        [result] => Ok(result),
+        _ => Err("Too many operands!")
+    }
 }
 
 
@@ -182,7 +205,73 @@ fn clean_string(input: String) -> String {
 }
 
 
+/*
+  * Times clean, tokenise, postfix and evaluate separately over every line of the corpus and prints one JSON object
+  * Each stage runs over the whole corpus before the next one starts, lines without a value or that panic count as errors
+*/
+fn bench_stages(corpus: String) {
+    let lines: Vec<String> = corpus.lines().map(|line| line.to_string()).collect();
+    let expression_count = lines.len();
+    let mut stage_seconds: Vec<f64> = Vec::new();
+    let mut errors: usize = 0;
+    let mut non_finite: usize = 0;
+    let mut checksum: f64 = 0.0;
+
+    // ? Panics are counted, not printed
+    panic::set_hook(Box::new(|_| {}));
+
+    let start = Instant::now();
+    let cleaned: Vec<String> = lines.into_iter().map(clean_string).collect();
+    stage_seconds.push(start.elapsed().as_secs_f64());
+
+    let start = Instant::now();
+    let tokens: Vec<Option<Vec<String>>> = cleaned.into_iter().map(|line| panic::catch_unwind(|| tokenise(line)).ok()).collect();
+    stage_seconds.push(start.elapsed().as_secs_f64());
+
+    let start = Instant::now();
+    let postfix: Vec<Option<Vec<String>>> = tokens.into_iter().map(|line| line.and_then(|line| panic::catch_unwind(|| to_postfix(line)).ok())).collect();
+    stage_seconds.push(start.elapsed().as_secs_f64());
+
+    let start = Instant::now();
+    for line in postfix {
+        match line.and_then(|line| panic::catch_unwind(|| eval_postfix(line)).ok().and_then(Result::ok)) {
+            Some(result) if result.is_finite() => checksum += result,
+            Some(_) => non_finite += 1,
+            None => errors += 1,
+        }
+    }
+    stage_seconds.push(start.elapsed().as_secs_f64());
+
+    let stage_names = ["clean", "tokenize", "postfix", "evaluate"];
+    let stages: Vec<String> = stage_names.iter().zip(stage_seconds.iter()).map(|(name, seconds)| {
+        let per_expression = if expression_count > 0 { seconds * 1e9 / expression_count as f64 } else { 0.0 };
+        format!("\"{}\": {{\"seconds\": {:.9}, \"ns_per_expression\": {:.3}}}", name, seconds, per_expression)
+    }).collect();
+
+    println!(
+        "{{\"implementation\": \"Rust/Calculator.rs\", \"expressions\": {}, \"bytes\": {}, \"stages\": {{{}}}, \"total_seconds\": {:.9}, \"errors\": {}, \"non_finite\": {}, \"checksum\": {:e}}}",
+        expression_count, corpus.len(), stages.join(", "), stage_seconds.iter().sum::<f64>(), errors, non_finite, checksum
+    );
+}
+
+
 fn main() {
+    // ? --bench-stages [file] times every stage over a corpus and prints JSON
+    let arguments: Vec<String> = std::env::args().collect();
+
+    if arguments.len() > 1 && arguments[1] == "--bench-stages" {
+        let mut corpus: String = String::new();
+
+        if arguments.len() > 2 {
+            corpus = fs::read_to_string(&arguments[2]).expect("Failed to read the corpus!");
+        } else {
+            io::stdin().read_to_string(&mut corpus).expect("Failed to read!");
+        }
+
+        bench_stages(corpus);
+        return;
+    }
+
     let mut input: String = String::new();
     io::stdin().read_line(&mut input).expect("Failed to read!");
 
@@ -190,5 +279,11 @@ fn main() {
     input = clean_string(input);
 
     // ? Tokenise and turn the infix into postfix
-    println!("Result: {:.5}", eval_postfix(to_postfix(tokenise(input))));
+    match eval_postfix(to_postfix(tokenise(input))) {
+        Ok(result) => println!("Result: {:.5}", result),
+        Err(error) => {
+            eprintln!("{}", error);
+            std::process::exit(1);
+        }
+    }
 }